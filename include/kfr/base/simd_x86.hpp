@@ -269,4 +269,30 @@ KFR_I_CE CMT_INLINE vec<f64, 8> vec<f64, 8>::operator^(const vec<f64, 8>& y) con
 
 #endif // CMT_ARCH_AVX
 
+namespace internal
+{
+// Multiplies 16-bit elements and adds the products of each adjacent pair into a 32-bit element (pmaddwd).
+// The sum wraps around only if both pairs are -32768 * -32768
+#ifdef CMT_ARCH_SSE2
+CMT_INLINE vec<i32, 4> madd_pairs(const vec<i16, 8>& x, const vec<i16, 8>& y) noexcept
+{
+    return _mm_madd_epi16(*x, *y);
+}
+#endif
+
+#ifdef CMT_ARCH_AVX2
+CMT_INLINE vec<i32, 8> madd_pairs(const vec<i16, 16>& x, const vec<i16, 16>& y) noexcept
+{
+    return _mm256_madd_epi16(*x, *y);
+}
+#endif
+
+#if defined CMT_ARCH_AVX512 && defined __AVX512BW__
+CMT_INLINE vec<i32, 16> madd_pairs(const vec<i16, 32>& x, const vec<i16, 32>& y) noexcept
+{
+    return _mm512_madd_epi16(*x, *y);
+}
+#endif
+} // namespace internal
+
 } // namespace kfr
@@ -25,5 +25,6 @@
 #include "base.hpp"
 
 #include "dft/convolution.hpp"
+#include "dft/dct.hpp"
 #include "dft/fft.hpp"
 #include "dft/reference_dft.hpp"
@@ -269,51 +269,49 @@ KFR_INTRIN void fft_reorder_swap_n4(T* inout, size_t i, size_t j, size_t N4, cbo
     cwrite_reordered(inout + i, vj, N4, cbool_t<use_br2>());
 }
 
-template <typename T>
-KFR_INTRIN void fft_reorder(complex<T>* inout, size_t log2n, ctrue_t use_br2)
+// Visits the 4x4 blocks of the reorder, calls swap(i, j) for each pair of blocks that are exchanged.
+// i and j are offsets in scalars
+template <typename Swap>
+KFR_INTRIN void fft_reorder_blocks(size_t log2n, ctrue_t, Swap&& swap)
 {
     const size_t N         = 1 << log2n;
-    const size_t N4        = N / 4;
     const size_t iend      = N / 16 * 4 * 2;
     constexpr size_t istep = 2 * 4;
     const size_t jstep1    = (1 << (log2n - 5)) * 4 * 2;
     const size_t jstep2    = size_t(1 << (log2n - 5)) * 4 * 2 - size_t(1 << (log2n - 6)) * 4 * 2;
-    T* io                  = ptr_cast<T>(inout);
 
     for (size_t i = 0; i < iend;)
     {
         size_t j = bitrev_using_table(static_cast<u32>(i >> 3), log2n - 4) << 3;
         if (i >= j)
-            fft_reorder_swap_n4(io, i, j, N4, use_br2);
+            swap(i, j);
         i += istep;
         j = j + jstep1;
 
         if (i >= j)
-            fft_reorder_swap_n4(io, i, j, N4, use_br2);
+            swap(i, j);
         i += istep;
         j = j - jstep2;
 
         if (i >= j)
-            fft_reorder_swap_n4(io, i, j, N4, use_br2);
+            swap(i, j);
         i += istep;
         j = j + jstep1;
 
         if (i >= j)
-            fft_reorder_swap_n4(io, i, j, N4, use_br2);
+            swap(i, j);
         i += istep;
     }
 }
 
-template <typename T>
-KFR_INTRIN void fft_reorder(complex<T>* inout, size_t log2n, cfalse_t use_br2)
+template <typename Swap>
+KFR_INTRIN void fft_reorder_blocks(size_t log2n, cfalse_t, Swap&& swap)
 {
     const size_t N         = size_t(1) << log2n;
-    const size_t N4        = N / 4;
     const size_t N16       = N * 2 / 16;
     size_t iend            = N16;
     constexpr size_t istep = 2 * 4;
     const size_t jstep     = N / 64 * 4 * 2;
-    T* io                  = ptr_cast<T>(inout);
 
     size_t i = 0;
     CMT_PRAGMA_CLANG(clang loop unroll_count(2))
@@ -322,7 +320,7 @@ KFR_INTRIN void fft_reorder(complex<T>* inout, size_t log2n, cfalse_t use_br2)
         size_t j = dig4rev_using_table(static_cast<u32>(i >> 3), log2n - 4) << 3;
 
         if (i >= j)
-            fft_reorder_swap_n4(io, i, j, N4, use_br2);
+            swap(i, j);
         i += istep * 4;
     }
     iend += N16;
@@ -331,13 +329,13 @@ KFR_INTRIN void fft_reorder(complex<T>* inout, size_t log2n, cfalse_t use_br2)
     {
         size_t j = dig4rev_using_table(static_cast<u32>(i >> 3), log2n - 4) << 3;
 
-        fft_reorder_swap_n4(io, i, j, N4, use_br2);
+        swap(i, j);
 
         i += istep;
         j = j + jstep;
 
         if (i >= j)
-            fft_reorder_swap_n4(io, i, j, N4, use_br2);
+            swap(i, j);
         i += istep * 3;
     }
     iend += N16;
@@ -346,18 +344,18 @@ KFR_INTRIN void fft_reorder(complex<T>* inout, size_t log2n, cfalse_t use_br2)
     {
         size_t j = dig4rev_using_table(static_cast<u32>(i >> 3), log2n - 4) << 3;
 
-        fft_reorder_swap_n4(io, i, j, N4, use_br2);
+        swap(i, j);
 
         i += istep;
         j = j + jstep;
 
-        fft_reorder_swap_n4(io, i, j, N4, use_br2);
+        swap(i, j);
 
         i += istep;
         j = j + jstep;
 
         if (i >= j)
-            fft_reorder_swap_n4(io, i, j, N4, use_br2);
+            swap(i, j);
         i += istep * 2;
     }
     iend += N16;
@@ -366,25 +364,69 @@ KFR_INTRIN void fft_reorder(complex<T>* inout, size_t log2n, cfalse_t use_br2)
     {
         size_t j = dig4rev_using_table(static_cast<u32>(i >> 3), log2n - 4) << 3;
 
-        fft_reorder_swap_n4(io, i, j, N4, use_br2);
+        swap(i, j);
 
         i += istep;
         j = j + jstep;
 
-        fft_reorder_swap_n4(io, i, j, N4, use_br2);
+        swap(i, j);
 
         i += istep;
         j = j + jstep;
 
-        fft_reorder_swap_n4(io, i, j, N4, use_br2);
+        swap(i, j);
 
         i += istep;
         j = j + jstep;
 
         if (i >= j)
-            fft_reorder_swap_n4(io, i, j, N4, use_br2);
+            swap(i, j);
         i += istep;
     }
 }
+
+template <typename T, bool use_br2>
+KFR_INTRIN void fft_reorder(complex<T>* inout, size_t log2n, cbool_t<use_br2>)
+{
+    const size_t N4 = (size_t(1) << log2n) / 4;
+    T* io           = ptr_cast<T>(inout);
+    fft_reorder_blocks(log2n, cbool_t<use_br2>(), [io, N4](size_t i, size_t j) {
+        fft_reorder_swap_n4(io, i, j, N4, cbool_t<use_br2>());
+    });
+}
+
+template <typename T, bool use_br2>
+KFR_INTRIN void cwrite_reordered(T* out_re, T* out_im, const cvec<T, 16>& value, size_t N4, cbool_t<use_br2>)
+{
+    vec<T, 8> g0, g1, g2, g3;
+    split(digitreverse<(use_br2 ? 2 : 4), 2>(value), g0, g1, g2, g3);
+    g0 = splitpairs(g0);
+    g1 = splitpairs(g1);
+    g2 = splitpairs(g2);
+    g3 = splitpairs(g3);
+    write(out_re, low(g0));
+    write(out_im, high(g0));
+    write(out_re + N4, low(g1));
+    write(out_im + N4, high(g1));
+    write(out_re + N4 * 2, low(g2));
+    write(out_im + N4 * 2, high(g2));
+    write(out_re + N4 * 3, low(g3));
+    write(out_im + N4 * 3, high(g3));
+}
+
+// Same permutation as fft_reorder, but out of place, the real and imaginary parts are written to
+// separate arrays
+template <typename T, bool use_br2>
+KFR_INTRIN void fft_reorder(T* out_re, T* out_im, const complex<T>* in, size_t log2n, cbool_t<use_br2>)
+{
+    const size_t N4 = (size_t(1) << log2n) / 4;
+    const T* src    = ptr_cast<T>(in);
+    fft_reorder_blocks(log2n, cbool_t<use_br2>(), [=](size_t i, size_t j) {
+        const cvec<T, 16> vi = cread_group<4, 4, fft_reorder_aligned>(ptr_cast<complex<T>>(src + i), N4);
+        const cvec<T, 16> vj = cread_group<4, 4, fft_reorder_aligned>(ptr_cast<complex<T>>(src + j), N4);
+        cwrite_reordered(out_re + j / 2, out_im + j / 2, vi, N4, cbool_t<use_br2>());
+        cwrite_reordered(out_re + i / 2, out_im + i / 2, vj, N4, cbool_t<use_br2>());
+    });
+}
 }
 }
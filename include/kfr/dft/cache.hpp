@@ -26,9 +26,20 @@
 #pragma once
 
 #include "fft.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <deque>
+#include <limits>
 #include <memory>
 #include <mutex>
 #include <vector>
+#ifdef CMT_OS_POSIX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 namespace kfr
 {
@@ -39,6 +50,191 @@ using dft_plan_ptr = std::shared_ptr<const dft_plan<T>>;
 template <typename T>
 using dft_plan_real_ptr = std::shared_ptr<const dft_plan_real<T>>;
 
+// Version of the wisdom format, must be incremented whenever the layout of plan data changes
+constexpr u32 dft_wisdom_version = 1;
+
+namespace internal
+{
+// Wisdom layout: header, then count records, each is a record header followed by the plan data.
+// Headers are padded to dft_data_alignment bytes
+struct dft_wisdom_header
+{
+    char magic[8];
+    u32 version;
+    u32 arch;
+    u32 count;
+    // Checked on load along with the version and arch, a blob from a build with a different layout
+    // of these structures is rejected
+    u32 header_size;
+    u32 record_size;
+    u32 data_alignment;
+};
+
+struct dft_wisdom_record
+{
+    u32 real;
+    u32 type_size;
+    u64 size;
+    u64 data_size;
+};
+
+constexpr char dft_wisdom_magic[8] = { 'K', 'F', 'R', 'W', 'I', 'S', 'D', 'M' };
+
+static_assert(sizeof(dft_wisdom_header) <= dft_data_alignment, "the header must fit in its padding");
+static_assert(sizeof(dft_wisdom_record) <= dft_data_alignment, "the record must fit in its padding");
+} // namespace internal
+
+// Counters of dft_cache_impl, see dft_cache_impl::stats
+struct dft_cache_stats
+{
+    u64 hits;
+    u64 misses;
+    u64 evictions;
+    size_t count;
+    size_t bytes;
+};
+
+namespace internal
+{
+constexpr u32 dft_cache_kind(bool real, size_t type_size)
+{
+    return (real ? 2 : 0) + (type_size == sizeof(f64) ? 1 : 0);
+}
+
+struct dft_cache_entry
+{
+    dft_cache_entry(size_t size, u32 kind, std::shared_ptr<const void> plan, size_t bytes, u64 used)
+        : size(size), kind(kind), plan(std::move(plan)), bytes(bytes), used(used)
+    {
+    }
+    const size_t size;
+    const u32 kind;
+    const std::shared_ptr<const void> plan;
+    const size_t bytes;
+    // Value of the cache clock at insertion, then clock + 1 at the last lookup, used for LRU eviction
+    std::atomic<u64> used;
+    // Value of used when the entry was last queued in the LRU order of its shard, guarded by the mutex
+    u64 queued = 0;
+};
+
+using dft_cache_table = std::vector<std::shared_ptr<dft_cache_entry>>;
+
+// A lookup in progress publishes the table it reads in a slot, a retired table is deleted only when no
+// slot holds it. Each thread starts from its own slot, so lookups of different threads write to
+// different cache lines
+struct alignas(platform<>::native_cache_alignment) dft_cache_slot
+{
+    std::atomic<const dft_cache_table*> table{ nullptr };
+    // Hits of the threads that start from this slot, summed by dft_cache_impl::stats
+    std::atomic<u64> hits{ 0 };
+};
+
+constexpr size_t dft_cache_slot_count = 64;
+
+inline size_t dft_cache_thread_slot()
+{
+#ifndef KFR_SINGLE_THREAD
+    static std::atomic<size_t> next{ 0 };
+    static thread_local size_t index = next.fetch_add(1, std::memory_order_relaxed) % dft_cache_slot_count;
+    return index;
+#else
+    return 0;
+#endif
+}
+
+// The table is never modified after publication, writers replace it with a modified copy under
+// the mutex, so lookups only load the table pointer and do not take the mutex.
+// Replaced tables are retired and deleted once no slot holds them, by the writer or by a later lookup
+struct alignas(platform<>::native_cache_alignment) dft_cache_shard
+{
+    dft_cache_shard() : table(new dft_cache_table()) {}
+    ~dft_cache_shard()
+    {
+        delete table.load(std::memory_order_relaxed);
+        for (const dft_cache_table* old : retired)
+            delete old;
+    }
+
+    // Must be called with the mutex held
+    const dft_cache_table& current() const { return *table.load(std::memory_order_relaxed); }
+
+    // Must be called with the mutex held
+    void publish(const dft_cache_table* next, const dft_cache_slot* slots)
+    {
+        retired.push_back(table.exchange(next, std::memory_order_seq_cst));
+        reclaim(slots);
+    }
+
+    // Must be called with the mutex held. Deletes the retired tables that no lookup reads.
+    // A lookup that sets its slot after these loads reads the new table, see dft_cache_lookup
+    void reclaim(const dft_cache_slot* slots)
+    {
+        const auto in_use = [slots](const dft_cache_table* old) {
+            for (size_t i = 0; i < dft_cache_slot_count; i++)
+                if (slots[i].table.load(std::memory_order_seq_cst) == old)
+                    return true;
+            return false;
+        };
+        retired.erase(std::remove_if(retired.begin(), retired.end(),
+                                     [&](const dft_cache_table* old) {
+                                         if (in_use(old))
+                                             return false;
+                                         delete old;
+                                         return true;
+                                     }),
+                      retired.end());
+        pending.store(retired.size(), std::memory_order_relaxed);
+    }
+
+    std::atomic<const dft_cache_table*> table;
+    std::vector<const dft_cache_table*> retired;
+    // Size of retired, read by lookups without the mutex
+    std::atomic<size_t> pending{ 0 };
+    // Entries from the most to the least recently queued, see dft_cache_impl::lru_tail
+    std::deque<std::shared_ptr<dft_cache_entry>> lru;
+    std::atomic<u64> misses{ 0 };
+    std::atomic<u64> evictions{ 0 };
+#ifndef KFR_SINGLE_THREAD
+    std::mutex mutex;
+#endif
+};
+
+// Keeps the table of a shard from being deleted while it is read without the mutex.
+// Claims the first free slot from the slot of the thread, a slot is taken only if more threads than
+// dft_cache_slot_count look up plans at the same time
+struct dft_cache_lookup
+{
+    dft_cache_lookup(const dft_cache_shard& shard, dft_cache_slot* slots)
+    {
+        const dft_cache_table* current = shard.table.load(std::memory_order_relaxed);
+        for (size_t index = dft_cache_thread_slot();; index = (index + 1) % dft_cache_slot_count)
+        {
+            const dft_cache_table* expected = nullptr;
+            if (slots[index].table.compare_exchange_strong(expected, current, std::memory_order_seq_cst))
+            {
+                slot = &slots[index];
+                break;
+            }
+        }
+        // the table might have been replaced and checked by reclaim before the slot was set
+        for (const dft_cache_table* next; (next = shard.table.load(std::memory_order_seq_cst)) != current;)
+        {
+            current = next;
+            slot->table.store(current, std::memory_order_seq_cst);
+        }
+        read = current;
+    }
+    ~dft_cache_lookup() { slot->table.store(nullptr, std::memory_order_release); }
+    dft_cache_lookup(const dft_cache_lookup&) = delete;
+    dft_cache_lookup& operator=(const dft_cache_lookup&) = delete;
+
+    const dft_cache_table& table() const { return *read; }
+
+    dft_cache_slot* slot;
+    const dft_cache_table* read;
+};
+} // namespace internal
+
 template <int = 0>
 struct dft_cache_impl
 {
@@ -47,78 +243,422 @@ struct dft_cache_impl
         static dft_cache_impl cache;
         return cache;
     }
+    // One plan of each size serves both directions
     dft_plan_ptr<f32> get(ctype_t<f32>, size_t size)
     {
-#ifndef KFR_SINGLE_THREAD
-        std::lock_guard<std::mutex> guard(mutex);
-#endif
-        return get_or_create(cache_f32, size);
+        return get_or_create<f32, dft_plan>(size);
     }
     dft_plan_ptr<f64> get(ctype_t<f64>, size_t size)
     {
-#ifndef KFR_SINGLE_THREAD
-        std::lock_guard<std::mutex> guard(mutex);
-#endif
-        return get_or_create(cache_f64, size);
+        return get_or_create<f64, dft_plan>(size);
     }
     dft_plan_real_ptr<f32> getreal(ctype_t<f32>, size_t size)
     {
+        return get_or_create<f32, dft_plan_real>(size);
+    }
+    dft_plan_real_ptr<f64> getreal(ctype_t<f64>, size_t size)
+    {
+        return get_or_create<f64, dft_plan_real>(size);
+    }
+
+    // Removes all plans, plans still referenced elsewhere stay valid
+    void clear()
+    {
+        for (internal::dft_cache_shard& shard : shards)
+        {
 #ifndef KFR_SINGLE_THREAD
-        std::lock_guard<std::mutex> guard(mutex);
+            std::lock_guard<std::mutex> guard(shard.mutex);
 #endif
-        return get_or_create(cache_real_f32, size);
+            for (const entry_ptr& entry : shard.current())
+                unaccount(*entry);
+            shard.lru.clear();
+            shard.publish(new internal::dft_cache_table(), slots);
+        }
     }
-    dft_plan_real_ptr<f64> getreal(ctype_t<f64>, size_t size)
+
+    // Limits the total data_memory of cached plans, least recently used plans are evicted above it.
+    // The most recently created plan is kept even if it alone exceeds the budget
+    void set_budget(size_t max_bytes)
+    {
+        budget = max_bytes;
+        evict(nullptr);
+    }
+    size_t get_budget() const { return budget; }
+
+    dft_cache_stats stats() const
+    {
+        dft_cache_stats result{ 0, 0, 0, count, bytes };
+        for (const internal::dft_cache_slot& slot : slots)
+            result.hits += slot.hits.load(std::memory_order_relaxed);
+        for (const internal::dft_cache_shard& shard : shards)
+        {
+            result.misses += shard.misses.load(std::memory_order_relaxed);
+            result.evictions += shard.evictions.load(std::memory_order_relaxed);
+        }
+        return result;
+    }
+
+    // Serializes precomputed data of all cached plans
+    std::vector<u8> save_wisdom() const
     {
+        std::vector<u8> blob(dft_data_alignment);
+        internal::dft_wisdom_header header;
+        std::copy(std::begin(internal::dft_wisdom_magic), std::end(internal::dft_wisdom_magic), header.magic);
+        header.version        = dft_wisdom_version;
+        header.arch           = static_cast<u32>(cpu_t::native);
+        header.count          = 0;
+        header.header_size    = sizeof(internal::dft_wisdom_header);
+        header.record_size    = sizeof(internal::dft_wisdom_record);
+        header.data_alignment = dft_data_alignment;
+        for (const internal::dft_cache_shard& shard : shards)
+        {
+            const internal::dft_cache_lookup lookup(shard, slots);
+            for (const entry_ptr& entry : lookup.table())
+            {
+                switch (entry->kind)
+                {
+                case internal::dft_cache_kind(false, sizeof(f32)):
+                    save_record(blob, *static_cast<const dft_plan<f32>*>(entry->plan.get()));
+                    break;
+                case internal::dft_cache_kind(false, sizeof(f64)):
+                    save_record(blob, *static_cast<const dft_plan<f64>*>(entry->plan.get()));
+                    break;
+                case internal::dft_cache_kind(true, sizeof(f32)):
+                    save_record(blob, *static_cast<const dft_plan_real<f32>*>(entry->plan.get()));
+                    break;
+                case internal::dft_cache_kind(true, sizeof(f64)):
+                    save_record(blob, *static_cast<const dft_plan_real<f64>*>(entry->plan.get()));
+                    break;
+                }
+                header.count++;
+            }
+        }
+        internal::builtin_memcpy(blob.data(), &header, sizeof(header));
+        return blob;
+    }
+    bool save_wisdom(const char* path) const
+    {
+        const std::vector<u8> blob = save_wisdom();
+        FILE* file                 = fopen(path, "wb");
+        if (!file)
+            return false;
+        const bool ok = fwrite(blob.data(), 1, blob.size(), file) == blob.size();
+        return fclose(file) == 0 && ok;
+    }
+
+    // Adds plans from a blob created by save_wisdom. Returns false if the blob was created by a different
+    // version or for a different architecture, or if a record is malformed, records before it are kept.
+    // A record whose data does not match the stages of the plan is recalculated.
+    // If owner is set and blob is aligned to dft_data_alignment, plans use the blob in place and keep
+    // the owner alive, otherwise the data is copied, since the stages read it with aligned loads
+    bool load_wisdom(const u8* blob, size_t size, std::shared_ptr<const void> owner = nullptr)
+    {
+        internal::dft_wisdom_header header;
+        if (size < dft_data_alignment)
+            return false;
+        if (reinterpret_cast<uintptr_t>(blob) % dft_data_alignment != 0)
+            owner = nullptr;
+        internal::builtin_memcpy(&header, blob, sizeof(header));
+        if (!std::equal(std::begin(internal::dft_wisdom_magic), std::end(internal::dft_wisdom_magic),
+                        header.magic) ||
+            header.version != dft_wisdom_version || header.arch != static_cast<u32>(cpu_t::native) ||
+            header.header_size != sizeof(internal::dft_wisdom_header) ||
+            header.record_size != sizeof(internal::dft_wisdom_record) ||
+            header.data_alignment != dft_data_alignment)
+            return false;
+        size_t offset = dft_data_alignment;
+        bool valid    = true;
+        for (u32 i = 0; i < header.count; i++)
+        {
+            internal::dft_wisdom_record record;
+            if (size - offset < dft_data_alignment)
+            {
+                valid = false;
+                break;
+            }
+            internal::builtin_memcpy(&record, blob + offset, sizeof(record));
+            offset += dft_data_alignment;
+            if (!valid_record(record) || size - offset < record.data_size)
+            {
+                valid = false;
+                break;
+            }
+            dft_data_reader reader(blob + offset, static_cast<size_t>(record.data_size), owner);
+            if (record.type_size == sizeof(f32))
+            {
+                if (record.real)
+                    load_record<f32, dft_plan_real>(record.size, reader);
+                else
+                    load_record<f32, dft_plan>(record.size, reader);
+            }
+            else if (record.type_size == sizeof(f64))
+            {
+                if (record.real)
+                    load_record<f64, dft_plan_real>(record.size, reader);
+                else
+                    load_record<f64, dft_plan>(record.size, reader);
+            }
+            offset += record.data_size;
+        }
+        evict(nullptr);
+        return valid;
+    }
+    // Adds plans from a file written by save_wisdom. On POSIX systems the file is memory-mapped
+    // if map is true, and the plans use the mapped data directly
+    bool load_wisdom(const char* path, bool map = true)
+    {
+#ifdef CMT_OS_POSIX
+        if (map)
+        {
+            const int fd = open(path, O_RDONLY);
+            if (fd < 0)
+                return false;
+            struct stat st;
+            if (fstat(fd, &st) != 0 || st.st_size <= 0)
+            {
+                close(fd);
+                return false;
+            }
+            const size_t size = static_cast<size_t>(st.st_size);
+            void* mapped      = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            close(fd);
+            if (mapped == MAP_FAILED)
+                return false;
+            const std::shared_ptr<const void> mapping(mapped,
+                                                      [mapped, size](const void*) { munmap(mapped, size); });
+            return load_wisdom(static_cast<const u8*>(mapped), size, mapping);
+        }
+#else
+        (void)map;
+#endif
+        FILE* file = fopen(path, "rb");
+        if (!file)
+            return false;
+        std::vector<u8> blob;
+        u8 buffer[4096];
+        size_t read;
+        while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+            blob.insert(blob.end(), buffer, buffer + read);
+        fclose(file);
+        return load_wisdom(blob.data(), blob.size());
+    }
+
+private:
+    using entry_ptr = std::shared_ptr<internal::dft_cache_entry>;
+
+    static constexpr size_t shard_count = 16;
+
+    template <typename T, template <typename> class Plan>
+    static constexpr u32 kind_of()
+    {
+        return internal::dft_cache_kind(std::is_same<Plan<T>, dft_plan_real<T>>::value, sizeof(T));
+    }
+
+    internal::dft_cache_shard& shard_of(size_t size, u32 kind)
+    {
+        // Fibonacci hashing, the top bits select the shard
+        const u64 key = static_cast<u64>(size) * 4 + kind;
+        return shards[(key * 0x9E3779B97F4A7C15ull) >> 60];
+    }
+
+    static bool valid_record(const internal::dft_wisdom_record& record)
+    {
+        if (record.real > 1 || (record.type_size != sizeof(f32) && record.type_size != sizeof(f64)))
+            return false;
+        // real transforms have even sizes, data blocks are padded by save_record
+        if (record.size == 0 || record.size > std::numeric_limits<size_t>::max() ||
+            (record.real && record.size % 2 != 0))
+            return false;
+        return record.data_size % dft_data_alignment == 0;
+    }
+
+    static entry_ptr find(const internal::dft_cache_table& table, size_t size, u32 kind)
+    {
+        for (const entry_ptr& entry : table)
+        {
+            if (entry->size == size && entry->kind == kind)
+                return entry;
+        }
+        return nullptr;
+    }
+
+    template <typename T, template <typename> class Plan>
+    std::shared_ptr<const Plan<T>> get_or_create(size_t size)
+    {
+        const u32 kind                   = kind_of<T, Plan>();
+        internal::dft_cache_shard& shard = shard_of(size, kind);
+        entry_ptr entry;
+        {
+            const internal::dft_cache_lookup lookup(shard, slots);
+            entry = find(lookup.table(), size, kind);
+        }
+        if (shard.pending.load(std::memory_order_relaxed) != 0)
+            reclaim(shard);
+        if (!entry)
+        {
 #ifndef KFR_SINGLE_THREAD
-        std::lock_guard<std::mutex> guard(mutex);
+            std::unique_lock<std::mutex> guard(shard.mutex);
 #endif
-        return get_or_create(cache_real_f64, size);
+            // another thread might have created the plan while this one was waiting
+            entry = find(shard.current(), size, kind);
+            if (!entry)
+            {
+                shard.misses.fetch_add(1, std::memory_order_relaxed);
+                const std::shared_ptr<const Plan<T>> plan = std::make_shared<const Plan<T>>(size);
+                entry = insert(shard, size, kind, plan, plan->data_memory());
+#ifndef KFR_SINGLE_THREAD
+                guard.unlock();
+#endif
+                evict(entry.get());
+                return plan;
+            }
+        }
+        return hit<Plan<T>>(shard, *entry);
     }
-    void clear()
+
+    template <typename Plan>
+    std::shared_ptr<const Plan> hit(internal::dft_cache_shard& shard, internal::dft_cache_entry& entry)
+    {
+        slots[internal::dft_cache_thread_slot()].hits.fetch_add(1, std::memory_order_relaxed);
+        // lookups only read the clock, writers advance it. An entry used after it was queued has a
+        // greater used than queued, see lru_tail
+        const u64 now = clock.load(std::memory_order_relaxed) + 1;
+        if (entry.used.load(std::memory_order_relaxed) != now)
+            entry.used.store(now, std::memory_order_relaxed);
+        return std::static_pointer_cast<const Plan>(entry.plan);
+    }
+
+    // Retries deleting the tables retired while lookups read them, without waiting for the mutex
+    void reclaim(internal::dft_cache_shard& shard)
     {
 #ifndef KFR_SINGLE_THREAD
-        std::lock_guard<std::mutex> guard(mutex);
+        std::unique_lock<std::mutex> guard(shard.mutex, std::try_to_lock);
+        if (!guard.owns_lock())
+            return;
 #endif
-        cache_f32.clear();
-        cache_f64.clear();
-        cache_real_f32.clear();
-        cache_real_f64.clear();
+        shard.reclaim(slots);
     }
 
-private:
-    template <typename T>
-    dft_plan_ptr<T> get_or_create(std::vector<dft_plan_ptr<T>>& cache, size_t size)
+    // Must be called with the shard mutex held
+    entry_ptr insert(internal::dft_cache_shard& shard, size_t size, u32 kind,
+                     std::shared_ptr<const void> plan, size_t plan_bytes)
     {
-        for (dft_plan_ptr<T>& dft : cache)
+        const entry_ptr entry = std::make_shared<internal::dft_cache_entry>(
+            size, kind, std::move(plan), plan_bytes, clock.fetch_add(1) + 1);
+        internal::dft_cache_table* table = new internal::dft_cache_table(shard.current());
+        table->push_back(entry);
+        shard.publish(table, slots);
+        entry->queued = entry->used.load(std::memory_order_relaxed);
+        shard.lru.push_front(entry);
+        count += 1;
+        bytes += plan_bytes;
+        return entry;
+    }
+
+    void unaccount(const internal::dft_cache_entry& entry)
+    {
+        count -= 1;
+        bytes -= entry.bytes;
+    }
+
+    // Must be called with the shard mutex held. Returns the least recently used entry of the shard other
+    // than keep. Lookups do not reorder the queue, entries used since they were queued are queued again
+    // when they reach its end, so the queue is an approximation of the LRU order that lookups never lock
+    static entry_ptr lru_tail(internal::dft_cache_shard& shard, const internal::dft_cache_entry* keep)
+    {
+        // after one pass every entry except those used concurrently has been requeued
+        for (size_t n = 2 * shard.lru.size(); n > 0; n--)
         {
-            if (dft->size == size)
-                return dft;
+            const entry_ptr tail = shard.lru.back();
+            const u64 used       = tail->used.load(std::memory_order_relaxed);
+            if (used == tail->queued && tail.get() != keep)
+                return tail;
+            tail->queued = used;
+            shard.lru.pop_back();
+            shard.lru.push_front(tail);
         }
-        dft_plan_ptr<T> sh = std::make_shared<dft_plan<T>>(size);
-        cache.push_back(sh);
-        return sh;
+        return nullptr;
     }
-    template <typename T>
-    dft_plan_real_ptr<T> get_or_create(std::vector<dft_plan_real_ptr<T>>& cache, size_t size)
+
+    // Evicts least recently used plans until the total size fits the budget, never evicts keep.
+    // Each step compares the least recently used entries of the shards, not all entries
+    void evict(const internal::dft_cache_entry* keep)
     {
-        for (dft_plan_real_ptr<T>& dft : cache)
+        while (bytes > budget)
         {
-            if (dft->size == size)
-                return dft;
+            // entries requeued below are used again only if they are looked up after this
+            clock.fetch_add(1, std::memory_order_relaxed);
+            internal::dft_cache_shard* victim_shard = nullptr;
+            u64 victim_used                         = 0;
+            for (internal::dft_cache_shard& shard : shards)
+            {
+#ifndef KFR_SINGLE_THREAD
+                std::lock_guard<std::mutex> guard(shard.mutex);
+#endif
+                const entry_ptr tail = lru_tail(shard, keep);
+                if (tail && (!victim_shard || tail->queued < victim_used))
+                {
+                    victim_shard = &shard;
+                    victim_used  = tail->queued;
+                }
+            }
+            if (!victim_shard)
+                return;
+#ifndef KFR_SINGLE_THREAD
+            std::lock_guard<std::mutex> guard(victim_shard->mutex);
+#endif
+            // another thread might have changed the shard since it was chosen
+            const entry_ptr victim = bytes > budget ? lru_tail(*victim_shard, keep) : nullptr;
+            if (!victim)
+                continue;
+            victim_shard->lru.pop_back();
+            internal::dft_cache_table* table = new internal::dft_cache_table(victim_shard->current());
+            table->erase(std::find(table->begin(), table->end(), victim));
+            victim_shard->publish(table, slots);
+            victim_shard->evictions.fetch_add(1, std::memory_order_relaxed);
+            unaccount(*victim);
         }
-        dft_plan_real_ptr<T> sh = std::make_shared<dft_plan_real<T>>(size);
-        cache.push_back(sh);
-        return sh;
     }
 
-    std::vector<dft_plan_ptr<f32>> cache_f32;
-    std::vector<dft_plan_ptr<f64>> cache_f64;
-    std::vector<dft_plan_real_ptr<f32>> cache_real_f32;
-    std::vector<dft_plan_real_ptr<f64>> cache_real_f64;
+    template <typename T, template <typename> class Plan>
+    static void save_record(std::vector<u8>& blob, const Plan<T>& plan)
+    {
+        const size_t offset = blob.size();
+        blob.resize(offset + dft_data_alignment);
+        plan.save_data(blob);
+        internal::dft_wisdom_record record;
+        record.real      = std::is_same<Plan<T>, dft_plan_real<T>>::value;
+        record.type_size = sizeof(T);
+        record.size      = plan.size;
+        record.data_size = blob.size() - offset - dft_data_alignment;
+        internal::builtin_memcpy(blob.data() + offset, &record, sizeof(record));
+    }
+
+    template <typename T, template <typename> class Plan>
+    void load_record(size_t size, dft_data_reader& reader)
+    {
+        const u32 kind                   = kind_of<T, Plan>();
+        internal::dft_cache_shard& shard = shard_of(size, kind);
 #ifndef KFR_SINGLE_THREAD
-    std::mutex mutex;
+        std::lock_guard<std::mutex> guard(shard.mutex);
 #endif
+        if (find(shard.current(), size, kind))
+            return;
+        std::shared_ptr<const Plan<T>> plan =
+            std::make_shared<const Plan<T>>(size, dft_type::both, 1, &reader);
+        // the data does not match the plan layout, calculate the plan from scratch
+        if (reader.failed || reader.ptr != reader.end)
+            plan = std::make_shared<const Plan<T>>(size);
+        insert(shard, size, kind, plan, plan->data_memory());
+    }
+
+    internal::dft_cache_shard shards[shard_count];
+    mutable internal::dft_cache_slot slots[internal::dft_cache_slot_count];
+    // Advanced by writers only, lookups stamp entries with clock + 1
+    std::atomic<u64> clock{ 0 };
+    std::atomic<size_t> count{ 0 };
+    std::atomic<size_t> bytes{ 0 };
+    std::atomic<size_t> budget{ std::numeric_limits<size_t>::max() };
 };
 
 using dft_cache = dft_cache_impl<>;
@@ -35,6 +35,10 @@
 #include "cache.hpp"
 #include "fft.hpp"
 
+#include <atomic>
+#include <memory>
+#include <vector>
+
 CMT_PRAGMA_GNU(GCC diagnostic push)
 #if CMT_HAS_WARNING("-Wshadow")
 CMT_PRAGMA_GNU(GCC diagnostic ignored "-Wshadow")
@@ -51,6 +55,12 @@ template <typename T>
 univector<T> correlate(const univector_ref<const T>& src1, const univector_ref<const T>& src2);
 template <typename T>
 univector<T> autocorrelate(const univector_ref<const T>& src1);
+template <typename T>
+size_t convolve_temp_size(size_t size1, size_t size2);
+template <typename T>
+void convolve(T* out, const T* src1, size_t size1, const T* src2, size_t size2, u8* temp);
+template <typename T>
+void correlate(T* out, const T* src1, size_t size1, const T* src2, size_t size2, u8* temp);
 } // namespace internal
 
 template <typename T, size_t Tag1, size_t Tag2>
@@ -71,14 +81,64 @@ univector<T> autocorrelate(const univector<T, Tag1>& src)
     return internal::autocorrelate(src.slice());
 }
 
+/// @brief Size in bytes of the workspace for convolve and correlate writing to a caller-provided buffer
+template <typename T>
+size_t convolve_temp_size(size_t size1, size_t size2)
+{
+    return internal::convolve_temp_size<T>(size1, size2);
+}
+
+/// @brief Writes size1 + size2 - 1 samples of the convolution of src1 and src2 to out without allocation.
+/// Short inputs are convolved directly, longer ones using the real FFT
+template <typename T>
+void convolve(T* out, const T* src1, size_t size1, const T* src2, size_t size2, u8* temp)
+{
+    internal::convolve(out, src1, size1, src2, size2, temp);
+}
+
+/// @brief Writes size1 + size2 - 1 samples of the cross-correlation of src1 and src2 to out
+/// without allocation
+template <typename T>
+void correlate(T* out, const T* src1, size_t size1, const T* src2, size_t size2, u8* temp)
+{
+    internal::correlate(out, src1, size1, src2, size2, temp);
+}
+
+template <typename T, size_t Tag1, size_t Tag2, size_t Tag3, size_t Tag4>
+void convolve(univector<T, Tag1>& dest, const univector<T, Tag2>& src1, const univector<T, Tag3>& src2,
+              univector<u8, Tag4>& temp)
+{
+    internal::convolve(dest.data(), src1.data(), src1.size(), src2.data(), src2.size(), temp.data());
+}
+
+template <typename T, size_t Tag1, size_t Tag2, size_t Tag3, size_t Tag4>
+void correlate(univector<T, Tag1>& dest, const univector<T, Tag2>& src1, const univector<T, Tag3>& src2,
+               univector<u8, Tag4>& temp)
+{
+    internal::correlate(dest.data(), src1.data(), src1.size(), src2.data(), src2.size(), temp.data());
+}
+
 template <typename T>
 class convolve_filter : public filter<T>
 {
 public:
-    explicit convolve_filter(size_t size, size_t block_size = 1024);
-    explicit convolve_filter(const univector<T>& data, size_t block_size = 1024);
+    /// @brief If buffered is true, the input is collected in a FIFO and transformed once per block_size
+    /// samples regardless of the size of the processed chunks, delaying the output by block_size samples.
+    /// Otherwise the output is not delayed but each call transforms the whole block
+    explicit convolve_filter(size_t size, size_t block_size = 1024, bool buffered = false);
+    explicit convolve_filter(const univector<T>& data, size_t block_size = 1024, bool buffered = false);
     void set_data(const univector<T>& data);
 
+    /// @brief Prepares a new impulse response that replaces the current one with a crossfade over one block.
+    /// May be called from a thread other than the processing thread, does not interrupt processing
+    /// and performs no allocation on the processing thread. The response must not be longer than
+    /// the size given at construction. Returns false if the response is too long
+    /// or the previous replacement has not finished yet
+    bool prepare_data(const univector<T>& data);
+
+    /// @brief Delay of the output in samples
+    size_t latency() const { return buffered ? block_size : 0; }
+
 protected:
     void process_expression(T* dest, const expression_pointer<T>& src, size_t size) final
     {
@@ -87,6 +147,18 @@ protected:
     }
     void process_buffer(T* output, const T* input, size_t size) final;
 
+    void transform_segments(std::vector<univector<complex<T>>>& ir, const univector<T>& data, u8* temp) const;
+    void premultiply(univector<complex<T>>& result, const std::vector<univector<complex<T>>>& ir);
+    void begin_crossfade();
+
+    enum swap_state_t
+    {
+        swap_idle,
+        swap_preparing,
+        swap_ready,
+        swap_crossfading
+    };
+
     const dft_plan_real<T> fft;
     univector<u8> temp;
     std::vector<univector<complex<T>>> segments;
@@ -100,6 +172,187 @@ protected:
     univector<T> scratch;
     univector<T> overlap;
     size_t position;
+    const bool buffered;
+    univector<T> output_fifo;
+
+    std::atomic<int> swap_state;
+    std::vector<univector<complex<T>>> next_ir_segments;
+    univector<complex<T>> next_premul;
+    univector<complex<T>> next_cscratch;
+    univector<T> next_scratch;
+    univector<T> next_overlap;
+};
+
+/// @brief Convolution of several inputs with a matrix of impulse responses given as data[input][output].
+/// Each input is transformed once per block and the products of all inputs are accumulated in the spectrum
+/// of each output, so a block costs one forward transform per input and one inverse transform per output.
+/// Empty responses are skipped. The output is delayed by block_size samples
+template <typename T>
+class convolve_matrix
+{
+public:
+    explicit convolve_matrix(const std::vector<std::vector<univector<T>>>& data, size_t block_size = 1024);
+
+    size_t inputs() const { return input_count; }
+    size_t outputs() const { return output_count; }
+
+    /// @brief Delay of the output in samples
+    size_t latency() const { return block_size; }
+
+    void reset();
+
+    /// @brief Processes size samples of each channel, output and input point to arrays of channel pointers
+    void apply(T* const* output, const T* const* input, size_t size);
+
+protected:
+    void process_block();
+
+    const dft_plan_real<T> fft;
+    const size_t block_size;
+    const size_t input_count;
+    const size_t output_count;
+    univector<u8> temp;
+    std::vector<std::vector<univector<complex<T>>>> segments;
+    std::vector<std::vector<univector<complex<T>>>> ir_segments;
+    std::vector<univector<T>> input_fifo;
+    std::vector<univector<T>> output_fifo;
+    std::vector<univector<T>> overlap;
+    univector<complex<T>> premul;
+    univector<T> scratch;
+    size_t fifo_position;
+    size_t position;
+};
+
+/// @brief Partitioned frequency-domain block NLMS adaptive filter for long responses such as echo paths.
+/// The coefficients are split into partitions of block_size samples held as spectra, a block costs
+/// three transforms plus two per partition instead of 2 * tapcount multiplies per sample.
+/// The step of each frequency bin is normalized by the input power in that bin summed over the partitions,
+/// steps between 0 and 1 are stable. The outputs are delayed by block_size samples
+template <typename T>
+class partitioned_lms_filter
+{
+public:
+    explicit partitioned_lms_filter(size_t tapcount, T step = T(0.5), size_t block_size = 256,
+                                    T regularization = T(1e-6));
+
+    size_t tapcount() const { return partitions * block_size; }
+
+    /// @brief Delay of the outputs in samples
+    size_t latency() const { return block_size; }
+
+    /// @brief Current coefficients, the first one applies to the most recent input sample
+    univector<T> taps() const;
+
+    void reset();
+
+    /// @brief Filters size samples of input and adapts the coefficients towards desired once per block.
+    /// Writes the estimate of desired to output and the difference desired - estimate to error,
+    /// either of them may be nullptr
+    void apply(T* output, T* error, const T* input, const T* desired, size_t size);
+
+protected:
+    void process_block();
+
+    const dft_plan_real<T> fft;
+    const size_t block_size;
+    const size_t partitions;
+    const T step;
+    const T regularization;
+    univector<u8> temp;
+    std::vector<univector<complex<T>>> segments;
+    std::vector<univector<complex<T>>> weights;
+    univector<T> power;
+    univector<T> previous_input;
+    univector<T> input_fifo;
+    univector<T> desired_fifo;
+    univector<T> output_fifo;
+    univector<T> error_fifo;
+    univector<complex<T>> spectrum;
+    univector<complex<T>> gradient;
+    univector<T> scratch;
+    size_t fifo_position;
+    size_t position;
+};
+
+namespace internal
+{
+// One stage of the non-uniform convolver: uniformly partitioned overlap-save convolution
+// of a part of the impulse response starting at offset
+template <typename T>
+struct convolve_stage
+{
+    size_t partition;
+    size_t offset;
+    bool background;
+    dft_plan_real_ptr<T> fft;
+    univector<u8> temp;
+    std::vector<univector<complex<T>>> segments;
+    std::vector<univector<complex<T>>> ir_segments;
+    size_t position;
+    univector<T> input;
+    size_t input_position;
+    univector<T> frame;
+    univector<complex<T>> premul;
+    univector<T> output;
+
+    void process(const T* frame);
+};
+
+// Background thread and job states of the non-uniform convolver, defined in dft-src.cpp
+template <typename T>
+struct convolve_worker;
+} // namespace internal
+
+/// @brief Convolution with long impulse responses using partitions of growing size.
+/// The head of the response uses partitions of block_size samples and each following stage doubles
+/// the partition size up to max_block_size, so the cost per sample grows with the logarithm
+/// of the response length instead of linearly. The latency is block_size samples.
+/// If background is true, stages after the first are computed on a background thread. A job is queued
+/// when the input partition of its stage is complete and is due partition / block_size blocks later,
+/// when its output is first needed. Queueing a job takes a mutex that the thread holds only to pick
+/// its next job. A job that is not finished when due is late: if the thread has not started it, process
+/// runs it itself, otherwise process sleeps until the thread finishes it. Either way the block takes
+/// longer than usual
+template <typename T>
+class nonuniform_convolve_filter : public filter<T>
+{
+public:
+    explicit nonuniform_convolve_filter(const univector<T>& data, size_t block_size = 64,
+                                        size_t max_block_size = 8192, bool background = true);
+    ~nonuniform_convolve_filter();
+
+    void reset() final;
+
+    /// @brief Delay of the output in samples
+    size_t latency() const { return block_size; }
+
+    /// @brief Number of background jobs that missed their deadline since the last reset,
+    /// can be read from any thread
+    size_t late() const { return late_count.load(std::memory_order_relaxed); }
+
+protected:
+    void process_expression(T* dest, const expression_pointer<T>& src, size_t size) final
+    {
+        univector<T> input = truncate(src, size);
+        process_buffer(dest, input.data(), input.size());
+    }
+    void process_buffer(T* output, const T* input, size_t size) final;
+
+    void process_block();
+    void finish(size_t stage);
+    void accumulate(const T* data, size_t offset, size_t size);
+    void worker_loop();
+
+    const size_t block_size;
+    std::vector<internal::convolve_stage<T>> stages;
+    univector<T> input_fifo;
+    univector<T> output_fifo;
+    size_t fifo_position;
+    univector<T> accumulator;
+    size_t accumulator_position;
+    size_t block_count;
+    std::atomic<size_t> late_count;
+    std::unique_ptr<internal::convolve_worker<T>> worker;
 };
 
 } // namespace kfr
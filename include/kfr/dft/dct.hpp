@@ -0,0 +1,117 @@
+/** @addtogroup dft
+ *  @{
+ */
+/*
+  Copyright (C) 2016 D Levin (https://www.kfrlib.com)
+  This file is part of KFR
+
+  KFR is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  KFR is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with KFR.
+
+  If GPL is not suitable for your project, you must purchase a commercial license to use KFR.
+  Buying a commercial license is mandatory as soon as you develop commercial activities without
+  disclosing the source code of your own applications.
+  See https://www.kfrlib.com for details.
+ */
+#pragma once
+
+#include "fft.hpp"
+
+namespace kfr
+{
+
+enum class dct_type
+{
+    II,
+    III,
+    IV
+};
+
+// Unnormalized discrete cosine and sine transforms of even size computed with a real FFT of the same size
+// DCT-II:  X[k] = sum x[n] * cos(pi / N * (n + 0.5) * k)
+// DCT-III: x[n] = X[0] / 2 + sum(k >= 1) X[k] * cos(pi / N * (n + 0.5) * k)
+// DCT-IV:  X[k] = sum x[n] * cos(pi / N * (n + 0.5) * (k + 0.5))
+// DST-II:  X[k] = sum x[n] * sin(pi / N * (n + 0.5) * (k + 1))
+// DST-III: x[n] = (-1)^n * X[N - 1] / 2 + sum(k < N - 1) X[k] * sin(pi / N * (n + 0.5) * (k + 1))
+// DST-IV:  X[k] = sum x[n] * sin(pi / N * (n + 0.5) * (k + 0.5))
+// Type III is the inverse of type II and type IV is the inverse of itself, both scaled by N / 2
+template <typename T>
+struct dct_plan
+{
+    size_t size;
+    dct_type type;
+    size_t temp_size;
+
+    dct_plan(size_t size, dct_type type);
+
+    // out and in may point to the same buffer
+    void execute(T* out, const T* in, u8* temp) const { execute_dct(cfalse, out, in, temp); }
+    void execute_dst(T* out, const T* in, u8* temp) const { execute_dct(ctrue, out, in, temp); }
+
+    template <size_t Tag1, size_t Tag2, size_t Tag3>
+    KFR_INTRIN void execute(univector<T, Tag1>& out, const univector<T, Tag2>& in,
+                            univector<u8, Tag3>& temp) const
+    {
+        execute_dct(cfalse, out.data(), in.data(), temp.data());
+    }
+    template <size_t Tag1, size_t Tag2, size_t Tag3>
+    KFR_INTRIN void execute_dst(univector<T, Tag1>& out, const univector<T, Tag2>& in,
+                                univector<u8, Tag3>& temp) const
+    {
+        execute_dct(ctrue, out.data(), in.data(), temp.data());
+    }
+
+private:
+    template <bool sine>
+    void execute_dct(cbool_t<sine>, T* out, const T* in, u8* temp) const;
+
+    // Type II and III use the real transform, type IV uses its half-size complex transform
+    dft_plan_real<T> plan;
+    univector<complex<T>> twiddle;
+    univector<complex<T>> post_twiddle;
+};
+
+// Modified DCT of frames of 2 * size samples producing size coefficients (size must be even)
+// X[k] = sum(n < 2 * size) w[n] * x[n] * cos(pi / size * (n + 0.5 + size / 2) * (k + 0.5))
+// The inverse produces 2 * size windowed samples, with the window satisfying the Princen-Bradley
+// condition, overlap-adding consecutive frames with the hop of size restores the input scaled by size / 2
+template <typename T>
+struct mdct_plan
+{
+    size_t size;
+    size_t temp_size;
+
+    // window has 2 * size values or is empty for the rectangular window
+    explicit mdct_plan(size_t size, const univector<T>& window = univector<T>());
+
+    void execute(T* out, const T* in, u8* temp) const;
+    void execute_inverse(T* out, const T* in, u8* temp) const;
+
+    template <size_t Tag1, size_t Tag2, size_t Tag3>
+    KFR_INTRIN void execute(univector<T, Tag1>& out, const univector<T, Tag2>& in,
+                            univector<u8, Tag3>& temp) const
+    {
+        execute(out.data(), in.data(), temp.data());
+    }
+    template <size_t Tag1, size_t Tag2, size_t Tag3>
+    KFR_INTRIN void execute_inverse(univector<T, Tag1>& out, const univector<T, Tag2>& in,
+                                    univector<u8, Tag3>& temp) const
+    {
+        execute_inverse(out.data(), in.data(), temp.data());
+    }
+
+private:
+    dct_plan<T> dct;
+    univector<T> window;
+};
+} // namespace kfr
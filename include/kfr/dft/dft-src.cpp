@@ -29,8 +29,15 @@
 #include "bitrev.hpp"
 #include "cache.hpp"
 #include "convolution.hpp"
+#include "dct.hpp"
 #include "fft.hpp"
 #include "ft.hpp"
+#ifndef KFR_SINGLE_THREAD
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#endif
 
 CMT_PRAGMA_GNU(GCC diagnostic push)
 #if CMT_HAS_WARNING("-Wshadow")
@@ -54,20 +61,40 @@ struct dft_stage
     size_t stage_size = 0;
     size_t data_size  = 0;
     size_t temp_size  = 0;
-    u8* data          = nullptr;
+    const u8* data    = nullptr;
     size_t repeats    = 1;
+    size_t radix      = 0;
+    size_t blocks     = 1;
     size_t out_offset = 0;
     const char* name;
     bool recursion = false;
+    // The stage can read split-format input with execute_split_input
+    bool split_input = false;
+    // The stage can write split-format output with execute_split_output
+    bool split_output = false;
 
-    void initialize(size_t size) { do_initialize(size); }
+    // Writes the precomputed data to data, the storage this->data points to
+    void initialize(u8* data, size_t size) { do_initialize(data, size); }
 
     KFR_INTRIN void execute(complex<T>* out, const complex<T>* in, u8* temp) { do_execute(out, in, temp); }
+    KFR_INTRIN void execute_split_input(complex<T>* out, const T* in_re, const T* in_im, u8* temp)
+    {
+        do_execute_split_input(out, in_re, in_im, temp);
+    }
+    KFR_INTRIN void execute_split_output(T* out_re, T* out_im, const complex<T>* in, u8* temp)
+    {
+        do_execute_split_output(out_re, out_im, in, temp);
+    }
     virtual ~dft_stage() {}
 
+    // Plans used by the stage in the order of their creation
+    virtual std::vector<const dft_plan<T>*> nested_plans() const { return {}; }
+
 protected:
-    virtual void do_initialize(size_t) {}
+    virtual void do_initialize(u8*, size_t) {}
     virtual void do_execute(complex<T>*, const complex<T>*, u8* temp) = 0;
+    virtual void do_execute_split_input(complex<T>*, const T*, const T*, u8*) {}
+    virtual void do_execute_split_output(T*, T*, const complex<T>*, u8*) {}
 };
 
 CMT_PRAGMA_GNU(GCC diagnostic push)
@@ -156,22 +183,16 @@ KFR_SINTRIN cvec<T, width> radix4_apply_twiddle(csize_t<width>, ctrue_t /*split_
         return concat(b1re - im1 * twim, b1im + re1 * twim);
 }
 
-template <size_t width, bool splitout, bool splitin, bool use_br2, bool inverse, bool aligned, typename T>
-KFR_SINTRIN void radix4_body(size_t N, csize_t<width>, ctrue_t, cbool_t<splitout>, cbool_t<splitin>,
-                             cbool_t<use_br2>, cbool_t<inverse>, cbool_t<aligned>, complex<T>* out,
-                             const complex<T>* in, const complex<T>* twiddle)
+template <size_t width, bool write_split, bool use_br2, bool inverse, bool aligned, typename T>
+KFR_SINTRIN void radix4_body_split(size_t N, cbool_t<write_split>, cbool_t<use_br2>, cbool_t<inverse>,
+                                   cbool_t<aligned>, complex<T>* out, const vec<T, width>& re0,
+                                   const vec<T, width>& im0, const vec<T, width>& re1,
+                                   const vec<T, width>& im1, const vec<T, width>& re2,
+                                   const vec<T, width>& im2, const vec<T, width>& re3,
+                                   const vec<T, width>& im3, const complex<T>* twiddle)
 {
     const size_t N4 = N / 4;
     cvec<T, width> w1, w2, w3;
-    constexpr bool read_split  = !splitin && splitout;
-    constexpr bool write_split = splitin && !splitout;
-
-    vec<T, width> re0, im0, re1, im1, re2, im2, re3, im3;
-
-    split(cread_split<width, aligned, read_split>(in + N4 * 0), re0, im0);
-    split(cread_split<width, aligned, read_split>(in + N4 * 1), re1, im1);
-    split(cread_split<width, aligned, read_split>(in + N4 * 2), re2, im2);
-    split(cread_split<width, aligned, read_split>(in + N4 * 3), re3, im3);
 
     const vec<T, width> sum02re = re0 + re2;
     const vec<T, width> sum02im = im0 + im2;
@@ -200,6 +221,39 @@ KFR_SINTRIN void radix4_body(size_t N, csize_t<width>, ctrue_t, cbool_t<splitout
                                            cread<width, true>(twiddle + width * 2)));
 }
 
+template <size_t width, bool splitout, bool splitin, bool use_br2, bool inverse, bool aligned, typename T>
+KFR_SINTRIN void radix4_body(size_t N, csize_t<width>, ctrue_t, cbool_t<splitout>, cbool_t<splitin>,
+                             cbool_t<use_br2>, cbool_t<inverse>, cbool_t<aligned>, complex<T>* out,
+                             const complex<T>* in, const complex<T>* twiddle)
+{
+    const size_t N4            = N / 4;
+    constexpr bool read_split  = !splitin && splitout;
+    constexpr bool write_split = splitin && !splitout;
+
+    vec<T, width> re0, im0, re1, im1, re2, im2, re3, im3;
+
+    split(cread_split<width, aligned, read_split>(in + N4 * 0), re0, im0);
+    split(cread_split<width, aligned, read_split>(in + N4 * 1), re1, im1);
+    split(cread_split<width, aligned, read_split>(in + N4 * 2), re2, im2);
+    split(cread_split<width, aligned, read_split>(in + N4 * 3), re3, im3);
+
+    radix4_body_split(N, cbool_t<write_split>(), cbool_t<use_br2>(), cbool_t<inverse>(), cbool_t<aligned>(),
+                      out, re0, im0, re1, im1, re2, im2, re3, im3, twiddle);
+}
+
+// Same as radix4_body with split output, but reads the real and imaginary parts from separate arrays
+template <size_t width, bool use_br2, bool inverse, bool aligned, typename T>
+KFR_SINTRIN void radix4_body(size_t N, csize_t<width>, cbool_t<use_br2>, cbool_t<inverse>, cbool_t<aligned>,
+                             complex<T>* out, const T* in_re, const T* in_im, const complex<T>* twiddle)
+{
+    const size_t N4 = N / 4;
+    radix4_body_split(N, cfalse, cbool_t<use_br2>(), cbool_t<inverse>(), cbool_t<aligned>(), out,
+                      read<width, aligned>(in_re + N4 * 0), read<width, aligned>(in_im + N4 * 0),
+                      read<width, aligned>(in_re + N4 * 1), read<width, aligned>(in_im + N4 * 1),
+                      read<width, aligned>(in_re + N4 * 2), read<width, aligned>(in_im + N4 * 2),
+                      read<width, aligned>(in_re + N4 * 3), read<width, aligned>(in_im + N4 * 3), twiddle);
+}
+
 template <typename T>
 CMT_NOINLINE cvec<T, 1> calculate_twiddle(size_t n, size_t size)
 {
@@ -207,15 +261,15 @@ CMT_NOINLINE cvec<T, 1> calculate_twiddle(size_t n, size_t size)
     {
         return make_vector(static_cast<T>(1), static_cast<T>(0));
     }
-    else if (n == size / 4)
+    else if (n * 4 == size)
     {
         return make_vector(static_cast<T>(0), static_cast<T>(-1));
     }
-    else if (n == size / 2)
+    else if (n * 2 == size)
     {
         return make_vector(static_cast<T>(-1), static_cast<T>(0));
     }
-    else if (n == size * 3 / 4)
+    else if (n * 4 == size * 3)
     {
         return make_vector(static_cast<T>(0), static_cast<T>(1));
     }
@@ -287,6 +341,15 @@ KFR_SINTRIN void prefetch_four(size_t stride, const complex<T>* in)
     KFR_PREFETCH(in + stride * 3);
 }
 
+template <typename T>
+KFR_SINTRIN void prefetch_four(size_t stride, const T* in)
+{
+    KFR_PREFETCH(in);
+    KFR_PREFETCH(in + stride);
+    KFR_PREFETCH(in + stride * 2);
+    KFR_PREFETCH(in + stride * 3);
+}
+
 template <typename Ntype, size_t width, bool splitout, bool splitin, bool prefetch, bool use_br2,
           bool inverse, bool aligned, typename T>
 KFR_SINTRIN cfalse_t radix4_pass(Ntype N, size_t blocks, csize_t<width>, cbool_t<splitout>, cbool_t<splitin>,
@@ -320,6 +383,31 @@ KFR_SINTRIN cfalse_t radix4_pass(Ntype N, size_t blocks, csize_t<width>, cbool_t
     return {};
 }
 
+// First radix-4 pass of a transform, reads split-format input and writes split output
+template <size_t width, bool prefetch, bool use_br2, bool inverse, bool aligned, typename T>
+KFR_SINTRIN void radix4_pass(size_t N, csize_t<width>, cbool_t<use_br2>, cbool_t<prefetch>, cbool_t<inverse>,
+                             cbool_t<aligned>, complex<T>* out, const T* in_re, const T* in_im,
+                             const complex<T>* twiddle)
+{
+    constexpr static size_t prefetch_offset = width * 16;
+    const size_t N4                         = N / 4;
+    CMT_ASSUME(N4 > 0);
+    CMT_PRAGMA_CLANG(clang loop unroll_count(2))
+    for (size_t n2 = 0; n2 < N4; n2 += width)
+    {
+        if (prefetch)
+        {
+            prefetch_four(N4, in_re + prefetch_offset);
+            prefetch_four(N4, in_im + prefetch_offset);
+        }
+        radix4_body(N, csize_t<width>(), cbool_t<use_br2>(), cbool_t<inverse>(), cbool_t<aligned>(), out,
+                    in_re, in_im, twiddle + n2 * 3);
+        in_re += width;
+        in_im += width;
+        out += width;
+    }
+}
+
 template <size_t width, bool prefetch, bool use_br2, bool inverse, bool aligned, typename T>
 KFR_SINTRIN ctrue_t radix4_pass(csize_t<32>, size_t blocks, csize_t<width>, cfalse_t, cfalse_t,
                                 cbool_t<use_br2>, cbool_t<prefetch>, cbool_t<inverse>, cbool_t<aligned>,
@@ -443,9 +531,10 @@ struct fft_stage_impl : dft_stage<T>
 {
     fft_stage_impl(size_t stage_size)
     {
-        this->stage_size = stage_size;
-        this->repeats    = 4;
-        this->recursion  = true;
+        this->stage_size  = stage_size;
+        this->repeats     = 4;
+        this->recursion   = true;
+        this->split_input = !splitin;
         this->data_size =
             align_up(sizeof(complex<T>) * stage_size / 4 * 3, platform<>::native_cache_alignment);
     }
@@ -455,9 +544,9 @@ protected:
     constexpr static bool aligned  = false;
     constexpr static size_t width  = fft_vector_width<T>;
 
-    virtual void do_initialize(size_t size) override final
+    virtual void do_initialize(u8* data, size_t size) override final
     {
-        complex<T>* twiddle = ptr_cast<complex<T>>(this->data);
+        complex<T>* twiddle = ptr_cast<complex<T>>(data);
         initialize_twiddles<T, width>(twiddle, this->stage_size, size, true);
     }
 
@@ -472,6 +561,17 @@ protected:
         radix4_pass(stg_size, 1, csize_t<width>(), ctrue, cbool_t<splitin>(), cbool_t<!is_even>(),
                     cbool_t<prefetch>(), cbool_t<inverse>(), cbool_t<aligned>(), out, in, twiddle);
     }
+
+    virtual void do_execute_split_input(complex<T>* out, const T* in_re, const T* in_im,
+                                        u8* /*temp*/) override final
+    {
+        const complex<T>* twiddle = ptr_cast<complex<T>>(this->data);
+        const size_t stg_size     = this->stage_size;
+        CMT_ASSUME(stg_size >= 2048);
+        CMT_ASSUME(stg_size % 2048 == 0);
+        radix4_pass(stg_size, csize_t<width>(), cbool_t<!is_even>(), cbool_t<prefetch>(), cbool_t<inverse>(),
+                    cbool_t<aligned>(), out, in_re, in_im, twiddle);
+    }
 };
 
 template <typename T, bool splitin, size_t size, bool inverse>
@@ -479,11 +579,12 @@ struct fft_final_stage_impl : dft_stage<T>
 {
     fft_final_stage_impl(size_t)
     {
-        this->stage_size = size;
-        this->out_offset = size;
-        this->repeats    = 4;
-        this->recursion  = true;
-        this->data_size  = align_up(sizeof(complex<T>) * size * 3 / 2, platform<>::native_cache_alignment);
+        this->stage_size  = size;
+        this->out_offset  = size;
+        this->repeats     = 4;
+        this->recursion   = true;
+        this->split_input = !splitin;
+        this->data_size   = align_up(sizeof(complex<T>) * size * 3 / 2, platform<>::native_cache_alignment);
     }
 
 protected:
@@ -505,9 +606,9 @@ protected:
         init_twiddles(csize<N / 4>, total_size, cbool<pass_split>, twiddle);
     }
 
-    virtual void do_initialize(size_t total_size) override final
+    virtual void do_initialize(u8* data, size_t total_size) override final
     {
-        complex<T>* twiddle = ptr_cast<complex<T>>(this->data);
+        complex<T>* twiddle = ptr_cast<complex<T>>(data);
         init_twiddles(csize<size>, total_size, cbool<splitin>, twiddle);
     }
 
@@ -517,6 +618,17 @@ protected:
         final_stage(csize<size>, 1, cbool<splitin>, out, in, twiddle);
     }
 
+    // The first pass writes split output, as in final_stage
+    virtual void do_execute_split_input(complex<T>* out, const T* in_re, const T* in_im,
+                                        u8* /*temp*/) override
+    {
+        const complex<T>* twiddle = ptr_cast<complex<T>>(this->data);
+        radix4_pass(size, csize_t<width>(), cbool_t<use_br2>(), cbool_t<prefetch>(), cbool_t<inverse>(),
+                    cbool_t<aligned>(), out, in_re, in_im, twiddle);
+        twiddle += size / 4 * 3;
+        final_stage(csize<size / 4>, 4, ctrue, out, out, twiddle);
+    }
+
     //    KFR_INTRIN void final_stage(csize_t<32>, size_t invN, cfalse_t, complex<T>* out, const complex<T>*,
     //                                const complex<T>*& twiddle)
     //    {
@@ -566,20 +678,27 @@ struct fft_reorder_stage_impl : dft_stage<T>
 {
     fft_reorder_stage_impl(size_t stage_size)
     {
-        this->stage_size = stage_size;
-        log2n            = ilog2(stage_size);
-        this->data_size  = 0;
+        this->stage_size   = stage_size;
+        this->split_output = true;
+        log2n              = ilog2(stage_size);
+        this->data_size    = 0;
     }
 
 protected:
     size_t log2n;
 
-    virtual void do_initialize(size_t) override final {}
+    virtual void do_initialize(u8*, size_t) override final {}
 
     virtual void do_execute(complex<T>* out, const complex<T>*, u8* /*temp*/) override final
     {
         fft_reorder(out, log2n, cbool_t<!is_even>());
     }
+
+    virtual void do_execute_split_output(T* out_re, T* out_im, const complex<T>* in,
+                                         u8* /*temp*/) override final
+    {
+        fft_reorder(out_re, out_im, in, log2n, cbool_t<!is_even>());
+    }
 };
 
 template <typename T, size_t log2n, bool inverse>
@@ -692,9 +811,9 @@ protected:
     constexpr static size_t final_size   = is_double ? 8 : 32;
     constexpr static size_t split_format = final_size == 8;
 
-    virtual void do_initialize(size_t total_size) override final
+    virtual void do_initialize(u8* data, size_t total_size) override final
     {
-        complex<T>* twiddle = ptr_cast<complex<T>>(this->data);
+        complex<T>* twiddle = ptr_cast<complex<T>>(data);
         initialize_twiddles<T, width>(twiddle, 128, total_size, split_format);
         initialize_twiddles<T, width>(twiddle, 32, total_size, split_format);
         initialize_twiddles<T, width>(twiddle, 8, total_size, split_format);
@@ -773,6 +892,13 @@ struct fft_specialization<double, 8, inverse> : fft_final_stage_impl<double, fal
         fft_final_stage_impl<double, false, 256, inverse>::do_execute(out, in, nullptr);
         fft_reorder(out, csize_t<8>());
     }
+
+    virtual void do_execute_split_input(complex<T>* out, const T* in_re, const T* in_im,
+                                        u8* /*temp*/) override final
+    {
+        fft_final_stage_impl<double, false, 256, inverse>::do_execute_split_input(out, in_re, in_im, nullptr);
+        fft_reorder(out, csize_t<8>());
+    }
 };
 
 template <typename T, bool splitin, bool is_even>
@@ -799,227 +925,1414 @@ struct fft_specialization_t
     template <bool inverse>
     using type = internal::fft_specialization<T, log2n, inverse>;
 };
-} // namespace internal
-
-//
 
 template <typename T>
-template <template <bool inverse> class Stage>
-void dft_plan<T>::add_stage(size_t stage_size, cbools_t<true, true>)
+KFR_SINTRIN void initialize_radix_twiddles(csize_t<0>, complex<T>*&, size_t, size_t, size_t&)
 {
-    dft_stage<T>* direct_stage  = new Stage<false>(stage_size);
-    direct_stage->name          = nullptr;
-    dft_stage<T>* inverse_stage = new Stage<true>(stage_size);
-    inverse_stage->name         = nullptr;
-    this->data_size += direct_stage->data_size;
-    this->temp_size += direct_stage->temp_size;
-    stages[0].push_back(dft_stage_ptr(direct_stage));
-    stages[1].push_back(dft_stage_ptr(inverse_stage));
 }
 
-template <typename T>
-template <template <bool inverse> class Stage>
-void dft_plan<T>::add_stage(size_t stage_size, cbools_t<true, false>)
+template <typename T, size_t width>
+KFR_SINTRIN void initialize_radix_twiddles(csize_t<width>, complex<T>*& twiddle, size_t radix,
+                                           size_t iterations, size_t& i)
 {
-    dft_stage<T>* direct_stage = new Stage<false>(stage_size);
-    direct_stage->name         = nullptr;
-    this->data_size += direct_stage->data_size;
-    this->temp_size += direct_stage->temp_size;
-    stages[0].push_back(dft_stage_ptr(direct_stage));
+    // Same layout as butterfly_helper expects: radix - 1 vectors of width twiddles per group
+    const size_t size = radix * iterations;
+    CMT_LOOP_NOUNROLL
+    for (; i < iterations / width * width; i += width)
+    {
+        CMT_LOOP_NOUNROLL
+        for (size_t r = 1; r < radix; r++)
+        {
+            CMT_LOOP_NOUNROLL
+            for (size_t j = 0; j < width; j++)
+            {
+                cwrite<1>(twiddle++, calculate_twiddle<T>(r * (i + j), size));
+            }
+        }
+    }
+    initialize_radix_twiddles(csize_t<width / 2>(), twiddle, radix, iterations, i);
 }
 
 template <typename T>
-template <template <bool inverse> class Stage>
-void dft_plan<T>::add_stage(size_t stage_size, cbools_t<false, true>)
+CMT_NOINLINE void initialize_generic_twiddles(complex<T>* twiddle, size_t radix)
 {
-    dft_stage<T>* inverse_stage = new Stage<true>(stage_size);
-    inverse_stage->name         = nullptr;
-    this->data_size += inverse_stage->data_size;
-    this->temp_size += inverse_stage->temp_size;
-    stages[1].push_back(dft_stage_ptr(inverse_stage));
+    const size_t halfradix = radix / 2;
+    CMT_LOOP_NOUNROLL
+    for (size_t i = 0; i < halfradix; i++)
+    {
+        CMT_LOOP_NOUNROLL
+        for (size_t j = 0; j < halfradix; j++)
+        {
+            cwrite<1>(twiddle++, calculate_twiddle<T>((i + 1) * (j + 1) % radix, radix));
+        }
+    }
 }
 
-template <typename T>
-template <bool direct, bool inverse, bool is_even, bool first>
-void dft_plan<T>::make_fft(size_t stage_size, cbools_t<direct, inverse> type, cbool_t<is_even>,
-                           cbool_t<first>)
-{
-    constexpr size_t final_size = is_even ? 1024 : 512;
+constexpr csizes_t<2, 3, 4, 5, 6, 7, 8, 10> dft_radices{};
 
-    using fft_stage_impl_t       = internal::fft_stage_impl_t<T, !first, is_even>;
-    using fft_final_stage_impl_t = internal::fft_final_stage_impl_t<T, !first, final_size>;
+template <size_t radix, typename T>
+constexpr size_t dft_radix_width = radix >= 7 ? const_max(size_t(1), fft_vector_width<T> / 2)
+                                              : radix >= 4 ? fft_vector_width<T> : fft_vector_width<T> * 2;
 
-    if (stage_size >= 2048)
+template <typename T>
+inline void dft_digitreverse(complex<T>*& out, const complex<T>* in, const size_t* radices,
+                             const size_t* strides, size_t level)
+{
+    const size_t radix  = radices[level];
+    const size_t stride = strides[level];
+    if (level == 0)
     {
-        add_stage<fft_stage_impl_t::template type>(stage_size, type);
-
-        make_fft(stage_size / 4, cbools_t<direct, inverse>(), cbool_t<is_even>(), cfalse);
+        CMT_LOOP_NOUNROLL
+        for (size_t k = 0; k < radix; k++)
+            *out++ = in[k * stride];
     }
     else
     {
-        add_stage<fft_final_stage_impl_t::template type>(final_size, type);
+        CMT_LOOP_NOUNROLL
+        for (size_t k = 0; k < radix; k++)
+            dft_digitreverse(out, in + k * stride, radices, strides, level - 1);
     }
 }
 
 template <typename T>
-template <bool direct, bool inverse>
-void dft_plan<T>::initialize(cbools_t<direct, inverse>)
+inline void dft_digitreverse(T*& out_re, T*& out_im, const complex<T>* in, const size_t* radices,
+                             const size_t* strides, size_t level)
 {
-    data = autofree<u8>(data_size);
-    if (direct)
+    const size_t radix  = radices[level];
+    const size_t stride = strides[level];
+    if (level == 0)
     {
-        size_t offset = 0;
-        for (dft_stage_ptr& stage : stages[0])
+        CMT_LOOP_NOUNROLL
+        for (size_t k = 0; k < radix; k++)
         {
-            stage->data = data.data() + offset;
-            stage->initialize(this->size);
-            offset += stage->data_size;
+            *out_re++ = in[k * stride].real();
+            *out_im++ = in[k * stride].imag();
         }
     }
-    if (inverse)
+    else
     {
-        size_t offset = 0;
-        for (dft_stage_ptr& stage : stages[1])
-        {
-            stage->data = data.data() + offset;
-            if (!direct)
-                stage->initialize(this->size);
-            offset += stage->data_size;
-        }
+        CMT_LOOP_NOUNROLL
+        for (size_t k = 0; k < radix; k++)
+            dft_digitreverse(out_re, out_im, in + k * stride, radices, strides, level - 1);
     }
 }
 
+// Common part of the last stage of a mixed-radix transform.
+// The last stage writes its output transposed and, if there are more than two radices,
+// digit-reverses the result so that the output is in natural order.
+// Split-format output is written by the digit reversal, or by the copy from the scratch buffer
 template <typename T>
-template <bool inverse>
-void dft_plan<T>::execute_dft(cbool_t<inverse>, complex<T>* out, const complex<T>* in, u8* temp) const
+struct dft_final_stage_base : dft_stage<T>
 {
-    size_t stack[32] = { 0 };
+    dft_final_stage_base(size_t radix, size_t blocks, const size_t* radices, size_t count) : count(count)
+    {
+        this->radix        = radix;
+        this->blocks       = blocks;
+        this->stage_size   = radix * blocks;
+        this->split_output = true;
+        this->temp_size =
+            align_up(sizeof(complex<T>) * this->stage_size, platform<>::native_cache_alignment);
+        size_t stride    = 1;
+        for (size_t i = count - 1; i-- > 0;)
+        {
+            this->radices[i] = radices[i];
+            this->strides[i] = stride;
+            stride *= radices[i];
+        }
+    }
 
-    const size_t count = stages[inverse].size();
+protected:
+    size_t radices[64];
+    size_t strides[64];
+    size_t count;
 
-    for (size_t depth = 0; depth < count;)
+    template <typename Fn>
+    KFR_INTRIN void execute_final(complex<T>* out, const complex<T>* in, u8* temp, Fn&& fn)
     {
-        if (stages[inverse][depth]->recursion)
+        const size_t size   = this->stage_size;
+        complex<T>* scratch = ptr_cast<complex<T>>(temp);
+        temp += align_up(sizeof(complex<T>) * size, platform<>::native_cache_alignment);
+        if (count > 2)
         {
-            complex<T>* rout      = out;
-            const complex<T>* rin = in;
-            size_t rdepth         = depth;
-            size_t maxdepth       = depth;
-            do
-            {
-                if (stack[rdepth] == stages[inverse][rdepth]->repeats)
-                {
-                    stack[rdepth] = 0;
-                    rdepth--;
-                }
-                else
-                {
-                    stages[inverse][rdepth]->execute(rout, rin, temp);
-                    rout += stages[inverse][rdepth]->out_offset;
-                    rin = rout;
-                    stack[rdepth]++;
-                    if (rdepth < count - 1 && stages[inverse][rdepth + 1]->recursion)
-                        rdepth++;
-                    else
-                        maxdepth = rdepth;
-                }
-            } while (rdepth != depth);
-            depth = maxdepth + 1;
+            fn(scratch, in, temp);
+            const size_t group = this->blocks;
+            CMT_LOOP_NOUNROLL
+            for (size_t g = 0; g < this->radix; g++)
+                dft_digitreverse(out, scratch + g * group, radices, strides, count - 2);
+        }
+        else if (in == out)
+        {
+            builtin_memcpy(scratch, in, sizeof(complex<T>) * size);
+            fn(out, scratch, temp);
         }
         else
         {
-            stages[inverse][depth]->execute(out, in, temp);
-            depth++;
+            fn(out, in, temp);
         }
-        in = out;
     }
-}
 
-template <typename T>
-template <bool direct, bool inverse>
-dft_plan<T>::dft_plan(size_t size, cbools_t<direct, inverse> type) : size(size), temp_size(0), data_size(0)
-{
-    if (is_poweroftwo(size))
+    template <typename Fn>
+    KFR_INTRIN void execute_final(T* out_re, T* out_im, const complex<T>* in, u8* temp, Fn&& fn)
     {
-        const size_t log2n = ilog2(size);
-        cswitch(
-            csizes_t<1, 2, 3, 4, 5, 6, 7, 8>(), log2n,
-            [&](auto log2n) {
-                (void)log2n;
-                this->add_stage<
-                    internal::fft_specialization_t<T, val_of(decltype(log2n)()), false>::template type>(size,
-                                                                                                        type);
-            },
-            [&]() {
-                cswitch(cfalse_true, is_even(log2n), [&](auto is_even) {
-                    this->make_fft(size, type, is_even, ctrue);
-                    this->add_stage<
-                        internal::fft_reorder_stage_impl_t<T, val_of(decltype(is_even)())>::template type>(
-                        size, type);
-                });
+        constexpr size_t width = fft_vector_width<T>;
+        const size_t size      = this->stage_size;
+        complex<T>* scratch    = ptr_cast<complex<T>>(temp);
+        temp += align_up(sizeof(complex<T>) * size, platform<>::native_cache_alignment);
+        fn(scratch, in, temp);
+        if (count > 2)
+        {
+            const size_t group = this->blocks;
+            CMT_LOOP_NOUNROLL
+            for (size_t g = 0; g < this->radix; g++)
+                dft_digitreverse(out_re, out_im, scratch + g * group, radices, strides, count - 2);
+        }
+        else
+        {
+            block_process(size, csizes_t<width, 1>(), [=](size_t i, auto w) {
+                constexpr size_t width = val_of(decltype(w)());
+                vec<T, width> re, im;
+                split(cread_split<width, false, true>(scratch + i), re, im);
+                write(out_re + i, re);
+                write(out_im + i, im);
             });
-        initialize(type);
+        }
     }
-}
+};
 
-template <typename T>
-template <bool direct, bool inverse>
-dft_plan_real<T>::dft_plan_real(size_t size, cbools_t<direct, inverse> type)
-    : dft_plan<T>(size / 2, type), size(size), rtwiddle(size / 4)
+template <typename T, size_t fixed_radix, bool inverse>
+struct dft_stage_fixed_impl : dft_stage<T>
 {
-    using namespace internal;
+    dft_stage_fixed_impl(size_t iterations, size_t blocks)
+    {
+        this->radix       = fixed_radix;
+        this->repeats     = iterations;
+        this->blocks      = blocks;
+        this->stage_size  = fixed_radix * iterations;
+        this->split_input = blocks == 1;
+        this->data_size   = align_up(sizeof(complex<T>) * iterations * (fixed_radix - 1),
+                                   platform<>::native_cache_alignment);
+    }
 
-    constexpr size_t width = platform<T>::vector_width * 2;
+protected:
+    constexpr static size_t width = dft_radix_width<fixed_radix, T>;
 
-    block_process(size / 4, csizes_t<width, 1>(), [=](size_t i, auto w) {
-        constexpr size_t width = val_of(decltype(w)());
-        cwrite<width>(rtwiddle.data() + i,
-                      cossin(dup(-constants<T>::pi * ((enumerate<T, width>() + i + size / 4) / (size / 2)))));
-    });
-}
+    virtual void do_initialize(u8* data, size_t) override final
+    {
+        complex<T>* twiddle = ptr_cast<complex<T>>(data);
+        size_t i            = 0;
+        initialize_radix_twiddles(csize_t<width>(), twiddle, fixed_radix, this->repeats, i);
+    }
 
-template <typename T>
-void dft_plan_real<T>::to_fmt(complex<T>* out, dft_pack_format fmt) const
-{
-    using namespace internal;
-    size_t csize = this->size / 2; // const size_t causes internal compiler error: in tsubst_copy in GCC 5.2
+    virtual void do_execute(complex<T>* out, const complex<T>* in, u8* /*temp*/) override final
+    {
+        const complex<T>* twiddle = ptr_cast<complex<T>>(this->data);
+        const size_t iterations   = this->repeats;
+        CMT_LOOP_NOUNROLL
+        for (size_t b = 0; b < this->blocks; b++)
+        {
+            butterflies(iterations, csize_t<width>(), csize_t<fixed_radix>(), cbool_t<inverse>(), out, in,
+                        twiddle, iterations);
+            in += this->stage_size;
+            out += this->stage_size;
+        }
+    }
 
-    constexpr size_t width = platform<T>::vector_width * 2;
-    const cvec<T, 1> dc    = cread<1>(out);
-    const size_t count     = csize / 2;
+    // Only the first stage, which has one block, reads split-format input
+    virtual void do_execute_split_input(complex<T>* out, const T* in_re, const T* in_im,
+                                        u8* /*temp*/) override final
+    {
+        const complex<T>* twiddle = ptr_cast<complex<T>>(this->data);
+        const size_t iterations   = this->repeats;
+        butterflies(iterations, csize_t<width>(), csize_t<fixed_radix>(), cbool_t<inverse>(), out, in_re,
+                    in_im, twiddle, iterations);
+    }
+};
 
-    block_process(count, csizes_t<width, 1>(), [=](size_t i, auto w) {
-        constexpr size_t width    = val_of(decltype(w)());
-        constexpr size_t widthm1  = width - 1;
-        const cvec<T, width> tw   = cread<width>(rtwiddle.data() + i);
-        const cvec<T, width> fpk  = cread<width>(out + i);
-        const cvec<T, width> fpnk = reverse<2>(negodd(cread<width>(out + csize - i - widthm1)));
+template <typename T, size_t fixed_radix, bool inverse>
+struct dft_stage_fixed_final_impl : dft_final_stage_base<T>
+{
+    dft_stage_fixed_final_impl(size_t blocks, const size_t* radices, size_t count)
+        : dft_final_stage_base<T>(fixed_radix, blocks, radices, count)
+    {
+    }
 
-        const cvec<T, width> f1k = fpk + fpnk;
-        const cvec<T, width> f2k = fpk - fpnk;
-        const cvec<T, width> t   = cmul(f2k, tw);
-        cwrite<width>(out + i, T(0.5) * (f1k + t));
-        cwrite<width>(out + csize - i - widthm1, reverse<2>(negodd(T(0.5) * (f1k - t))));
-    });
+protected:
+    constexpr static size_t width = dft_radix_width<fixed_radix, T>;
 
+    virtual void do_execute(complex<T>* out, const complex<T>* in, u8* temp) override final
     {
-        size_t k              = csize / 2;
-        const cvec<T, 1> fpk  = cread<1>(out + k);
-        const cvec<T, 1> fpnk = negodd(fpk);
-        cwrite<1>(out + k, fpnk);
+        this->execute_final(out, in, temp, kernel());
     }
-    if (fmt == dft_pack_format::CCs)
+
+    virtual void do_execute_split_output(T* out_re, T* out_im, const complex<T>* in, u8* temp) override final
     {
-        cwrite<1>(out, pack(dc[0] + dc[1], 0));
-        cwrite<1>(out + csize, pack(dc[0] - dc[1], 0));
+        this->execute_final(out_re, out_im, in, temp, kernel());
     }
-    else
+
+    auto kernel() const
     {
-        cwrite<1>(out, pack(dc[0] + dc[1], dc[0] - dc[1]));
+        const size_t blocks = this->blocks;
+        return [blocks](complex<T>* out, const complex<T>* in, u8*) {
+            butterflies(blocks, csize_t<width>(), csize_t<fixed_radix>(), cbool_t<inverse>(), out, in,
+                        blocks);
+        };
     }
-}
+};
 
-template <typename T>
+template <typename T, bool inverse>
+struct dft_stage_generic_impl : dft_stage<T>
+{
+    dft_stage_generic_impl(size_t radix, size_t iterations, size_t blocks)
+    {
+        this->radix       = radix;
+        this->repeats     = iterations;
+        this->blocks      = blocks;
+        this->stage_size  = radix * iterations;
+        this->split_input = blocks == 1;
+        this->temp_size   = align_up(sizeof(complex<T>) * radix, platform<>::native_cache_alignment);
+        this->data_size  = align_up(sizeof(complex<T>) * (radix / 2) * (radix / 2),
+                                   platform<>::native_cache_alignment) +
+                          align_up(sizeof(complex<T>) * iterations * (radix - 1),
+                                   platform<>::native_cache_alignment);
+    }
+
+protected:
+    virtual void do_initialize(u8* data, size_t) override final
+    {
+        complex<T>* twiddle = ptr_cast<complex<T>>(data);
+        initialize_generic_twiddles(twiddle, this->radix);
+        twiddle = ptr_cast<complex<T>>(data + generic_twiddle_size());
+        for (size_t i = 0; i < this->repeats; i++)
+            for (size_t r = 1; r < this->radix; r++)
+                cwrite<1>(twiddle++, calculate_twiddle<T>(r * i, this->stage_size));
+    }
+
+    virtual void do_execute(complex<T>* out, const complex<T>* in, u8* temp) override final
+    {
+        execute_blocks(out, temp, [in](size_t index) { return in[index]; });
+    }
+
+    // Only the first stage, which has one block, reads split-format input
+    virtual void do_execute_split_input(complex<T>* out, const T* in_re, const T* in_im,
+                                        u8* temp) override final
+    {
+        execute_blocks(out, temp,
+                       [in_re, in_im](size_t index) { return complex<T>(in_re[index], in_im[index]); });
+    }
+
+    // input(index) returns the input of the stage at index
+    template <typename Input>
+    KFR_INTRIN void execute_blocks(complex<T>* out, u8* temp, Input&& input)
+    {
+        const complex<T>* gtwiddle = ptr_cast<complex<T>>(this->data);
+        const size_t radix         = this->radix;
+        const size_t iterations    = this->repeats;
+        complex<T>* scratch        = ptr_cast<complex<T>>(temp);
+        size_t in                  = 0;
+        CMT_LOOP_NOUNROLL
+        for (size_t b = 0; b < this->blocks; b++)
+        {
+            const complex<T>* twiddle = ptr_cast<complex<T>>(this->data + generic_twiddle_size());
+            CMT_LOOP_NOUNROLL
+            for (size_t i = 0; i < iterations; i++)
+            {
+                for (size_t r = 0; r < radix; r++)
+                    scratch[r] = input(in + i + r * iterations);
+                generic_butterfly(radix, cbool_t<inverse>(), out + i, scratch, scratch, gtwiddle, iterations);
+                for (size_t r = 1; r < radix; r++)
+                {
+                    const cvec<T, 1> tw = cread<1>(twiddle++);
+                    const cvec<T, 1> x  = cread<1>(out + i + r * iterations);
+                    cwrite<1>(out + i + r * iterations, inverse ? cmul_conj(x, tw) : cmul(x, tw));
+                }
+            }
+            in += this->stage_size;
+            out += this->stage_size;
+        }
+    }
+
+    size_t generic_twiddle_size() const
+    {
+        return align_up(sizeof(complex<T>) * (this->radix / 2) * (this->radix / 2),
+                        platform<>::native_cache_alignment);
+    }
+};
+
+template <typename T, bool inverse>
+struct dft_stage_generic_final_impl : dft_final_stage_base<T>
+{
+    dft_stage_generic_final_impl(size_t radix, size_t blocks, const size_t* radices, size_t count)
+        : dft_final_stage_base<T>(radix, blocks, radices, count)
+    {
+        this->temp_size += align_up(sizeof(complex<T>) * radix, platform<>::native_cache_alignment);
+        this->data_size =
+            align_up(sizeof(complex<T>) * (radix / 2) * (radix / 2), platform<>::native_cache_alignment);
+    }
+
+protected:
+    virtual void do_initialize(u8* data, size_t) override final
+    {
+        initialize_generic_twiddles(ptr_cast<complex<T>>(data), this->radix);
+    }
+
+    virtual void do_execute(complex<T>* out, const complex<T>* in, u8* temp) override final
+    {
+        this->execute_final(out, in, temp, kernel());
+    }
+
+    virtual void do_execute_split_output(T* out_re, T* out_im, const complex<T>* in, u8* temp) override final
+    {
+        this->execute_final(out_re, out_im, in, temp, kernel());
+    }
+
+    auto kernel() const
+    {
+        const complex<T>* twiddle = ptr_cast<complex<T>>(this->data);
+        const size_t radix        = this->radix;
+        const size_t blocks       = this->blocks;
+        return [=](complex<T>* out, const complex<T>* in, u8* temp) {
+            CMT_LOOP_NOUNROLL
+            for (size_t b = 0; b < blocks; b++)
+                generic_butterfly(radix, cbool_t<inverse>(), out + b, in + b * radix,
+                                  ptr_cast<complex<T>>(temp), twiddle, blocks);
+        };
+    }
+};
+
+// Bluestein (chirp-z) algorithm: a DFT of arbitrary size is computed as a circular convolution
+// of length M >= 2N - 1 (a power of two) using an internal FFT plan
+template <typename T, bool inverse>
+struct dft_stage_bluestein_impl : dft_stage<T>
+{
+    dft_stage_bluestein_impl(size_t size, const std::shared_ptr<const dft_plan<T>>& plan) : plan(plan)
+    {
+        this->stage_size = size;
+        this->radix      = size;
+        this->temp_size  = chirp_size(plan->size) + plan->temp_size;
+        this->data_size  = chirp_size(size) + chirp_size(plan->size);
+    }
+
+    virtual std::vector<const dft_plan<T>*> nested_plans() const override final { return { plan.get() }; }
+
+protected:
+    std::shared_ptr<const dft_plan<T>> plan;
+
+    static size_t chirp_size(size_t size)
+    {
+        return align_up(sizeof(complex<T>) * size, platform<>::native_cache_alignment);
+    }
+
+    virtual void do_initialize(u8* data, size_t) override final
+    {
+        const size_t size   = this->stage_size;
+        const size_t fsize  = plan->size;
+        complex<T>* chirp   = ptr_cast<complex<T>>(data);
+        complex<T>* fkernel = ptr_cast<complex<T>>(data + chirp_size(size));
+        // chirp[n] = exp(-i*pi*n^2/N), n^2 is reduced modulo 2N to keep the angle exact
+        for (size_t n = 0; n < size; n++)
+            cwrite<1>(chirp + n, calculate_twiddle<T>(n * n % (2 * size), 2 * size));
+
+        // the kernel is symmetric, so the inverse transform can use its conjugate
+        std::fill(fkernel, fkernel + fsize, complex<T>(0));
+        const T scale = T(1) / T(fsize);
+        for (size_t n = 0; n < size; n++)
+        {
+            const complex<T> k = complex<T>(chirp[n].real(), -chirp[n].imag()) * scale;
+            fkernel[n]         = k;
+            fkernel[(fsize - n) % fsize] = k;
+        }
+        univector<u8> temp(plan->temp_size);
+        plan->execute(fkernel, fkernel, temp.data(), cfalse);
+    }
+
+    KFR_INTRIN static void multiply(complex<T>* out, const complex<T>* x, const complex<T>* y, size_t size)
+    {
+        constexpr size_t width = fft_vector_width<T>;
+        block_process(size, csizes_t<width, 1>(), [=](size_t i, auto w) {
+            constexpr size_t width = val_of(decltype(w)());
+            const cvec<T, width> a = cread<width>(x + i);
+            const cvec<T, width> b = cread<width>(y + i);
+            cwrite<width>(out + i, inverse ? cmul_conj(a, b) : cmul(a, b));
+        });
+    }
+
+    virtual void do_execute(complex<T>* out, const complex<T>* in, u8* temp) override final
+    {
+        const size_t size         = this->stage_size;
+        const size_t fsize        = plan->size;
+        const complex<T>* chirp   = ptr_cast<complex<T>>(this->data);
+        const complex<T>* fkernel = ptr_cast<complex<T>>(this->data + chirp_size(size));
+        complex<T>* work          = ptr_cast<complex<T>>(temp);
+        temp += chirp_size(fsize);
+
+        multiply(work, in, chirp, size);
+        builtin_memset(work + size, 0, sizeof(complex<T>) * (fsize - size));
+        plan->execute(work, work, temp, cfalse);
+        multiply(work, work, fkernel, fsize);
+        plan->execute(work, work, temp, ctrue);
+        multiply(out, work, chirp, size);
+    }
+};
+
+#ifndef KFR_SINGLE_THREAD
+// Worker threads shared by all plans, started on first use and kept until exit.
+// The calling thread runs the first part of a call itself and then runs queued parts (of any call)
+// until its own parts are done, so a call made from inside a part cannot deadlock
+class dft_thread_pool
+{
+public:
+    static dft_thread_pool& instance()
+    {
+        static dft_thread_pool pool;
+        return pool;
+    }
+
+    ~dft_thread_pool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        work_ready.notify_all();
+        for (std::thread& worker : workers)
+            worker.join();
+    }
+
+    template <typename Fn>
+    void run(size_t threads, size_t count, Fn& fn)
+    {
+        size_t pending = threads - 1;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            while (workers.size() < threads - 1)
+                workers.emplace_back([this]() { worker_loop(); });
+            for (size_t t = 1; t < threads; t++)
+                queue.push_back(
+                    part{ &invoke<Fn>, &fn, t, count * t / threads, count * (t + 1) / threads, &pending });
+        }
+        work_ready.notify_all();
+        fn(size_t(0), size_t(0), count / threads);
+        std::unique_lock<std::mutex> lock(mutex);
+        while (pending)
+        {
+            if (queue.empty())
+                part_done.wait(lock);
+            else
+                run_front(lock);
+        }
+    }
+
+private:
+    struct part
+    {
+        void (*call)(void*, size_t, size_t, size_t);
+        void* fn;
+        size_t thread;
+        size_t begin;
+        size_t end;
+        size_t* pending;
+    };
+
+    template <typename Fn>
+    static void invoke(void* fn, size_t thread, size_t begin, size_t end)
+    {
+        (*static_cast<Fn*>(fn))(thread, begin, end);
+    }
+
+    // Runs the first queued part with the mutex released
+    void run_front(std::unique_lock<std::mutex>& lock)
+    {
+        const part p = queue.front();
+        queue.pop_front();
+        lock.unlock();
+        p.call(p.fn, p.thread, p.begin, p.end);
+        lock.lock();
+        --*p.pending;
+        part_done.notify_all();
+    }
+
+    void worker_loop()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;)
+        {
+            work_ready.wait(lock, [this]() { return stopping || !queue.empty(); });
+            if (queue.empty())
+                return;
+            run_front(lock);
+        }
+    }
+
+    std::mutex mutex;
+    std::condition_variable work_ready;
+    std::condition_variable part_done;
+    std::deque<part> queue;
+    std::vector<std::thread> workers;
+    bool stopping = false;
+};
+#endif
+
+// Runs fn(thread, begin, end) for count items split between the given number of threads
+template <typename Fn>
+void dft_parallel(size_t threads, size_t count, Fn&& fn)
+{
+#ifndef KFR_SINGLE_THREAD
+    if (threads > 1)
+    {
+        dft_thread_pool::instance().run(threads, count, fn);
+        return;
+    }
+#endif
+    fn(size_t(0), size_t(0), count);
+}
+
+// Four-step algorithm for transforms that do not fit in cache.
+// The input is viewed as a matrix of rows x columns, columns are transformed in small blocks
+// and multiplied by twiddles, then rows are transformed and the result is transposed.
+// Each step is split between the worker threads
+template <typename T, bool inverse>
+struct dft_stage_fourstep_impl : dft_stage<T>
+{
+    constexpr static size_t block = 8;
+
+    dft_stage_fourstep_impl(size_t size, const std::shared_ptr<const dft_plan<T>>& row_plan,
+                            const std::shared_ptr<const dft_plan<T>>& column_plan, size_t threads)
+        : row_plan(row_plan), column_plan(column_plan), threads(threads)
+    {
+        this->stage_size  = size;
+        this->radix       = row_plan->size;
+        this->repeats     = column_plan->size;
+        twiddle_low_bits  = ilog2(size) / 2;
+        twiddle_low_size  = size_t(1) << twiddle_low_bits;
+        twiddle_high_size = size / twiddle_low_size;
+        this->data_size   = align_up(sizeof(complex<T>) * (twiddle_low_size + twiddle_high_size),
+                                   platform<>::native_cache_alignment);
+        this->temp_size = align_up(sizeof(complex<T>) * size, platform<>::native_cache_alignment) +
+                          threads * thread_temp_size();
+    }
+
+    virtual std::vector<const dft_plan<T>*> nested_plans() const override final
+    {
+        return { row_plan.get(), column_plan.get() };
+    }
+
+protected:
+    std::shared_ptr<const dft_plan<T>> row_plan;
+    std::shared_ptr<const dft_plan<T>> column_plan;
+    size_t threads;
+    size_t twiddle_low_bits;
+    size_t twiddle_low_size;
+    size_t twiddle_high_size;
+
+    size_t thread_temp_size() const
+    {
+        return align_up(sizeof(complex<T>) * block * column_plan->size, platform<>::native_cache_alignment) +
+               align_up(std::max(row_plan->temp_size, column_plan->temp_size),
+                        platform<>::native_cache_alignment);
+    }
+
+    virtual void do_initialize(u8* data, size_t) override final
+    {
+        complex<T>* twiddle = ptr_cast<complex<T>>(data);
+        for (size_t i = 0; i < twiddle_low_size; i++)
+            cwrite<1>(twiddle++, calculate_twiddle<T>(i, this->stage_size));
+        for (size_t i = 0; i < twiddle_high_size; i++)
+            cwrite<1>(twiddle++, calculate_twiddle<T>(i * twiddle_low_size, this->stage_size));
+    }
+
+    // w^k for k < size is assembled from two small tables: w^(high * low_size) * w^low
+    KFR_INTRIN cvec<T, 1> twiddle(size_t k) const
+    {
+        const complex<T>* low  = ptr_cast<complex<T>>(this->data);
+        const complex<T>* high = low + twiddle_low_size;
+        const cvec<T, 1> tw =
+            cmul(cread<1>(high + (k >> twiddle_low_bits)), cread<1>(low + (k & (twiddle_low_size - 1))));
+        return inverse ? negodd(tw) : tw;
+    }
+
+    virtual void do_execute(complex<T>* out, const complex<T>* in, u8* temp) override final
+    {
+        const size_t size    = this->stage_size;
+        const size_t rows    = column_plan->size;
+        const size_t columns = row_plan->size;
+        complex<T>* matrix   = ptr_cast<complex<T>>(temp);
+        u8* thread_temp      = temp + align_up(sizeof(complex<T>) * size, platform<>::native_cache_alignment);
+
+        // Step 1: transform columns in blocks, multiply by w^(column * row)
+        dft_parallel(threads, columns / block, [&](size_t thread, size_t begin, size_t end) {
+            u8* ttemp         = thread_temp + thread * thread_temp_size();
+            complex<T>* local = ptr_cast<complex<T>>(ttemp);
+            ttemp += align_up(sizeof(complex<T>) * block * rows, platform<>::native_cache_alignment);
+            for (size_t b = begin; b < end; b++)
+            {
+                const size_t column = b * block;
+                for (size_t r = 0; r < rows; r++)
+                    for (size_t c = 0; c < block; c++)
+                        local[c * rows + r] = in[r * columns + column + c];
+                for (size_t c = 0; c < block; c++)
+                    column_plan->execute(local + c * rows, local + c * rows, ttemp, cbool_t<inverse>());
+                for (size_t r = 0; r < rows; r++)
+                    for (size_t c = 0; c < block; c++)
+                        cwrite<1>(out + r * columns + column + c,
+                                  cmul(cread<1>(local + c * rows + r), twiddle((column + c) * r)));
+            }
+        });
+
+        // Step 2: transform rows
+        dft_parallel(threads, rows, [&](size_t thread, size_t begin, size_t end) {
+            u8* ttemp = thread_temp + thread * thread_temp_size() +
+                        align_up(sizeof(complex<T>) * block * rows, platform<>::native_cache_alignment);
+            for (size_t r = begin; r < end; r++)
+                row_plan->execute(matrix + r * columns, out + r * columns, ttemp, cbool_t<inverse>());
+        });
+
+        // Step 3: transpose
+        dft_parallel(threads, columns / block, [&](size_t, size_t begin, size_t end) {
+            for (size_t b = begin; b < end; b++)
+                for (size_t r = 0; r < rows; r += block)
+                    for (size_t c = b * block; c < b * block + block; c++)
+                        for (size_t i = r; i < r + block; i++)
+                            out[c * rows + i] = matrix[i * columns + c];
+        });
+    }
+};
+
+template <typename T, size_t fixed_radix>
+struct dft_stage_fixed_impl_t
+{
+    template <bool inverse>
+    using type = internal::dft_stage_fixed_impl<T, fixed_radix, inverse>;
+};
+template <typename T, size_t fixed_radix>
+struct dft_stage_fixed_final_impl_t
+{
+    template <bool inverse>
+    using type = internal::dft_stage_fixed_final_impl<T, fixed_radix, inverse>;
+};
+template <typename T>
+struct dft_stage_generic_impl_t
+{
+    template <bool inverse>
+    using type = internal::dft_stage_generic_impl<T, inverse>;
+};
+template <typename T>
+struct dft_stage_generic_final_impl_t
+{
+    template <bool inverse>
+    using type = internal::dft_stage_generic_final_impl<T, inverse>;
+};
+template <typename T>
+struct dft_stage_bluestein_impl_t
+{
+    template <bool inverse>
+    using type = internal::dft_stage_bluestein_impl<T, inverse>;
+};
+template <typename T>
+struct dft_stage_fourstep_impl_t
+{
+    template <bool inverse>
+    using type = internal::dft_stage_fourstep_impl<T, inverse>;
+};
+
+// Sizes with a prime factor greater than this are computed using the Bluestein algorithm
+constexpr size_t dft_bluestein_threshold = 100;
+
+// Power-of-two sizes starting from this are computed using the multithreaded four-step algorithm
+constexpr size_t dft_fourstep_min_size = size_t(1) << 22;
+
+inline size_t dft_factorize(size_t size, size_t* radices)
+{
+    size_t count = 0;
+    size_t log2n = 0;
+    while (size % 2 == 0)
+    {
+        size /= 2;
+        log2n++;
+    }
+    // radix-2 passes are the least efficient, prefer 4 * 4 over 8 * 2
+    if (log2n % 3 == 1 && log2n >= 4)
+    {
+        radices[count++] = 4;
+        radices[count++] = 4;
+        log2n -= 4;
+    }
+    for (; log2n >= 3; log2n -= 3)
+        radices[count++] = 8;
+    if (log2n > 0)
+        radices[count++] = size_t(1) << log2n;
+    for (size_t radix = 3; radix * radix <= size; radix += 2)
+    {
+        while (size % radix == 0)
+        {
+            radices[count++] = radix;
+            size /= radix;
+        }
+    }
+    if (size > 1)
+        radices[count++] = size;
+    return count;
+}
+
+// Batched transforms of small power-of-two sizes are computed one transform per SIMD lane.
+// Each point is stored in split format (width real parts followed by width imaginary parts)
+// and the transform is done by a radix-4 Stockham autosort algorithm, so no reordering is needed
+constexpr size_t dft_lanes_min_size = 16;
+constexpr size_t dft_lanes_max_size = 1024;
+
+template <typename T>
+constexpr size_t dft_lanes_width = fft_vector_width<T>;
+
+inline bool dft_lanes_supported(size_t size)
+{
+    return is_poweroftwo(size) && size >= dft_lanes_min_size && size <= dft_lanes_max_size;
+}
+
+template <typename T>
+void initialize_lanes_twiddles(complex<T>* twiddle, size_t size)
+{
+    size_t n = size;
+    if (ilog2(size) % 2 == 1)
+    {
+        for (size_t p = 0; p < n / 2; p++)
+            cwrite<1>(twiddle++, calculate_twiddle<T>(p, n));
+        n /= 2;
+    }
+    for (; n >= 4; n /= 4)
+        for (size_t p = 0; p < n / 4; p++)
+            for (size_t k = 1; k < 4; k++)
+                cwrite<1>(twiddle++, calculate_twiddle<T>(p * k, n));
+}
+
+template <bool inverse, typename T, size_t N>
+KFR_INTRIN vec<T, N> lanes_twiddle(const vec<T, N>& x, const complex<T>& tw)
+{
+    vec<T, N / 2> re, im;
+    split(x, re, im);
+    const T twre = tw.real();
+    const T twim = inverse ? -tw.imag() : tw.imag();
+    return concat(re * twre - im * twim, re * twim + im * twre);
+}
+
+// Returns either x or y depending on which buffer contains the result
+template <bool inverse, typename T>
+T* execute_lanes(size_t size, const complex<T>* twiddle, T* x, T* y)
+{
+    constexpr size_t width = dft_lanes_width<T>;
+    size_t n               = size;
+    size_t s               = 1;
+    if (ilog2(size) % 2 == 1)
+    {
+        const size_t m = n / 2;
+        CMT_LOOP_NOUNROLL
+        for (size_t p = 0; p < m; p++)
+        {
+            const complex<T> tw = *twiddle++;
+            for (size_t q = 0; q < s; q++)
+            {
+                const cvec<T, width> a0 = read<width * 2>(x + (q + s * p) * width * 2);
+                const cvec<T, width> a1 = read<width * 2>(x + (q + s * (p + m)) * width * 2);
+                write(y + (q + s * 2 * p) * width * 2, a0 + a1);
+                write(y + (q + s * (2 * p + 1)) * width * 2, lanes_twiddle<inverse>(a0 - a1, tw));
+            }
+        }
+        n = m;
+        s *= 2;
+        std::swap(x, y);
+    }
+    for (; n >= 4; n /= 4, s *= 4, std::swap(x, y))
+    {
+        const size_t m = n / 4;
+        CMT_LOOP_NOUNROLL
+        for (size_t p = 0; p < m; p++)
+        {
+            const complex<T> tw1 = twiddle[0];
+            const complex<T> tw2 = twiddle[1];
+            const complex<T> tw3 = twiddle[2];
+            twiddle += 3;
+            for (size_t q = 0; q < s; q++)
+            {
+                cvec<T, width> w0, w1, w2, w3;
+                butterfly4<width, inverse>(ctrue, read<width * 2>(x + (q + s * p) * width * 2),
+                                           read<width * 2>(x + (q + s * (p + m)) * width * 2),
+                                           read<width * 2>(x + (q + s * (p + 2 * m)) * width * 2),
+                                           read<width * 2>(x + (q + s * (p + 3 * m)) * width * 2), w0, w1,
+                                           w2, w3);
+                T* out = y + (q + s * 4 * p) * width * 2;
+                write(out, w0);
+                if (m == 1)
+                {
+                    write(out + s * width * 2, w1);
+                    write(out + s * width * 4, w2);
+                    write(out + s * width * 6, w3);
+                }
+                else
+                {
+                    write(out + s * width * 2, lanes_twiddle<inverse>(w1, tw1));
+                    write(out + s * width * 4, lanes_twiddle<inverse>(w2, tw2));
+                    write(out + s * width * 6, lanes_twiddle<inverse>(w3, tw3));
+                }
+            }
+        }
+    }
+    return x;
+}
+} // namespace internal
+
+//
+
+template <typename T>
+template <template <bool inverse> class Stage, typename... Args>
+void dft_plan<T>::add_stage(cbools_t<true, true>, const Args&... args)
+{
+    dft_stage<T>* direct_stage  = new Stage<false>(args...);
+    direct_stage->name          = nullptr;
+    dft_stage<T>* inverse_stage = new Stage<true>(args...);
+    inverse_stage->name         = nullptr;
+    this->data_size += direct_stage->data_size;
+    this->temp_size = std::max(this->temp_size, direct_stage->temp_size);
+    stages[0].push_back(dft_stage_ptr(direct_stage));
+    stages[1].push_back(dft_stage_ptr(inverse_stage));
+}
+
+template <typename T>
+template <template <bool inverse> class Stage, typename... Args>
+void dft_plan<T>::add_stage(cbools_t<true, false>, const Args&... args)
+{
+    dft_stage<T>* direct_stage = new Stage<false>(args...);
+    direct_stage->name         = nullptr;
+    this->data_size += direct_stage->data_size;
+    this->temp_size = std::max(this->temp_size, direct_stage->temp_size);
+    stages[0].push_back(dft_stage_ptr(direct_stage));
+}
+
+template <typename T>
+template <template <bool inverse> class Stage, typename... Args>
+void dft_plan<T>::add_stage(cbools_t<false, true>, const Args&... args)
+{
+    dft_stage<T>* inverse_stage = new Stage<true>(args...);
+    inverse_stage->name         = nullptr;
+    this->data_size += inverse_stage->data_size;
+    this->temp_size = std::max(this->temp_size, inverse_stage->temp_size);
+    stages[1].push_back(dft_stage_ptr(inverse_stage));
+}
+
+template <typename T>
+template <bool direct, bool inverse, bool is_even, bool first>
+void dft_plan<T>::make_fft(size_t stage_size, cbools_t<direct, inverse> type, cbool_t<is_even>,
+                           cbool_t<first>)
+{
+    constexpr size_t final_size = is_even ? 1024 : 512;
+
+    using fft_stage_impl_t       = internal::fft_stage_impl_t<T, !first, is_even>;
+    using fft_final_stage_impl_t = internal::fft_final_stage_impl_t<T, !first, final_size>;
+
+    if (stage_size >= 2048)
+    {
+        add_stage<fft_stage_impl_t::template type>(type, stage_size);
+
+        make_fft(stage_size / 4, cbools_t<direct, inverse>(), cbool_t<is_even>(), cfalse);
+    }
+    else
+    {
+        add_stage<fft_final_stage_impl_t::template type>(type, final_size);
+    }
+}
+
+template <typename T>
+template <bool direct, bool inverse>
+void dft_plan<T>::make_dft(size_t size, cbools_t<direct, inverse> type, dft_data_reader* reader)
+{
+    size_t radices[64];
+    const size_t count = internal::dft_factorize(size, radices);
+
+    if (radices[count - 1] > internal::dft_bluestein_threshold)
+    {
+        const std::shared_ptr<const dft_plan<T>> plan =
+            std::make_shared<const dft_plan<T>>(next_poweroftwo(2 * size - 1), dft_type::both, 1, reader);
+        this->add_stage<internal::dft_stage_bluestein_impl_t<T>::template type>(type, size, plan);
+        return;
+    }
+
+    size_t iterations = size;
+    size_t blocks     = 1;
+    for (size_t r = 0; r < count; r++)
+    {
+        const size_t radix = radices[r];
+        iterations /= radix;
+        if (r == count - 1)
+        {
+            cswitch(internal::dft_radices, radix,
+                    [&](auto radix_) {
+                        this->add_stage<internal::dft_stage_fixed_final_impl_t<
+                            T, val_of(decltype(radix_)())>::template type>(type, blocks, &radices[0],
+                                                                           count);
+                    },
+                    [&]() {
+                        this->add_stage<internal::dft_stage_generic_final_impl_t<T>::template type>(
+                            type, radix, blocks, &radices[0], count);
+                    });
+        }
+        else
+        {
+            cswitch(internal::dft_radices, radix,
+                    [&](auto radix_) {
+                        this->add_stage<internal::dft_stage_fixed_impl_t<
+                            T, val_of(decltype(radix_)())>::template type>(type, iterations, blocks);
+                    },
+                    [&]() {
+                        this->add_stage<internal::dft_stage_generic_impl_t<T>::template type>(
+                            type, radix, iterations, blocks);
+                    });
+        }
+        blocks *= radix;
+    }
+}
+
+namespace internal
+{
+// Saved before the data of each plan, so that data saved by a build with a different choice of stages
+// is rejected instead of being used as twiddles of the wrong stages
+struct dft_layout_block
+{
+    u64 hash;
+    u64 data_size;
+};
+
+template <typename T>
+dft_layout_block dft_layout(const std::vector<std::unique_ptr<dft_stage<T>>>& stages, size_t data_size)
+{
+    // FNV-1a over the parameters of the stages
+    u64 hash = 0xCBF29CE484222325ull;
+    for (const std::unique_ptr<dft_stage<T>>& stage : stages)
+    {
+        for (const size_t value : { stage->radix, stage->stage_size, stage->repeats, stage->blocks,
+                                    stage->data_size })
+            hash = (hash ^ value) * 0x100000001B3ull;
+    }
+    return { hash, data_size };
+}
+
+inline bool dft_read_layout(dft_data_reader& reader, const dft_layout_block& expected)
+{
+    const u8* block = reader.read(sizeof(dft_layout_block));
+    if (!block)
+        return false;
+    dft_layout_block saved;
+    builtin_memcpy(&saved, block, sizeof(saved));
+    if (saved.hash != expected.hash || saved.data_size != expected.data_size)
+        reader.failed = true;
+    return !reader.failed;
+}
+} // namespace internal
+
+template <typename T>
+template <bool direct, bool inverse>
+void dft_plan<T>::initialize(cbools_t<direct, inverse>, dft_data_reader* reader)
+{
+    const internal::dft_layout_block layout = internal::dft_layout(stages[direct ? 0 : 1], data_size);
+    const u8* loaded =
+        reader && internal::dft_read_layout(*reader, layout) ? reader->read(data_size) : nullptr;
+    if (loaded && reader->owner)
+    {
+        data_ptr   = loaded;
+        data_owner = reader->owner;
+    }
+    else
+    {
+        data     = autofree<u8>(data_size);
+        data_ptr = data.data();
+        if (loaded)
+            internal::builtin_memcpy(data.data(), loaded, data_size);
+    }
+    if (direct)
+    {
+        size_t offset = 0;
+        for (dft_stage_ptr& stage : stages[0])
+        {
+            stage->data = data_ptr + offset;
+            if (!loaded)
+                stage->initialize(data.data() + offset, this->size);
+            offset += stage->data_size;
+        }
+    }
+    if (inverse)
+    {
+        size_t offset = 0;
+        for (dft_stage_ptr& stage : stages[1])
+        {
+            stage->data = data_ptr + offset;
+            if (!direct && !loaded)
+                stage->initialize(data.data() + offset, this->size);
+            offset += stage->data_size;
+        }
+    }
+}
+
+template <typename T>
+void dft_plan<T>::save_data(std::vector<u8>& blob) const
+{
+    for (const dft_stage_ptr& stage : stages[stages[0].empty() ? 1 : 0])
+        for (const dft_plan<T>* plan : stage->nested_plans())
+            plan->save_data(blob);
+    const internal::dft_layout_block layout =
+        internal::dft_layout(stages[stages[0].empty() ? 1 : 0], data_size);
+    const size_t offset = blob.size();
+    blob.resize(offset + align_up(sizeof(layout), dft_data_alignment));
+    internal::builtin_memcpy(blob.data() + offset, &layout, sizeof(layout));
+    blob.insert(blob.end(), data_ptr, data_ptr + data_size);
+    blob.resize(align_up(blob.size(), dft_data_alignment));
+}
+
+template <typename T>
+size_t dft_plan<T>::data_memory() const
+{
+    size_t result = data_size + batch_twiddle.size() * sizeof(complex<T>);
+    for (const dft_stage_ptr& stage : stages[stages[0].empty() ? 1 : 0])
+        for (const dft_plan<T>* plan : stage->nested_plans())
+            result += plan->data_memory();
+    return result;
+}
+
+template <typename T>
+template <bool inverse>
+void dft_plan<T>::execute_dft(cbool_t<inverse>, complex<T>* out, const complex<T>* in, u8* temp) const
+{
+    execute_stages(cbool_t<inverse>(), out, in, nullptr, nullptr, nullptr, nullptr, temp);
+}
+
+template <typename T>
+template <bool inverse>
+void dft_plan<T>::execute_stages(cbool_t<inverse>, complex<T>* out, const complex<T>* in, const T* in_re,
+                                 const T* in_im, T* out_re, T* out_im, u8* temp) const
+{
+    size_t stack[32] = { 0 };
+
+    const size_t count = stages[inverse].size();
+
+    for (size_t depth = 0; depth < count;)
+    {
+        if (stages[inverse][depth]->recursion)
+        {
+            complex<T>* rout      = out;
+            const complex<T>* rin = in;
+            size_t rdepth         = depth;
+            size_t maxdepth       = depth;
+            do
+            {
+                if (stack[rdepth] == stages[inverse][rdepth]->repeats)
+                {
+                    stack[rdepth] = 0;
+                    rdepth--;
+                }
+                else
+                {
+                    if (in_re)
+                        stages[inverse][rdepth]->execute_split_input(rout, in_re, in_im, temp);
+                    else
+                        stages[inverse][rdepth]->execute(rout, rin, temp);
+                    in_re = nullptr;
+                    rout += stages[inverse][rdepth]->out_offset;
+                    rin = rout;
+                    stack[rdepth]++;
+                    if (rdepth < count - 1 && stages[inverse][rdepth + 1]->recursion)
+                        rdepth++;
+                    else
+                        maxdepth = rdepth;
+                }
+            } while (rdepth != depth);
+            depth = maxdepth + 1;
+        }
+        else
+        {
+            if (out_re && depth == count - 1)
+                stages[inverse][depth]->execute_split_output(out_re, out_im, in, temp);
+            else if (in_re)
+                stages[inverse][depth]->execute_split_input(out, in_re, in_im, temp);
+            else
+                stages[inverse][depth]->execute(out, in, temp);
+            in_re = nullptr;
+            depth++;
+        }
+        in = out;
+    }
+}
+
+template <typename T>
+void dft_plan<T>::execute(T* out_re, T* out_im, const T* in_re, const T* in_im, u8* temp, bool inverse) const
+{
+    using namespace internal;
+    constexpr size_t width = fft_vector_width<T>;
+
+    // The stages work in the buffer. The input is interleaved into it first and the output is
+    // de-interleaved from it last only if the first or the last stage cannot do it
+    complex<T>* buffer = ptr_cast<complex<T>>(temp + align_up(temp_size, platform<>::native_cache_alignment));
+    const bool split_output = stages[inverse].back()->split_output;
+    if (!stages[inverse].front()->split_input)
+    {
+        block_process(size, csizes_t<width, 1>(), [=](size_t i, auto w) {
+            constexpr size_t width = val_of(decltype(w)());
+            cwrite_split<width, false, true>(buffer + i,
+                                             concat(read<width>(in_re + i), read<width>(in_im + i)));
+        });
+        in_re = nullptr;
+        in_im = nullptr;
+    }
+    if (inverse)
+        execute_stages(ctrue, buffer, buffer, in_re, in_im, split_output ? out_re : nullptr, out_im, temp);
+    else
+        execute_stages(cfalse, buffer, buffer, in_re, in_im, split_output ? out_re : nullptr, out_im, temp);
+    if (!split_output)
+    {
+        block_process(size, csizes_t<width, 1>(), [=](size_t i, auto w) {
+            constexpr size_t width = val_of(decltype(w)());
+            vec<T, width> re, im;
+            split(cread_split<width, false, true>(buffer + i), re, im);
+            write(out_re + i, re);
+            write(out_im + i, im);
+        });
+    }
+}
+
+template <typename T>
+template <bool inverse, typename OutFn, typename InFn>
+void dft_plan<T>::execute_batch_dft(cbool_t<inverse>, size_t count, OutFn&& out, InFn&& in, u8* temp) const
+{
+    constexpr size_t width = internal::dft_lanes_width<T>;
+
+    size_t i = 0;
+    if (!batch_twiddle.empty())
+    {
+        T* x = ptr_cast<T>(temp);
+        T* y = x + size * width * 2;
+        for (; i + width <= count; i += width)
+        {
+            for (size_t l = 0; l < width; l++)
+            {
+                const complex<T>* src = in(i + l);
+                for (size_t k = 0; k < size; k++)
+                {
+                    x[k * width * 2 + l]         = src[k].real();
+                    x[k * width * 2 + width + l] = src[k].imag();
+                }
+            }
+            const T* result = internal::execute_lanes<inverse>(size, batch_twiddle.data(), x, y);
+            for (size_t l = 0; l < width; l++)
+            {
+                complex<T>* dest = out(i + l);
+                for (size_t k = 0; k < size; k++)
+                    dest[k] = complex<T>(result[k * width * 2 + l], result[k * width * 2 + width + l]);
+            }
+        }
+    }
+    for (; i < count; i++)
+        execute_dft(cbool_t<inverse>(), out(i), in(i), temp);
+}
+
+template <typename T>
+void dft_plan<T>::execute_batch(complex<T>* out, const complex<T>* in, u8* temp, size_t count,
+                                size_t ostride, size_t istride, bool inverse) const
+{
+    auto outfn = [=](size_t i) { return out + i * ostride; };
+    auto infn  = [=](size_t i) { return in + i * istride; };
+    if (inverse)
+        execute_batch_dft(ctrue, count, outfn, infn, temp);
+    else
+        execute_batch_dft(cfalse, count, outfn, infn, temp);
+}
+
+template <typename T>
+void dft_plan<T>::execute_batch(complex<T>* const* out, const complex<T>* const* in, u8* temp, size_t count,
+                                bool inverse) const
+{
+    auto outfn = [=](size_t i) { return out[i]; };
+    auto infn  = [=](size_t i) { return in[i]; };
+    if (inverse)
+        execute_batch_dft(ctrue, count, outfn, infn, temp);
+    else
+        execute_batch_dft(cfalse, count, outfn, infn, temp);
+}
+
+template <typename T>
+template <bool direct, bool inverse>
+dft_plan<T>::dft_plan(size_t size, cbools_t<direct, inverse> type, size_t threads, dft_data_reader* reader)
+    : size(size), temp_size(0), data_ptr(nullptr), data_size(0)
+{
+#ifdef KFR_SINGLE_THREAD
+    threads = 1;
+#else
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+#endif
+    if (threads > 1 && is_poweroftwo(size) && size >= internal::dft_fourstep_min_size)
+    {
+        const size_t columns = size_t(1) << (ilog2(size) - ilog2(size) / 2);
+        const std::shared_ptr<const dft_plan<T>> row_plan =
+            std::make_shared<const dft_plan<T>>(columns, dft_type::both, 1, reader);
+        const std::shared_ptr<const dft_plan<T>> column_plan =
+            std::make_shared<const dft_plan<T>>(size / columns, dft_type::both, 1, reader);
+        this->add_stage<internal::dft_stage_fourstep_impl_t<T>::template type>(type, size, row_plan,
+                                                                              column_plan, threads);
+    }
+    else if (is_poweroftwo(size))
+    {
+        const size_t log2n = ilog2(size);
+        cswitch(
+            csizes_t<1, 2, 3, 4, 5, 6, 7, 8>(), log2n,
+            [&](auto log2n) {
+                (void)log2n;
+                this->add_stage<
+                    internal::fft_specialization_t<T, val_of(decltype(log2n)()), false>::template type>(type,
+                                                                                                        size);
+            },
+            [&]() {
+                cswitch(cfalse_true, is_even(log2n), [&](auto is_even) {
+                    this->make_fft(size, type, is_even, ctrue);
+                    this->add_stage<
+                        internal::fft_reorder_stage_impl_t<T, val_of(decltype(is_even)())>::template type>(
+                        type, size);
+                });
+            });
+    }
+    else
+    {
+        make_dft(size, type, reader);
+    }
+    initialize(type, reader);
+
+    batch_temp_size = temp_size;
+    split_temp_size =
+        align_up(temp_size, platform<>::native_cache_alignment) + sizeof(complex<T>) * size;
+    if (internal::dft_lanes_supported(size))
+    {
+        batch_twiddle.resize(size);
+        internal::initialize_lanes_twiddles(batch_twiddle.data(), size);
+        batch_temp_size = std::max(temp_size, sizeof(complex<T>) * size * internal::dft_lanes_width<T> * 2);
+    }
+}
+
+template <typename T>
+template <bool direct, bool inverse>
+dft_plan_real<T>::dft_plan_real(size_t size, cbools_t<direct, inverse> type, size_t threads,
+                                 dft_data_reader* reader)
+    : dft_plan<T>(size / 2, type, threads, reader), size(size), rtwiddle(size / 4 + 1)
+{
+    using namespace internal;
+
+    const u8* loaded = reader ? reader->read(sizeof(complex<T>) * rtwiddle.size()) : nullptr;
+    if (loaded)
+    {
+        builtin_memcpy(rtwiddle.data(), loaded, sizeof(complex<T>) * rtwiddle.size());
+        return;
+    }
+
+    constexpr size_t width = platform<T>::vector_width * 2;
+
+    block_process(size / 4 + 1, csizes_t<width, 1>(), [=](size_t i, auto w) {
+        constexpr size_t width = val_of(decltype(w)());
+        cwrite<width>(rtwiddle.data() + i,
+                      cossin(dup(-constants<T>::pi *
+                                 ((enumerate<T, width>() + i + T(size) / 4) / T(size / 2)))));
+    });
+}
+
+template <typename T>
+void dft_plan_real<T>::execute_batch(complex<T>* out, const T* in, u8* temp, size_t count, size_t ostride,
+                                     size_t istride, dft_pack_format fmt) const
+{
+    this->execute_batch_dft(cfalse, count, [=](size_t i) { return out + i * ostride; },
+                            [=](size_t i) { return ptr_cast<complex<T>>(in + i * istride); }, temp);
+    for (size_t i = 0; i < count; i++)
+        to_fmt(out + i * ostride, fmt);
+}
+
+template <typename T>
+void dft_plan_real<T>::execute_batch(T* out, const complex<T>* in, u8* temp, size_t count, size_t ostride,
+                                     size_t istride, dft_pack_format fmt) const
+{
+    for (size_t i = 0; i < count; i++)
+        from_fmt(ptr_cast<complex<T>>(out + i * ostride), in + i * istride, fmt);
+    auto outfn = [=](size_t i) { return ptr_cast<complex<T>>(out + i * ostride); };
+    this->execute_batch_dft(ctrue, count, outfn, outfn, temp);
+}
+
+template <typename T>
+void dft_plan_real<T>::execute_batch(complex<T>* const* out, const T* const* in, u8* temp, size_t count,
+                                     dft_pack_format fmt) const
+{
+    this->execute_batch_dft(cfalse, count, [=](size_t i) { return out[i]; },
+                            [=](size_t i) { return ptr_cast<complex<T>>(in[i]); }, temp);
+    for (size_t i = 0; i < count; i++)
+        to_fmt(out[i], fmt);
+}
+
+template <typename T>
+void dft_plan_real<T>::execute_batch(T* const* out, const complex<T>* const* in, u8* temp, size_t count,
+                                     dft_pack_format fmt) const
+{
+    for (size_t i = 0; i < count; i++)
+        from_fmt(ptr_cast<complex<T>>(out[i]), in[i], fmt);
+    auto outfn = [=](size_t i) { return ptr_cast<complex<T>>(out[i]); };
+    this->execute_batch_dft(ctrue, count, outfn, outfn, temp);
+}
+
+template <typename T>
+void dft_plan_real<T>::save_data(std::vector<u8>& blob) const
+{
+    dft_plan<T>::save_data(blob);
+    const u8* twiddle = ptr_cast<u8>(rtwiddle.data());
+    blob.insert(blob.end(), twiddle, twiddle + sizeof(complex<T>) * rtwiddle.size());
+    blob.resize(align_up(blob.size(), dft_data_alignment));
+}
+
+template <typename T>
+size_t dft_plan_real<T>::data_memory() const
+{
+    return dft_plan<T>::data_memory() + sizeof(complex<T>) * rtwiddle.size();
+}
+
+template <typename T>
+void dft_plan_real<T>::to_fmt(complex<T>* out, dft_pack_format fmt) const
+{
+    using namespace internal;
+    size_t csize = this->size / 2; // const size_t causes internal compiler error: in tsubst_copy in GCC 5.2
+
+    constexpr size_t width = platform<T>::vector_width * 2;
+    const cvec<T, 1> dc    = cread<1>(out);
+    const size_t count     = (csize + 1) / 2;
+
+    block_process(count, csizes_t<width, 1>(), [=](size_t i, auto w) {
+        constexpr size_t width    = val_of(decltype(w)());
+        constexpr size_t widthm1  = width - 1;
+        const cvec<T, width> tw   = cread<width>(rtwiddle.data() + i);
+        const cvec<T, width> fpk  = cread<width>(out + i);
+        const cvec<T, width> fpnk = reverse<2>(negodd(cread<width>(out + csize - i - widthm1)));
+
+        const cvec<T, width> f1k = fpk + fpnk;
+        const cvec<T, width> f2k = fpk - fpnk;
+        const cvec<T, width> t   = cmul(f2k, tw);
+        cwrite<width>(out + i, T(0.5) * (f1k + t));
+        cwrite<width>(out + csize - i - widthm1, reverse<2>(negodd(T(0.5) * (f1k - t))));
+    });
+
+    if (is_even(csize))
+    {
+        size_t k              = csize / 2;
+        const cvec<T, 1> fpk  = cread<1>(out + k);
+        const cvec<T, 1> fpnk = negodd(fpk);
+        cwrite<1>(out + k, fpnk);
+    }
+    if (fmt == dft_pack_format::CCs)
+    {
+        cwrite<1>(out, pack(dc[0] + dc[1], 0));
+        cwrite<1>(out + csize, pack(dc[0] - dc[1], 0));
+    }
+    else
+    {
+        cwrite<1>(out, pack(dc[0] + dc[1], dc[0] - dc[1]));
+    }
+}
+
+template <typename T>
 void dft_plan_real<T>::from_fmt(complex<T>* out, const complex<T>* in, dft_pack_format fmt) const
 {
     using namespace internal;
@@ -1055,67 +2368,557 @@ void dft_plan_real<T>::from_fmt(complex<T>* out, const complex<T>* in, dft_pack_
         cwrite<width>(out + csize - i - widthm1, reverse<2>(negodd(f1k - t)));
     });
 
+    if (is_even(csize))
+    {
+        size_t k              = csize / 2;
+        const cvec<T, 1> fpk  = cread<1>(in + k);
+        const cvec<T, 1> fpnk = 2 * negodd(fpk);
+        cwrite<1>(out + k, fpnk);
+    }
+    cwrite<1>(out, dc);
+}
+
+template <typename T>
+dft_plan<T>::~dft_plan() {}
+
+namespace internal
+{
+// dst[c * dst_stride + r] = src[r * src_stride + c] for r < rows, c < cols,
+// 4x4 tiles are transposed in registers
+template <typename T>
+void dft_md_transpose(complex<T>* dst, size_t dst_stride, const complex<T>* src, size_t src_stride,
+                      size_t rows, size_t cols)
+{
+    constexpr size_t tile = 4;
+    size_t r              = 0;
+    for (; r + tile <= rows; r += tile)
+    {
+        const complex<T>* s = src + r * src_stride;
+        size_t c            = 0;
+        for (; c + tile <= cols; c += tile)
+        {
+            cvec<T, tile> w0, w1, w2, w3;
+            split(ctranspose<tile>(concat(cread<tile>(s + c), cread<tile>(s + src_stride + c),
+                                          cread<tile>(s + src_stride * 2 + c),
+                                          cread<tile>(s + src_stride * 3 + c))),
+                  w0, w1, w2, w3);
+            cwrite<tile>(dst + c * dst_stride + r, w0);
+            cwrite<tile>(dst + (c + 1) * dst_stride + r, w1);
+            cwrite<tile>(dst + (c + 2) * dst_stride + r, w2);
+            cwrite<tile>(dst + (c + 3) * dst_stride + r, w3);
+        }
+        for (; c < cols; c++)
+            for (size_t i = 0; i < tile; i++)
+                dst[c * dst_stride + r + i] = s[i * src_stride + c];
+    }
+    for (; r < rows; r++)
+        for (size_t c = 0; c < cols; c++)
+            dst[c * dst_stride + r] = src[r * src_stride + c];
+}
+
+constexpr size_t dft_md_block = 8;
+
+// Shapes must be non-empty with all extents at least 1, the last extent of a real transform must be even
+inline bool dft_md_valid(const std::vector<size_t>& shape, bool real)
+{
+    if (shape.empty() || (real && shape.back() % 2))
+        return false;
+    for (size_t n : shape)
+        if (n == 0)
+            return false;
+    return true;
+}
+
+// Number of elements of the shape, zero for an invalid shape
+inline size_t dft_md_size(const std::vector<size_t>& shape)
+{
+    if (shape.empty())
+        return 0;
+    size_t size = 1;
+    for (size_t n : shape)
+        size *= n;
+    return size;
+}
+
+// Transforms along the first axes of a row-major array.
+// Columns are copied to a contiguous buffer in blocks and transformed by one batched call
+template <typename T>
+void dft_md_execute_axes(const std::vector<std::shared_ptr<const dft_plan<T>>>& plans,
+                         const std::vector<size_t>& shape, size_t axes, complex<T>* data, u8* temp,
+                         bool inverse)
+{
+    size_t inner = 1;
+    for (size_t a = axes; a < shape.size(); a++)
+        inner *= shape[a];
+    size_t outer = 1;
+    for (size_t a = 0; a < axes; a++)
+        outer *= shape[a];
+    for (size_t a = axes; a-- > 0;)
+    {
+        const size_t size = shape[a];
+        outer /= size;
+        if (size > 1)
+        {
+            complex<T>* block = ptr_cast<complex<T>>(temp);
+            u8* plan_temp =
+                temp + align_up(sizeof(complex<T>) * dft_md_block * size, platform<>::native_cache_alignment);
+            for (size_t o = 0; o < outer; o++)
+            {
+                complex<T>* matrix = data + o * size * inner;
+                for (size_t c = 0; c < inner; c += dft_md_block)
+                {
+                    const size_t columns = std::min(dft_md_block, inner - c);
+                    dft_md_transpose(block, size, matrix + c, inner, size, columns);
+                    plans[a]->execute_batch(block, block, plan_temp, columns, size, size, inverse);
+                    dft_md_transpose(matrix + c, inner, block, size, columns, size);
+                }
+            }
+        }
+        inner *= size;
+    }
+}
+
+template <typename T>
+size_t dft_md_temp_size(const std::vector<std::shared_ptr<const dft_plan<T>>>& plans)
+{
+    size_t temp_size = 0;
+    for (const std::shared_ptr<const dft_plan<T>>& plan : plans)
+        if (plan)
+            temp_size = std::max(temp_size, align_up(sizeof(complex<T>) * dft_md_block * plan->size,
+                                                     platform<>::native_cache_alignment) +
+                                                plan->batch_temp_size);
+    return temp_size;
+}
+
+template <typename T>
+std::vector<std::shared_ptr<const dft_plan<T>>> dft_md_make_plans(const std::vector<size_t>& shape,
+                                                                  size_t axes)
+{
+    std::vector<std::shared_ptr<const dft_plan<T>>> plans(axes);
+    for (size_t a = 0; a < axes; a++)
+    {
+        for (size_t b = 0; b < a; b++)
+            if (shape[b] == shape[a])
+                plans[a] = plans[b];
+        if (!plans[a] && shape[a] > 1)
+            plans[a] = std::make_shared<const dft_plan<T>>(shape[a]);
+    }
+    return plans;
+}
+} // namespace internal
+
+template <typename T>
+dft_plan_md<T>::dft_plan_md(const std::vector<size_t>& shape)
+    : shape(internal::dft_md_valid(shape, false) ? shape : std::vector<size_t>()),
+      size(internal::dft_md_size(this->shape)),
+      plans(internal::dft_md_make_plans<T>(this->shape, this->shape.size()))
+{
+    temp_size = internal::dft_md_temp_size(plans);
+}
+
+template <typename T>
+void dft_plan_md<T>::execute(complex<T>* out, const complex<T>* in, u8* temp, bool inverse) const
+{
+    if (shape.empty())
+        return;
+    const size_t last = shape.back();
+    if (last > 1)
+        plans.back()->execute_batch(out, in, temp, size / last, last, last, inverse);
+    else if (out != in)
+        internal::builtin_memcpy(out, in, sizeof(complex<T>) * size);
+    internal::dft_md_execute_axes(plans, shape, shape.size() - 1, out, temp, inverse);
+}
+
+template <typename T>
+dft_plan_md_real<T>::dft_plan_md_real(const std::vector<size_t>& shape)
+    : shape(internal::dft_md_valid(shape, true) ? shape : std::vector<size_t>()),
+      size(internal::dft_md_size(this->shape)),
+      complex_size(size ? size / this->shape.back() * (this->shape.back() / 2 + 1) : 0), temp_size(0)
+{
+    if (!size)
+        return;
+    plans     = internal::dft_md_make_plans<T>(this->shape, this->shape.size() - 1);
+    real_plan = std::make_shared<const dft_plan_real<T>>(this->shape.back());
+    temp_size = align_up(sizeof(complex<T>) * complex_size, platform<>::native_cache_alignment) +
+                std::max(internal::dft_md_temp_size(plans), real_plan->batch_temp_size);
+}
+
+template <typename T>
+void dft_plan_md_real<T>::execute(complex<T>* out, const T* in, u8* temp) const
+{
+    if (shape.empty())
+        return;
+    const size_t last          = shape.back();
+    const size_t clast         = last / 2 + 1;
+    std::vector<size_t> cshape = shape;
+    cshape.back()              = clast;
+    real_plan->execute_batch(out, in, temp, size / last, clast, last);
+    internal::dft_md_execute_axes(plans, cshape, shape.size() - 1, out, temp, false);
+}
+
+template <typename T>
+void dft_plan_md_real<T>::execute(T* out, const complex<T>* in, u8* temp) const
+{
+    if (shape.empty())
+        return;
+    const size_t last          = shape.back();
+    const size_t clast         = last / 2 + 1;
+    std::vector<size_t> cshape = shape;
+    cshape.back()              = clast;
+    complex<T>* spectrum       = ptr_cast<complex<T>>(temp);
+    temp += align_up(sizeof(complex<T>) * complex_size, platform<>::native_cache_alignment);
+    internal::builtin_memcpy(spectrum, in, sizeof(complex<T>) * complex_size);
+    internal::dft_md_execute_axes(plans, cshape, shape.size() - 1, spectrum, temp, true);
+    real_plan->execute_batch(out, spectrum, temp, size / last, last, clast);
+}
+
+template <typename T>
+dct_plan<T>::dct_plan(size_t size, dct_type type) : size(size), type(type), plan(size)
+{
+    using namespace internal;
+    const size_t half = size / 2;
+    const size_t work = align_up(sizeof(complex<T>) * (half + 1), platform<>::native_cache_alignment);
+    temp_size         = work * 2 + plan.temp_size;
+    if (type == dct_type::IV)
+    {
+        twiddle.resize(half);
+        post_twiddle.resize(half);
+        for (size_t n = 0; n < half; n++)
+        {
+            cwrite<1>(twiddle.data() + n, calculate_twiddle<T>(4 * n + 1, 8 * size));
+            cwrite<1>(post_twiddle.data() + n, calculate_twiddle<T>(n, 2 * size));
+        }
+    }
+    else
+    {
+        twiddle.resize(half + 1);
+        for (size_t k = 0; k <= half; k++)
+            cwrite<1>(twiddle.data() + k, calculate_twiddle<T>(k, 4 * size));
+    }
+}
+
+template <typename T>
+template <bool sine>
+void dct_plan<T>::execute_dct(cbool_t<sine>, T* out, const T* in, u8* temp) const
+{
+    using namespace internal;
+    constexpr size_t width = platform<T>::vector_width;
+    const size_t N         = size;
+    const size_t half      = size / 2;
+    const size_t work      = align_up(sizeof(complex<T>) * (half + 1), platform<>::native_cache_alignment);
+    complex<T>* spectrum   = ptr_cast<complex<T>>(temp);
+    complex<T>* buffer     = ptr_cast<complex<T>>(temp + work);
+    u8* plan_temp          = temp + work * 2;
+    const complex<T>* tw   = twiddle.data();
+
+    if (type == dct_type::II)
+    {
+        // Makhoul: even samples go forward, odd samples go backward, then a real FFT and a twiddle
+        T* v = ptr_cast<T>(buffer);
+        block_process(half, csizes_t<width, 1>(), [=](size_t n, auto w) {
+            constexpr size_t width = val_of(decltype(w)());
+            vec<T, width> even, odd;
+            split(splitpairs(read<width * 2>(in + 2 * n)), even, odd);
+            write(v + n, even);
+            write(v + N - n - width, reverse(sine ? -odd : odd));
+        });
+        plan.execute(spectrum, v, plan_temp);
+        const complex<T> dc  = spectrum[0];
+        const complex<T> mid = spectrum[half] * tw[half];
+        block_process(half - 1, csizes_t<width, 1>(), [=](size_t k, auto w) {
+            k++;
+            constexpr size_t width = val_of(decltype(w)());
+            vec<T, width> re, im;
+            split(splitpairs(cmul(cread<width>(spectrum + k), cread<width>(tw + k))), re, im);
+            if (sine)
+            {
+                write(out + N - k - width, reverse(re));
+                write(out + k - 1, -im);
+            }
+            else
+            {
+                write(out + k, re);
+                write(out + N - k - (width - 1), reverse(-im));
+            }
+        });
+        out[sine ? N - 1 : 0]       = dc.real();
+        out[sine ? half - 1 : half] = mid.real();
+    }
+    else if (type == dct_type::III)
+    {
+        // Inverse of the above, the factor 0.5 makes the result match the DCT-III definition
+        const T first = sine ? in[N - 1] : in[0];
+        const T mid   = sine ? in[half - 1] : in[half];
+        block_process(half - 1, csizes_t<width, 1>(), [=](size_t k, auto w) {
+            k++;
+            constexpr size_t width = val_of(decltype(w)());
+            const vec<T, width> a  = sine ? reverse(read<width>(in + N - k - width)) : read<width>(in + k);
+            const vec<T, width> b =
+                sine ? read<width>(in + k - 1) : reverse(read<width>(in + N - k - (width - 1)));
+            cwrite<width>(spectrum + k, T(0.5) * cmul_conj(interleave(a, -b), cread<width>(tw + k)));
+        });
+        spectrum[0]    = complex<T>(T(0.5) * first, T(0));
+        spectrum[half] = complex<T>(mid * c_sqrt_2<T> * T(0.5), T(0));
+        T* v           = ptr_cast<T>(buffer);
+        plan.execute(v, spectrum, plan_temp);
+        block_process(half, csizes_t<width, 1>(), [=](size_t n, auto w) {
+            constexpr size_t width = val_of(decltype(w)());
+            const vec<T, width> odd = reverse(read<width>(v + N - n - width));
+            write(out + 2 * n, interleave(read<width>(v + n), sine ? -odd : odd));
+        });
+    }
+    else
+    {
+        // Half-size complex FFT of the samples paired from both ends with pre- and post-twiddles.
+        // DST-IV is DCT-IV of the reversed input with odd outputs negated
+        const complex<T>* post = post_twiddle.data();
+        block_process(half, csizes_t<width, 1>(), [=](size_t n, auto w) {
+            constexpr size_t width = val_of(decltype(w)());
+            vec<T, width> even, odd, dummy;
+            split(splitpairs(read<width * 2>(in + 2 * n)), even, dummy);
+            split(splitpairs(read<width * 2>(in + N - 2 * n - width * 2)), dummy, odd);
+            odd = reverse(odd);
+            cwrite<width>(buffer + n, cmul(sine ? interleave(odd, even) : interleave(even, odd),
+                                           cread<width>(tw + n)));
+        });
+        static_cast<const dft_plan<T>&>(plan).execute(spectrum, buffer, plan_temp);
+        // Even outputs take the real part of the post-twiddled bin k, odd outputs the imaginary part of
+        // bin half - 1 - k, so each product is computed once for k and its mirror m together
+        const size_t quarter = half / 2;
+        block_process(quarter, csizes_t<width, 1>(), [=](size_t k, auto w) {
+            constexpr size_t width = val_of(decltype(w)());
+            const size_t m         = half - k - width;
+            vec<T, width> re, im, mre, mim;
+            split(splitpairs(cmul(cread<width>(spectrum + k), cread<width>(post + k))), re, im);
+            split(splitpairs(cmul(cread<width>(spectrum + m), cread<width>(post + m))), mre, mim);
+            write(out + 2 * k, interleave(re, sine ? reverse(mim) : -reverse(mim)));
+            write(out + 2 * m, interleave(mre, sine ? reverse(im) : -reverse(im)));
+        });
+        if (half % 2)
+        {
+            const complex<T> middle = spectrum[quarter] * post[quarter];
+            out[2 * quarter]        = middle.real();
+            out[2 * quarter + 1]    = sine ? middle.imag() : -middle.imag();
+        }
+    }
+}
+
+template <typename T>
+mdct_plan<T>::mdct_plan(size_t size, const univector<T>& window)
+    : size(size), dct(size, dct_type::IV), window(window)
+{
+    if (this->window.empty())
+        this->window = univector<T>(size * 2, T(1));
+    temp_size = align_up(sizeof(T) * size, platform<>::native_cache_alignment) + dct.temp_size;
+}
+
+template <typename T>
+void mdct_plan<T>::execute(T* out, const T* in, u8* temp) const
+{
+    constexpr size_t width = platform<T>::vector_width;
+    const size_t M         = size;
+    const size_t M2        = size / 2;
+    const T* win           = window.data();
+    T* folded              = ptr_cast<T>(temp);
+
+    // Windowing and folding of the four quarters (a, b, c, d) into (-c_r - d, a - b_r) in one pass
+    block_process(M2, csizes_t<width, 1>(), [=](size_t n, auto w) {
+        constexpr size_t width = val_of(decltype(w)());
+        const size_t r         = M + M2 - n - width;
+        const vec<T, width> c  = reverse(read<width>(in + r) * read<width>(win + r));
+        const vec<T, width> d  = read<width>(in + M + M2 + n) * read<width>(win + M + M2 + n);
+        const vec<T, width> a  = read<width>(in + n) * read<width>(win + n);
+        const vec<T, width> b  = reverse(read<width>(in + M - n - width) * read<width>(win + M - n - width));
+        write(folded + n, -c - d);
+        write(folded + M2 + n, a - b);
+    });
+    dct.execute(out, folded, temp + align_up(sizeof(T) * M, platform<>::native_cache_alignment));
+}
+
+template <typename T>
+void mdct_plan<T>::execute_inverse(T* out, const T* in, u8* temp) const
+{
+    constexpr size_t width = platform<T>::vector_width;
+    const size_t M         = size;
+    const size_t M2        = size / 2;
+    const T* win           = window.data();
+    T* y                   = ptr_cast<T>(temp);
+    dct.execute(y, in, temp + align_up(sizeof(T) * M, platform<>::native_cache_alignment));
+
+    // Unfolding into (y2, -y2_r, -y1_r, -y1) and windowing in one pass
+    block_process(M2, csizes_t<width, 1>(), [=](size_t n, auto w) {
+        constexpr size_t width = val_of(decltype(w)());
+        write(out + n, read<width>(y + M2 + n) * read<width>(win + n));
+        write(out + M + M2 + n, -read<width>(y + n) * read<width>(win + M + M2 + n));
+    });
+    block_process(M, csizes_t<width, 1>(), [=](size_t n, auto w) {
+        constexpr size_t width = val_of(decltype(w)());
+        write(out + M2 + n, -reverse(read<width>(y + M - n - width)) * read<width>(win + M2 + n));
+    });
+}
+
+namespace internal
+{
+
+// Ratio of the time per size * log2(size) of the real FFT convolution to the time of a multiply-add
+// in direct convolution, the measured crossover is about 4.5 for both float and double on x86.
+// Kept as a fraction, convolve_direct_cost_num / convolve_direct_cost_den
+constexpr size_t convolve_direct_cost_num = 9;
+constexpr size_t convolve_direct_cost_den = 2;
+
+// Convolution is computed directly if its estimated cost is below the cost of the FFT method
+template <typename T>
+bool convolve_is_direct(size_t size1, size_t size2)
+{
+    const size_t size     = next_poweroftwo(size1 + size2 - 1);
+    const size_t log2size = ilog2(size);
+    return size < 16 ||
+           std::min(size1, size2) * (size1 + size2 - 1) * convolve_direct_cost_den <=
+               size * log2size * convolve_direct_cost_num;
+}
+
+template <typename T>
+size_t convolve_temp_size(size_t size1, size_t size2)
+{
+    if (!size1 || !size2)
+        return 0;
+    const size_t align = platform<>::native_cache_alignment;
+    if (convolve_is_direct<T>(size1, size2))
     {
-        size_t k              = csize / 2;
-        const cvec<T, 1> fpk  = cread<1>(in + k);
-        const cvec<T, 1> fpnk = 2 * negodd(fpk);
-        cwrite<1>(out + k, fpnk);
+        const size_t kernel = std::min(size1, size2);
+        return align_up(sizeof(T) * (size1 + size2 + kernel - 2), align) +
+               align_up(sizeof(T) * kernel, align);
     }
-    cwrite<1>(out, dc);
+    const size_t size = next_poweroftwo(size1 + size2 - 1);
+    return dft_cache::instance().getreal(ctype_t<T>(), size)->temp_size + align_up(sizeof(T) * size, align) +
+           align_up(sizeof(complex<T>) * size / 2, align) * 2;
 }
 
+// out[n] = sum(k) kernel[k] * input[n + k], the input is padded with zeros on both sides
+// and copied with the kernel to temp, reversed if requested
 template <typename T>
-dft_plan<T>::~dft_plan() {}
+void convolve_direct(T* out, const T* input, size_t input_size, bool input_reverse, const T* kernel,
+                     size_t kernel_size, bool kernel_reverse, u8* temp)
+{
+    constexpr size_t width = platform<T>::vector_width * 4;
+    const size_t size      = input_size + kernel_size - 1;
+    const size_t align     = platform<>::native_cache_alignment;
+    T* padded              = ptr_cast<T>(temp);
+    T* taps                = ptr_cast<T>(temp + align_up(sizeof(T) * (size + kernel_size - 1), align));
+    std::fill(padded, padded + kernel_size - 1, T(0));
+    std::fill(padded + size, padded + size + kernel_size - 1, T(0));
+    if (input_reverse)
+        std::reverse_copy(input, input + input_size, padded + kernel_size - 1);
+    else
+        std::copy(input, input + input_size, padded + kernel_size - 1);
+    if (kernel_reverse)
+        std::reverse_copy(kernel, kernel + kernel_size, taps);
+    else
+        std::copy(kernel, kernel + kernel_size, taps);
 
-namespace internal
+    block_process(size, csizes_t<width, 1>(), [=](size_t n, auto w) {
+        constexpr size_t width = val_of(decltype(w)());
+        vec<T, width> sum      = 0;
+        for (size_t k = 0; k < kernel_size; k++)
+            sum = fmadd(read<width>(padded + n + k), taps[k], sum);
+        write(out + n, sum);
+    });
+}
+
+template <typename T>
+void convolve_fft(T* out, const T* src1, size_t size1, const T* src2, size_t size2, bool reverse2, u8* temp)
 {
+    const size_t align             = platform<>::native_cache_alignment;
+    const size_t size              = next_poweroftwo(size1 + size2 - 1);
+    const size_t result_size       = size1 + size2 - 1;
+    const size_t real_bytes        = align_up(sizeof(T) * size, align);
+    const size_t complex_bytes     = align_up(sizeof(complex<T>) * size / 2, align);
+    const dft_plan_real_ptr<T> dft = dft_cache::instance().getreal(ctype_t<T>(), size);
+    T* padded                      = ptr_cast<T>(temp);
+    complex<T>* spectrum1          = ptr_cast<complex<T>>(temp + real_bytes);
+    complex<T>* spectrum2          = ptr_cast<complex<T>>(temp + real_bytes + complex_bytes);
+    u8* dft_temp                   = temp + real_bytes + complex_bytes * 2;
+
+    std::copy(src1, src1 + size1, padded);
+    std::fill(padded + size1, padded + size, T(0));
+    dft->execute(spectrum1, padded, dft_temp, dft_pack_format::Perm);
+    if (reverse2)
+        std::reverse_copy(src2, src2 + size2, padded);
+    else
+        std::copy(src2, src2 + size2, padded);
+    std::fill(padded + size2, padded + size, T(0));
+    dft->execute(spectrum2, padded, dft_temp, dft_pack_format::Perm);
+
+    // Perm format keeps the real DC and Nyquist values in the first element
+    const complex<T> first(spectrum1[0].real() * spectrum2[0].real(),
+                           spectrum1[0].imag() * spectrum2[0].imag());
+    univector<complex<T>, 0> product = make_univector(spectrum1, size / 2);
+    process(product, product * make_univector(spectrum2, size / 2));
+    spectrum1[0] = first;
+
+    dft->execute(padded, spectrum1, dft_temp, dft_pack_format::Perm);
+    process(make_univector(out, result_size), make_univector(padded, result_size) * reciprocal(T(size)));
+}
 
 template <typename T>
-univector<T> convolve(const univector_ref<const T>& src1, const univector_ref<const T>& src2)
+void convolve(T* out, const T* src1, size_t size1, const T* src2, size_t size2, u8* temp)
+{
+    if (!size1 || !size2)
+        return;
+    if (!convolve_is_direct<T>(size1, size2))
+        convolve_fft(out, src1, size1, src2, size2, false, temp);
+    else if (size1 >= size2)
+        convolve_direct(out, src1, size1, false, src2, size2, true, temp);
+    else
+        convolve_direct(out, src2, size2, false, src1, size1, true, temp);
+}
+
+// correlate(a, b) is the convolution of a with reversed b
+template <typename T>
+void correlate(T* out, const T* src1, size_t size1, const T* src2, size_t size2, u8* temp)
 {
-    const size_t size                = next_poweroftwo(src1.size() + src2.size() - 1);
-    univector<complex<T>> src1padded = src1;
-    univector<complex<T>> src2padded = src2;
-    src1padded.resize(size, 0);
-    src2padded.resize(size, 0);
+    if (!size1 || !size2)
+        return;
+    if (!convolve_is_direct<T>(size1, size2))
+        convolve_fft(out, src1, size1, src2, size2, true, temp);
+    else if (size1 >= size2)
+        convolve_direct(out, src1, size1, false, src2, size2, false, temp);
+    else
+        convolve_direct(out, src2, size2, true, src1, size1, true, temp);
+}
 
-    dft_plan_ptr<T> dft = dft_cache::instance().get(ctype_t<T>(), size);
-    univector<u8> temp(dft->temp_size);
-    dft->execute(src1padded, src1padded, temp);
-    dft->execute(src2padded, src2padded, temp);
-    src1padded = src1padded * src2padded;
-    dft->execute(src1padded, src1padded, temp, true);
-    const T invsize = reciprocal<T>(size);
-    return truncate(real(src1padded), src1.size() + src2.size() - 1) * invsize;
+template <typename T>
+univector<T> convolve(const univector_ref<const T>& src1, const univector_ref<const T>& src2)
+{
+    univector<T> result(src1.empty() || src2.empty() ? 0 : src1.size() + src2.size() - 1);
+    univector<u8> temp(convolve_temp_size<T>(src1.size(), src2.size()));
+    convolve(result.data(), src1.data(), src1.size(), src2.data(), src2.size(), temp.data());
+    return result;
 }
 
 template <typename T>
 univector<T> correlate(const univector_ref<const T>& src1, const univector_ref<const T>& src2)
 {
-    const size_t size                = next_poweroftwo(src1.size() + src2.size() - 1);
-    univector<complex<T>> src1padded = src1;
-    univector<complex<T>> src2padded = reverse(src2);
-    src1padded.resize(size, 0);
-    src2padded.resize(size, 0);
-    dft_plan_ptr<T> dft = dft_cache::instance().get(ctype_t<T>(), size);
-    univector<u8> temp(dft->temp_size);
-    dft->execute(src1padded, src1padded, temp);
-    dft->execute(src2padded, src2padded, temp);
-    src1padded = src1padded * src2padded;
-    dft->execute(src1padded, src1padded, temp, true);
-    const T invsize = reciprocal<T>(size);
-    return truncate(real(src1padded), src1.size() + src2.size() - 1) * invsize;
+    univector<T> result(src1.empty() || src2.empty() ? 0 : src1.size() + src2.size() - 1);
+    univector<u8> temp(convolve_temp_size<T>(src1.size(), src2.size()));
+    correlate(result.data(), src1.data(), src1.size(), src2.data(), src2.size(), temp.data());
+    return result;
 }
 
 template <typename T>
 univector<T> autocorrelate(const univector_ref<const T>& src1)
 {
-    return internal::autocorrelate(src1.slice());
-    univector<T> result = correlate(src1, src1);
-    result              = result.slice(result.size() / 2);
-    return result;
+    const univector<T> result = correlate(src1, src1);
+    return result.slice(result.size() / 2);
 }
 
+template size_t convolve_temp_size<float>(size_t, size_t);
+template size_t convolve_temp_size<double>(size_t, size_t);
+template void convolve<float>(float*, const float*, size_t, const float*, size_t, u8*);
+template void convolve<double>(double*, const double*, size_t, const double*, size_t, u8*);
+template void correlate<float>(float*, const float*, size_t, const float*, size_t, u8*);
+template void correlate<double>(double*, const double*, size_t, const double*, size_t, u8*);
+
 template univector<float> convolve<float>(const univector_ref<const float>&,
                                           const univector_ref<const float>&);
 template univector<double> convolve<double>(const univector_ref<const double>&,
@@ -1131,42 +2934,111 @@ template univector<double> autocorrelate<double>(const univector_ref<const doubl
 } // namespace internal
 
 template <typename T>
-convolve_filter<T>::convolve_filter(size_t size, size_t block_size)
-    : fft(2 * next_poweroftwo(block_size)), size(size), block_size(block_size), temp(fft.temp_size),
-      segments((size + block_size - 1) / block_size)
+convolve_filter<T>::convolve_filter(size_t size, size_t block_size, bool buffered)
+    : fft(2 * next_poweroftwo(block_size)), size(size), block_size(next_poweroftwo(block_size)),
+      temp(fft.temp_size), segments((size + next_poweroftwo(block_size) - 1) / next_poweroftwo(block_size)),
+      ir_segments((size + next_poweroftwo(block_size) - 1) / next_poweroftwo(block_size)), input_position(0),
+      position(0), buffered(buffered), swap_state(swap_idle)
 {
+    set_data(univector<T>());
 }
 
 template <typename T>
-convolve_filter<T>::convolve_filter(const univector<T>& data, size_t block_size)
+convolve_filter<T>::convolve_filter(const univector<T>& data, size_t block_size, bool buffered)
     : fft(2 * next_poweroftwo(block_size)), size(data.size()), block_size(next_poweroftwo(block_size)),
       temp(fft.temp_size),
       segments((data.size() + next_poweroftwo(block_size) - 1) / next_poweroftwo(block_size)),
       ir_segments((data.size() + next_poweroftwo(block_size) - 1) / next_poweroftwo(block_size)),
-      input_position(0), position(0)
+      input_position(0), position(0), buffered(buffered), swap_state(swap_idle)
 {
     set_data(data);
 }
 
 template <typename T>
-void convolve_filter<T>::set_data(const univector<T>& data)
+void convolve_filter<T>::transform_segments(std::vector<univector<complex<T>>>& ir, const univector<T>& data,
+                                            u8* temp) const
 {
     univector<T> input(fft.size);
     const T ifftsize = reciprocal(T(fft.size));
-    for (size_t i = 0; i < ir_segments.size(); i++)
+    for (size_t i = 0; i < ir.size(); i++)
     {
-        segments[i].resize(block_size);
-        ir_segments[i].resize(block_size, 0);
-        input = padded(data.slice(i * block_size, block_size));
+        ir[i].resize(block_size, 0);
+        if (i * block_size < data.size())
+            input = padded(data.slice(i * block_size, block_size));
+        else
+            input = zeros();
 
-        fft.execute(ir_segments[i], input, temp, dft_pack_format::Perm);
-        process(ir_segments[i], ir_segments[i] * ifftsize);
+        fft.execute(ir[i].data(), input.data(), temp, dft_pack_format::Perm);
+        process(ir[i], ir[i] * ifftsize);
     }
+}
+
+template <typename T>
+void convolve_filter<T>::set_data(const univector<T>& data)
+{
+    for (size_t i = 0; i < segments.size(); i++)
+        segments[i].resize(block_size);
+    transform_segments(ir_segments, data, temp.data());
     saved_input.resize(block_size, 0);
     scratch.resize(block_size * 2);
     premul.resize(block_size, 0);
     cscratch.resize(block_size);
     overlap.resize(block_size, 0);
+    output_fifo.resize(buffered ? block_size : 0, 0);
+
+    next_ir_segments.resize(ir_segments.size());
+    for (size_t i = 0; i < next_ir_segments.size(); i++)
+        next_ir_segments[i].resize(block_size, 0);
+    next_premul.resize(block_size, 0);
+    next_cscratch.resize(block_size);
+    next_scratch.resize(block_size * 2);
+    next_overlap.resize(block_size, 0);
+}
+
+template <typename T>
+bool convolve_filter<T>::prepare_data(const univector<T>& data)
+{
+    if (data.size() > size)
+        return false;
+    int expected = swap_idle;
+    if (!swap_state.compare_exchange_strong(expected, swap_preparing, std::memory_order_acquire))
+        return false;
+    univector<u8> prepare_temp(fft.temp_size);
+    transform_segments(next_ir_segments, data, prepare_temp.data());
+    swap_state.store(swap_ready, std::memory_order_release);
+    return true;
+}
+
+template <typename T>
+void convolve_filter<T>::premultiply(univector<complex<T>>& result,
+                                     const std::vector<univector<complex<T>>>& ir)
+{
+    process(result, zeros());
+    for (size_t i = 1; i < segments.size(); i++)
+    {
+        const size_t n = (position + i) % segments.size();
+        fft_multiply_accumulate(result, ir[i], segments[n], dft_pack_format::Perm);
+    }
+}
+
+template <typename T>
+void convolve_filter<T>::begin_crossfade()
+{
+    // Called at the start of a block before its spectrum replaces the oldest segment
+    if (swap_state.load(std::memory_order_acquire) != swap_ready)
+        return;
+    swap_state.store(swap_crossfading, std::memory_order_relaxed);
+
+    // The overlap of the previous block as if the new response had always been used,
+    // computed from the same input spectra
+    process(next_premul, zeros());
+    for (size_t i = 0; i < segments.size(); i++)
+    {
+        const size_t n = (position + 1 + i) % segments.size();
+        fft_multiply_accumulate(next_premul, next_ir_segments[i], segments[n], dft_pack_format::Perm);
+    }
+    fft.execute(next_scratch, next_premul, temp, dft_pack_format::Perm);
+    internal::builtin_memcpy(next_overlap.data(), next_scratch.data() + block_size, block_size * sizeof(T));
 }
 
 template <typename T>
@@ -1178,82 +3050,760 @@ void convolve_filter<T>::process_buffer(T* output, const T* input, size_t size)
         const size_t processing = std::min(size - processed, block_size - input_position);
         internal::builtin_memcpy(saved_input.data() + input_position, input + processed,
                                  processing * sizeof(T));
+        T* out = output + processed;
+        if (buffered)
+        {
+            internal::builtin_memcpy(out, output_fifo.data() + input_position, processing * sizeof(T));
+            input_position += processing;
+            processed += processing;
+            // In buffered mode the block is transformed once when it is complete
+            if (input_position < block_size)
+                continue;
+            input_position = 0;
+        }
+        const size_t start = buffered ? 0 : input_position;
+        const size_t count = buffered ? block_size : processing;
+        if (buffered)
+            out = output_fifo.data();
+
+        if (start == 0)
+            begin_crossfade();
+        const bool crossfade = swap_state.load(std::memory_order_relaxed) == swap_crossfading;
 
         process(scratch, padded(saved_input));
         fft.execute(segments[position], scratch, temp, dft_pack_format::Perm);
 
-        if (input_position == 0)
+        if (start == 0)
         {
-            process(premul, zeros());
-            for (size_t i = 1; i < segments.size(); i++)
-            {
-                const size_t n = (position + i) % segments.size();
-                fft_multiply_accumulate(premul, ir_segments[i], segments[n], dft_pack_format::Perm);
-            }
+            premultiply(premul, ir_segments);
+            if (crossfade)
+                premultiply(next_premul, next_ir_segments);
         }
         fft_multiply_accumulate(cscratch, premul, ir_segments[0], segments[position], dft_pack_format::Perm);
-
         fft.execute(scratch, cscratch, temp, dft_pack_format::Perm);
 
-        process(make_univector(output + processed, processing),
-                scratch.slice(input_position) + overlap.slice(input_position));
+        if (crossfade)
+        {
+            fft_multiply_accumulate(next_cscratch, next_premul, next_ir_segments[0], segments[position],
+                                    dft_pack_format::Perm);
+            fft.execute(next_scratch, next_cscratch, temp, dft_pack_format::Perm);
+
+            // Linear crossfade over the block, the last sample uses the new response only
+            const T step = reciprocal(T(block_size));
+            process(make_univector(out, count),
+                    mix(counter(T(start + 1) * step, step), scratch.slice(start) + overlap.slice(start),
+                        next_scratch.slice(start) + next_overlap.slice(start)));
+        }
+        else
+        {
+            process(make_univector(out, count), scratch.slice(start) + overlap.slice(start));
+        }
 
-        input_position += processing;
-        if (input_position == block_size)
+        if (!buffered)
         {
+            input_position += processing;
+            processed += processing;
+            if (input_position < block_size)
+                continue;
             input_position = 0;
             process(saved_input, zeros());
+        }
+
+        const univector<T>& result = crossfade ? next_scratch : scratch;
+        internal::builtin_memcpy(overlap.data(), result.data() + block_size, block_size * sizeof(T));
+        if (crossfade)
+        {
+            std::swap(ir_segments, next_ir_segments);
+            swap_state.store(swap_idle, std::memory_order_release);
+        }
+        position = position > 0 ? position - 1 : segments.size() - 1;
+    }
+}
+
+template <typename T>
+convolve_matrix<T>::convolve_matrix(const std::vector<std::vector<univector<T>>>& data, size_t block_size)
+    : fft(2 * next_poweroftwo(block_size)), block_size(next_poweroftwo(block_size)), input_count(data.size()),
+      output_count(data.empty() ? 0 : data.front().size()), temp(fft.temp_size), segments(data.size()),
+      ir_segments(data.size() * output_count), input_fifo(data.size()), output_fifo(output_count),
+      overlap(output_count), fifo_position(0), position(0)
+{
+    size_t count = 1;
+    for (const std::vector<univector<T>>& row : data)
+        for (const univector<T>& ir : row)
+            count = std::max(count, (ir.size() + this->block_size - 1) / this->block_size);
+
+    univector<T> input(fft.size);
+    const T ifftsize = reciprocal(T(fft.size));
+    for (size_t i = 0; i < input_count; i++)
+    {
+        segments[i].resize(count);
+        for (univector<complex<T>>& segment : segments[i])
+            segment.resize(this->block_size, 0);
+        input_fifo[i].resize(this->block_size, 0);
+        for (size_t o = 0; o < output_count; o++)
+        {
+            const univector<T>& ir                     = data[i][o];
+            std::vector<univector<complex<T>>>& irsegs = ir_segments[i * output_count + o];
+            irsegs.resize((ir.size() + this->block_size - 1) / this->block_size);
+            for (size_t k = 0; k < irsegs.size(); k++)
+            {
+                irsegs[k].resize(this->block_size);
+                input = padded(ir.slice(k * this->block_size, this->block_size));
+                fft.execute(irsegs[k], input, temp, dft_pack_format::Perm);
+                process(irsegs[k], irsegs[k] * ifftsize);
+            }
+        }
+    }
+    for (size_t o = 0; o < output_count; o++)
+    {
+        output_fifo[o].resize(this->block_size, 0);
+        overlap[o].resize(this->block_size, 0);
+    }
+    premul.resize(this->block_size);
+    scratch.resize(this->block_size * 2);
+}
+
+template <typename T>
+void convolve_matrix<T>::reset()
+{
+    for (size_t i = 0; i < input_count; i++)
+    {
+        for (univector<complex<T>>& segment : segments[i])
+            process(segment, zeros());
+        process(input_fifo[i], zeros());
+    }
+    for (size_t o = 0; o < output_count; o++)
+    {
+        process(output_fifo[o], zeros());
+        process(overlap[o], zeros());
+    }
+    fifo_position = 0;
+    position      = 0;
+}
+
+template <typename T>
+void convolve_matrix<T>::apply(T* const* output, const T* const* input, size_t size)
+{
+    size_t processed = 0;
+    while (processed < size)
+    {
+        const size_t processing = std::min(size - processed, block_size - fifo_position);
+        for (size_t i = 0; i < input_count; i++)
+            internal::builtin_memcpy(input_fifo[i].data() + fifo_position, input[i] + processed,
+                                     processing * sizeof(T));
+        for (size_t o = 0; o < output_count; o++)
+            internal::builtin_memcpy(output[o] + processed, output_fifo[o].data() + fifo_position,
+                                     processing * sizeof(T));
+        fifo_position += processing;
+        processed += processing;
+        if (fifo_position == block_size)
+        {
+            fifo_position = 0;
+            process_block();
+        }
+    }
+}
+
+template <typename T>
+void convolve_matrix<T>::process_block()
+{
+    for (size_t i = 0; i < input_count; i++)
+    {
+        process(scratch, padded(input_fifo[i]));
+        fft.execute(segments[i][position], scratch, temp, dft_pack_format::Perm);
+    }
+    const size_t count = input_count ? segments[0].size() : 0;
+    for (size_t o = 0; o < output_count; o++)
+    {
+        bool empty = true;
+        process(premul, zeros());
+        for (size_t i = 0; i < input_count; i++)
+        {
+            const std::vector<univector<complex<T>>>& irsegs = ir_segments[i * output_count + o];
+            for (size_t k = 0; k < irsegs.size(); k++)
+            {
+                const size_t n = (position + k) % count;
+                fft_multiply_accumulate(premul, irsegs[k], segments[i][n], dft_pack_format::Perm);
+                empty = false;
+            }
+        }
+        if (empty)
+            continue;
+        fft.execute(scratch, premul, temp, dft_pack_format::Perm);
+        process(output_fifo[o], scratch.slice(0, block_size) + overlap[o]);
+        internal::builtin_memcpy(overlap[o].data(), scratch.data() + block_size, block_size * sizeof(T));
+    }
+    if (count)
+        position = position > 0 ? position - 1 : count - 1;
+}
+
+template <typename T>
+partitioned_lms_filter<T>::partitioned_lms_filter(size_t tapcount, T step, size_t block_size,
+                                                  T regularization)
+    : fft(2 * next_poweroftwo(block_size)), block_size(next_poweroftwo(block_size)),
+      partitions(std::max(size_t(1), (tapcount + this->block_size - 1) / this->block_size)),
+      step(step), regularization(regularization), temp(fft.temp_size), segments(partitions),
+      weights(partitions)
+{
+    const size_t bins = this->block_size + 1;
+    for (size_t p = 0; p < partitions; p++)
+    {
+        segments[p].resize(bins);
+        weights[p].resize(bins);
+    }
+    power.resize(bins);
+    previous_input.resize(this->block_size);
+    input_fifo.resize(this->block_size);
+    desired_fifo.resize(this->block_size);
+    output_fifo.resize(this->block_size);
+    error_fifo.resize(this->block_size);
+    spectrum.resize(bins);
+    gradient.resize(bins);
+    scratch.resize(fft.size);
+    reset();
+}
+
+template <typename T>
+void partitioned_lms_filter<T>::reset()
+{
+    for (size_t p = 0; p < partitions; p++)
+    {
+        process(segments[p], zeros());
+        process(weights[p], zeros());
+    }
+    process(previous_input, zeros());
+    process(input_fifo, zeros());
+    process(desired_fifo, zeros());
+    process(output_fifo, zeros());
+    process(error_fifo, zeros());
+    fifo_position = 0;
+    position      = 0;
+}
+
+template <typename T>
+univector<T> partitioned_lms_filter<T>::taps() const
+{
+    // The weights are kept as spectra of the partitions scaled by 1 / fft.size
+    univector<T> result(tapcount());
+    univector<T> frame(fft.size);
+    univector<u8> taps_temp(fft.temp_size);
+    for (size_t p = 0; p < partitions; p++)
+    {
+        fft.execute(frame, weights[p], taps_temp);
+        internal::builtin_memcpy(result.data() + p * block_size, frame.data(), block_size * sizeof(T));
+    }
+    return result;
+}
+
+template <typename T>
+void partitioned_lms_filter<T>::apply(T* output, T* error, const T* input, const T* desired, size_t size)
+{
+    size_t processed = 0;
+    while (processed < size)
+    {
+        const size_t processing = std::min(size - processed, block_size - fifo_position);
+        const size_t bytes      = processing * sizeof(T);
+        internal::builtin_memcpy(input_fifo.data() + fifo_position, input + processed, bytes);
+        internal::builtin_memcpy(desired_fifo.data() + fifo_position, desired + processed, bytes);
+        if (output)
+            internal::builtin_memcpy(output + processed, output_fifo.data() + fifo_position, bytes);
+        if (error)
+            internal::builtin_memcpy(error + processed, error_fifo.data() + fifo_position, bytes);
+        fifo_position += processing;
+        processed += processing;
+        if (fifo_position == block_size)
+        {
+            fifo_position = 0;
+            process_block();
+        }
+    }
+}
+
+template <typename T>
+void partitioned_lms_filter<T>::process_block()
+{
+    const size_t bins  = block_size + 1;
+    const size_t bytes = block_size * sizeof(T);
+
+    // Overlap-save: the spectrum of the previous and the current block replaces the oldest segment
+    internal::builtin_memcpy(scratch.data(), previous_input.data(), bytes);
+    internal::builtin_memcpy(scratch.data() + block_size, input_fifo.data(), bytes);
+    internal::builtin_memcpy(previous_input.data(), input_fifo.data(), bytes);
+    fft.execute(segments[position], scratch, temp);
+
+    process(spectrum, zeros());
+    for (size_t p = 0; p < partitions; p++)
+        fft_multiply_accumulate(spectrum, weights[p], segments[(position + p) % partitions]);
+    fft.execute(scratch, spectrum, temp);
+    process(output_fifo, scratch.slice(block_size, block_size));
+    process(error_fifo, desired_fifo - output_fifo);
+
+    // The error is correlated with each segment in the frequency domain, the step of each bin
+    // is normalized by the input power in that bin
+    process(scratch, zeros());
+    internal::builtin_memcpy(scratch.data() + block_size, error_fifo.data(), bytes);
+    fft.execute(spectrum, scratch, temp);
+    process(power, zeros());
+    for (size_t p = 0; p < partitions; p++)
+        power = power + sqr(real(segments[p])) + sqr(imag(segments[p]));
+    const T scale = step / T(block_size * fft.size);
+    for (size_t k = 0; k < bins; k++)
+        spectrum[k] = spectrum[k] * (scale / (power[k] + regularization));
+
+    for (size_t p = 0; p < partitions; p++)
+    {
+        const univector<complex<T>>& segment = segments[(position + p) % partitions];
+        for (size_t k = 0; k < bins; k++)
+            gradient[k] = complex<T>(segment[k].real(), -segment[k].imag()) * spectrum[k];
+        // Only the first half of the correlation belongs to the partition, the rest is circular wraparound
+        fft.execute(scratch, gradient, temp);
+        process(scratch.slice(block_size, block_size), zeros());
+        fft.execute(gradient, scratch, temp);
+        process(weights[p], weights[p] + gradient);
+    }
+    position = position > 0 ? position - 1 : partitions - 1;
+}
+
+namespace internal
+{
+template <typename T>
+void convolve_stage<T>::process(const T* frame)
+{
+    fft->execute(segments[position].data(), frame, temp.data(), dft_pack_format::Perm);
+    fft_multiply(premul, ir_segments[0], segments[position], dft_pack_format::Perm);
+    for (size_t i = 1; i < segments.size(); i++)
+    {
+        const size_t n = (position + i) % segments.size();
+        fft_multiply_accumulate(premul, ir_segments[i], segments[n], dft_pack_format::Perm);
+    }
+    fft->execute(output.data(), premul.data(), temp.data(), dft_pack_format::Perm);
+    position = position > 0 ? position - 1 : segments.size() - 1;
+}
+
+// Each background stage has a job state, changed only with the mutex held, so that a queued job always
+// wakes the worker. It is atomic so that the audio thread can see an idle job without the mutex
+template <typename T>
+struct convolve_worker
+{
+    enum : int
+    {
+        idle,
+        queued,
+        running
+    };
+
+    explicit convolve_worker(size_t stages) : states(stages), deadlines(stages, 0), stop(false)
+    {
+        for (std::atomic<int>& state : states)
+            state.store(idle, std::memory_order_relaxed);
+    }
+
+#ifndef KFR_SINGLE_THREAD
+    // Runs the job of the stage, the lock is released while it runs
+    void run(convolve_stage<T>& stage, size_t index, std::unique_lock<std::mutex>& lock)
+    {
+        states[index].store(running, std::memory_order_relaxed);
+        lock.unlock();
+        stage.process(stage.frame.data());
+        lock.lock();
+        states[index].store(idle, std::memory_order_release);
+        job_done.notify_all();
+    }
+#endif
+
+    std::vector<std::atomic<int>> states;
+    std::vector<size_t> deadlines;
+    bool stop;
+#ifndef KFR_SINGLE_THREAD
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable job_ready;
+    std::condition_variable job_done;
+#endif
+};
+} // namespace internal
+
+template <typename T>
+nonuniform_convolve_filter<T>::nonuniform_convolve_filter(const univector<T>& data, size_t block_size,
+                                                          size_t max_block_size, bool background)
+    : block_size(next_poweroftwo(block_size)), input_fifo(next_poweroftwo(block_size), 0),
+      output_fifo(next_poweroftwo(block_size), 0), fifo_position(0), accumulator_position(0),
+      block_count(0), late_count(0)
+{
+#ifdef KFR_SINGLE_THREAD
+    background = false;
+#endif
+    max_block_size   = std::max(next_poweroftwo(max_block_size), this->block_size);
+    size_t partition = this->block_size;
+    size_t offset    = 0;
+    while (offset < data.size())
+    {
+        // The first stage has 3 partitions and the following ones have 2 partitions of double size,
+        // so each stage starts at 2 * partition - block_size and its result is needed
+        // one partition period after its input is complete
+        size_t end = partition == max_block_size ? data.size() : offset == 0 ? 3 * partition
+                                                                              : offset + 2 * partition;
+        end = std::min(end, data.size());
+
+        stages.emplace_back();
+        internal::convolve_stage<T>& stage = stages.back();
+        stage.partition      = partition;
+        stage.offset         = offset;
+        stage.background     = background && offset != 0;
+        stage.fft            = dft_cache::instance().getreal(ctype_t<T>(), partition * 2);
+        stage.position       = 0;
+        stage.input_position = 0;
+        stage.temp.resize(stage.fft->temp_size);
+        stage.input.resize(partition * 2, 0);
+        stage.frame.resize(stage.background ? partition * 2 : 0, 0);
+        stage.premul.resize(partition, 0);
+        stage.output.resize(partition * 2, 0);
+
+        const size_t count = (end - offset + partition - 1) / partition;
+        stage.segments.resize(count);
+        stage.ir_segments.resize(count);
+        univector<T> input(partition * 2);
+        const T ifftsize = reciprocal(T(partition * 2));
+        for (size_t i = 0; i < count; i++)
+        {
+            stage.segments[i].resize(partition, 0);
+            stage.ir_segments[i].resize(partition, 0);
+            input = padded(data.slice(offset + i * partition, partition));
+
+            stage.fft->execute(stage.ir_segments[i], input, stage.temp, dft_pack_format::Perm);
+            process(stage.ir_segments[i], stage.ir_segments[i] * ifftsize);
+        }
+
+        offset    = end;
+        partition = std::min(partition * 2, max_block_size);
+    }
+    accumulator.resize(stages.empty() ? this->block_size : stages.back().partition * 2, 0);
 
-            internal::builtin_memcpy(overlap.data(), scratch.data() + block_size, block_size * sizeof(T));
+#ifndef KFR_SINGLE_THREAD
+    if (std::any_of(stages.begin(), stages.end(),
+                    [](const internal::convolve_stage<T>& stage) { return stage.background; }))
+    {
+        worker.reset(new internal::convolve_worker<T>(stages.size()));
+        worker->thread = std::thread([this]() { worker_loop(); });
+    }
+#endif
+}
 
-            position = position > 0 ? position - 1 : segments.size() - 1;
+template <typename T>
+nonuniform_convolve_filter<T>::~nonuniform_convolve_filter()
+{
+#ifndef KFR_SINGLE_THREAD
+    if (worker)
+    {
+        {
+            std::lock_guard<std::mutex> lock(worker->mutex);
+            worker->stop = true;
         }
+        worker->job_ready.notify_all();
+        worker->thread.join();
+    }
+#endif
+}
+
+template <typename T>
+void nonuniform_convolve_filter<T>::reset()
+{
+    for (size_t i = 0; i < stages.size(); i++)
+    {
+        internal::convolve_stage<T>& stage = stages[i];
+        if (stage.background)
+            finish(i);
+        for (univector<complex<T>>& segment : stage.segments)
+            process(segment, zeros());
+        process(stage.input, zeros());
+        process(stage.output, zeros());
+        stage.position       = 0;
+        stage.input_position = 0;
+    }
+    process(input_fifo, zeros());
+    process(output_fifo, zeros());
+    process(accumulator, zeros());
+    fifo_position        = 0;
+    accumulator_position = 0;
+    block_count          = 0;
+    late_count.store(0, std::memory_order_relaxed);
+}
 
+template <typename T>
+void nonuniform_convolve_filter<T>::process_buffer(T* output, const T* input, size_t size)
+{
+    size_t processed = 0;
+    while (processed < size)
+    {
+        const size_t processing = std::min(size - processed, block_size - fifo_position);
+        internal::builtin_memcpy(input_fifo.data() + fifo_position, input + processed,
+                                 processing * sizeof(T));
+        internal::builtin_memcpy(output + processed, output_fifo.data() + fifo_position,
+                                 processing * sizeof(T));
+        fifo_position += processing;
         processed += processing;
+        if (fifo_position == block_size)
+        {
+            fifo_position = 0;
+            process_block();
+        }
+    }
+}
+
+template <typename T>
+void nonuniform_convolve_filter<T>::process_block()
+{
+    block_count++;
+    for (size_t i = 0; i < stages.size(); i++)
+    {
+        internal::convolve_stage<T>& stage = stages[i];
+        internal::builtin_memcpy(stage.input.data() + stage.partition + stage.input_position,
+                                 input_fifo.data(), block_size * sizeof(T));
+        stage.input_position += block_size;
+        if (stage.input_position < stage.partition)
+            continue;
+        stage.input_position = 0;
+
+        if (stage.background)
+        {
+            // The previous job of this stage is due now
+            finish(i);
+            accumulate(stage.output.data() + stage.partition, stage.offset + block_size - 2 * stage.partition,
+                       stage.partition);
+            internal::builtin_memcpy(stage.frame.data(), stage.input.data(), stage.partition * 2 * sizeof(T));
+#ifndef KFR_SINGLE_THREAD
+            {
+                std::lock_guard<std::mutex> lock(worker->mutex);
+                worker->deadlines[i] = block_count + stage.partition / block_size;
+                worker->states[i].store(internal::convolve_worker<T>::queued, std::memory_order_relaxed);
+            }
+            worker->job_ready.notify_one();
+#endif
+        }
+        else
+        {
+            stage.process(stage.input.data());
+            accumulate(stage.output.data() + stage.partition, stage.offset + block_size - stage.partition,
+                       stage.partition);
+        }
+        internal::builtin_memcpy(stage.input.data(), stage.input.data() + stage.partition,
+                                 stage.partition * sizeof(T));
+    }
+
+    internal::builtin_memcpy(output_fifo.data(), accumulator.data() + accumulator_position,
+                             block_size * sizeof(T));
+    process(make_univector(accumulator.data() + accumulator_position, block_size), zeros());
+    accumulator_position = (accumulator_position + block_size) % accumulator.size();
+}
+
+// A job that is not idle when due is late. It is taken back and run here if the worker has not started it,
+// otherwise this thread sleeps until the worker finishes it
+template <typename T>
+void nonuniform_convolve_filter<T>::finish(size_t stage)
+{
+#ifndef KFR_SINGLE_THREAD
+    internal::convolve_worker<T>& w = *worker;
+    if (w.states[stage].load(std::memory_order_acquire) == internal::convolve_worker<T>::idle)
+        return;
+    late_count.fetch_add(1, std::memory_order_relaxed);
+    std::unique_lock<std::mutex> lock(w.mutex);
+    if (w.states[stage].load(std::memory_order_relaxed) == internal::convolve_worker<T>::queued)
+        w.run(stages[stage], stage, lock);
+    else
+        w.job_done.wait(lock, [&]() {
+            return w.states[stage].load(std::memory_order_relaxed) == internal::convolve_worker<T>::idle;
+        });
+#else
+    (void)stage;
+#endif
+}
+
+template <typename T>
+void nonuniform_convolve_filter<T>::accumulate(const T* data, size_t offset, size_t size)
+{
+    const size_t start = (accumulator_position + offset) % accumulator.size();
+    const size_t first = std::min(size, accumulator.size() - start);
+    univector<T, 0> head = make_univector(accumulator.data() + start, first);
+    process(head, head + make_univector(data, first));
+    if (first < size)
+    {
+        univector<T, 0> tail = make_univector(accumulator.data(), size - first);
+        process(tail, tail + make_univector(data + first, size - first));
+    }
+}
+
+template <typename T>
+void nonuniform_convolve_filter<T>::worker_loop()
+{
+#ifndef KFR_SINGLE_THREAD
+    internal::convolve_worker<T>& w = *worker;
+    std::unique_lock<std::mutex> lock(w.mutex);
+    for (;;)
+    {
+        // Earliest deadline first
+        size_t next = stages.size();
+        for (size_t i = 0; i < stages.size(); i++)
+            if (w.states[i].load(std::memory_order_relaxed) == internal::convolve_worker<T>::queued &&
+                (next == stages.size() || w.deadlines[i] < w.deadlines[next]))
+                next = i;
+        if (next < stages.size())
+            w.run(stages[next], next, lock);
+        else if (w.stop)
+            return;
+        else
+            w.job_ready.wait(lock);
     }
+#endif
 }
 
-template convolve_filter<float>::convolve_filter(size_t, size_t);
-template convolve_filter<double>::convolve_filter(size_t, size_t);
+template convolve_filter<float>::convolve_filter(size_t, size_t, bool);
+template convolve_filter<double>::convolve_filter(size_t, size_t, bool);
 
-template convolve_filter<float>::convolve_filter(const univector<float>&, size_t);
-template convolve_filter<double>::convolve_filter(const univector<double>&, size_t);
+template convolve_filter<float>::convolve_filter(const univector<float>&, size_t, bool);
+template convolve_filter<double>::convolve_filter(const univector<double>&, size_t, bool);
 
 template void convolve_filter<float>::set_data(const univector<float>&);
 template void convolve_filter<double>::set_data(const univector<double>&);
 
+template bool convolve_filter<float>::prepare_data(const univector<float>&);
+template bool convolve_filter<double>::prepare_data(const univector<double>&);
+
 template void convolve_filter<float>::process_buffer(float* output, const float* input, size_t size);
 template void convolve_filter<double>::process_buffer(double* output, const double* input, size_t size);
 
-template dft_plan<float>::dft_plan(size_t, cbools_t<false, true>);
-template dft_plan<float>::dft_plan(size_t, cbools_t<true, false>);
-template dft_plan<float>::dft_plan(size_t, cbools_t<true, true>);
+template convolve_matrix<float>::convolve_matrix(const std::vector<std::vector<univector<float>>>&, size_t);
+template convolve_matrix<double>::convolve_matrix(const std::vector<std::vector<univector<double>>>&, size_t);
+template void convolve_matrix<float>::reset();
+template void convolve_matrix<double>::reset();
+template void convolve_matrix<float>::apply(float* const* output, const float* const* input, size_t size);
+template void convolve_matrix<double>::apply(double* const* output, const double* const* input, size_t size);
+
+template partitioned_lms_filter<float>::partitioned_lms_filter(size_t, float, size_t, float);
+template partitioned_lms_filter<double>::partitioned_lms_filter(size_t, double, size_t, double);
+template univector<float> partitioned_lms_filter<float>::taps() const;
+template univector<double> partitioned_lms_filter<double>::taps() const;
+template void partitioned_lms_filter<float>::reset();
+template void partitioned_lms_filter<double>::reset();
+template void partitioned_lms_filter<float>::apply(float* output, float* error, const float* input,
+                                                   const float* desired, size_t size);
+template void partitioned_lms_filter<double>::apply(double* output, double* error, const double* input,
+                                                    const double* desired, size_t size);
+
+template void internal::convolve_stage<float>::process(const float*);
+template void internal::convolve_stage<double>::process(const double*);
+
+template nonuniform_convolve_filter<float>::nonuniform_convolve_filter(const univector<float>&, size_t,
+                                                                       size_t, bool);
+template nonuniform_convolve_filter<double>::nonuniform_convolve_filter(const univector<double>&, size_t,
+                                                                        size_t, bool);
+template nonuniform_convolve_filter<float>::~nonuniform_convolve_filter();
+template nonuniform_convolve_filter<double>::~nonuniform_convolve_filter();
+template void nonuniform_convolve_filter<float>::reset();
+template void nonuniform_convolve_filter<double>::reset();
+template void nonuniform_convolve_filter<float>::process_buffer(float* output, const float* input,
+                                                                size_t size);
+template void nonuniform_convolve_filter<double>::process_buffer(double* output, const double* input,
+                                                                 size_t size);
+
+template dft_plan<float>::dft_plan(size_t, cbools_t<false, true>, size_t, dft_data_reader*);
+template dft_plan<float>::dft_plan(size_t, cbools_t<true, false>, size_t, dft_data_reader*);
+template dft_plan<float>::dft_plan(size_t, cbools_t<true, true>, size_t, dft_data_reader*);
 template dft_plan<float>::~dft_plan();
+template void dft_plan<float>::save_data(std::vector<kfr::u8>&) const;
+template void dft_plan<float>::execute(float* out_re, float* out_im, const float* in_re, const float* in_im,
+                                      kfr::u8* temp, bool) const;
+template size_t dft_plan<float>::data_memory() const;
+template void dft_plan<float>::execute_batch(kfr::complex<float>* out, const kfr::complex<float>* in,
+                                             kfr::u8* temp, size_t, size_t, size_t, bool) const;
+template void dft_plan<float>::execute_batch(kfr::complex<float>* const* out,
+                                             const kfr::complex<float>* const* in, kfr::u8* temp, size_t,
+                                             bool) const;
 template void dft_plan<float>::execute_dft(cometa::cbool_t<false>, kfr::complex<float>* out,
                                            const kfr::complex<float>* in, kfr::u8* temp) const;
 template void dft_plan<float>::execute_dft(cometa::cbool_t<true>, kfr::complex<float>* out,
                                            const kfr::complex<float>* in, kfr::u8* temp) const;
-template dft_plan_real<float>::dft_plan_real(size_t, cbools_t<false, true>);
-template dft_plan_real<float>::dft_plan_real(size_t, cbools_t<true, false>);
-template dft_plan_real<float>::dft_plan_real(size_t, cbools_t<true, true>);
+template dft_plan_real<float>::dft_plan_real(size_t, cbools_t<false, true>, size_t, dft_data_reader*);
+template dft_plan_real<float>::dft_plan_real(size_t, cbools_t<true, false>, size_t, dft_data_reader*);
+template dft_plan_real<float>::dft_plan_real(size_t, cbools_t<true, true>, size_t, dft_data_reader*);
 template void dft_plan_real<float>::from_fmt(kfr::complex<float>* out, const kfr::complex<float>* in,
                                              kfr::dft_pack_format fmt) const;
 template void dft_plan_real<float>::to_fmt(kfr::complex<float>* out, kfr::dft_pack_format fmt) const;
-
-template dft_plan<double>::dft_plan(size_t, cbools_t<false, true>);
-template dft_plan<double>::dft_plan(size_t, cbools_t<true, false>);
-template dft_plan<double>::dft_plan(size_t, cbools_t<true, true>);
+template void dft_plan_real<float>::save_data(std::vector<kfr::u8>&) const;
+template size_t dft_plan_real<float>::data_memory() const;
+template dft_plan_md<float>::dft_plan_md(const std::vector<size_t>&);
+template void dft_plan_md<float>::execute(kfr::complex<float>* out, const kfr::complex<float>* in,
+                                          kfr::u8* temp, bool) const;
+template dft_plan_md_real<float>::dft_plan_md_real(const std::vector<size_t>&);
+template void dft_plan_md_real<float>::execute(kfr::complex<float>* out, const float* in,
+                                               kfr::u8* temp) const;
+template void dft_plan_md_real<float>::execute(float* out, const kfr::complex<float>* in,
+                                               kfr::u8* temp) const;
+template void dft_plan_real<float>::execute_batch(kfr::complex<float>* out, const float* in, kfr::u8* temp,
+                                                  size_t, size_t, size_t, kfr::dft_pack_format) const;
+template void dft_plan_real<float>::execute_batch(float* out, const kfr::complex<float>* in, kfr::u8* temp,
+                                                  size_t, size_t, size_t, kfr::dft_pack_format) const;
+template void dft_plan_real<float>::execute_batch(kfr::complex<float>* const* out, const float* const* in,
+                                                  kfr::u8* temp, size_t, kfr::dft_pack_format) const;
+template void dft_plan_real<float>::execute_batch(float* const* out, const kfr::complex<float>* const* in,
+                                                  kfr::u8* temp, size_t, kfr::dft_pack_format) const;
+template dct_plan<float>::dct_plan(size_t, dct_type);
+template void dct_plan<float>::execute_dct(cometa::cbool_t<false>, float* out, const float* in,
+                                           kfr::u8* temp) const;
+template void dct_plan<float>::execute_dct(cometa::cbool_t<true>, float* out, const float* in,
+                                           kfr::u8* temp) const;
+template mdct_plan<float>::mdct_plan(size_t, const univector<float>&);
+template void mdct_plan<float>::execute(float* out, const float* in, kfr::u8* temp) const;
+template void mdct_plan<float>::execute_inverse(float* out, const float* in, kfr::u8* temp) const;
+
+template dft_plan<double>::dft_plan(size_t, cbools_t<false, true>, size_t, dft_data_reader*);
+template dft_plan<double>::dft_plan(size_t, cbools_t<true, false>, size_t, dft_data_reader*);
+template dft_plan<double>::dft_plan(size_t, cbools_t<true, true>, size_t, dft_data_reader*);
 template dft_plan<double>::~dft_plan();
+template void dft_plan<double>::save_data(std::vector<kfr::u8>&) const;
+template void dft_plan<double>::execute(double* out_re, double* out_im, const double* in_re,
+                                        const double* in_im, kfr::u8* temp, bool) const;
+template size_t dft_plan<double>::data_memory() const;
+template void dft_plan<double>::execute_batch(kfr::complex<double>* out, const kfr::complex<double>* in,
+                                              kfr::u8* temp, size_t, size_t, size_t, bool) const;
+template void dft_plan<double>::execute_batch(kfr::complex<double>* const* out,
+                                              const kfr::complex<double>* const* in, kfr::u8* temp, size_t,
+                                              bool) const;
 template void dft_plan<double>::execute_dft(cometa::cbool_t<false>, kfr::complex<double>* out,
                                             const kfr::complex<double>* in, kfr::u8* temp) const;
 template void dft_plan<double>::execute_dft(cometa::cbool_t<true>, kfr::complex<double>* out,
                                             const kfr::complex<double>* in, kfr::u8* temp) const;
-template dft_plan_real<double>::dft_plan_real(size_t, cbools_t<false, true>);
-template dft_plan_real<double>::dft_plan_real(size_t, cbools_t<true, false>);
-template dft_plan_real<double>::dft_plan_real(size_t, cbools_t<true, true>);
+template dft_plan_real<double>::dft_plan_real(size_t, cbools_t<false, true>, size_t, dft_data_reader*);
+template dft_plan_real<double>::dft_plan_real(size_t, cbools_t<true, false>, size_t, dft_data_reader*);
+template dft_plan_real<double>::dft_plan_real(size_t, cbools_t<true, true>, size_t, dft_data_reader*);
 template void dft_plan_real<double>::from_fmt(kfr::complex<double>* out, const kfr::complex<double>* in,
                                               kfr::dft_pack_format fmt) const;
 template void dft_plan_real<double>::to_fmt(kfr::complex<double>* out, kfr::dft_pack_format fmt) const;
+template void dft_plan_real<double>::save_data(std::vector<kfr::u8>&) const;
+template size_t dft_plan_real<double>::data_memory() const;
+template dft_plan_md<double>::dft_plan_md(const std::vector<size_t>&);
+template void dft_plan_md<double>::execute(kfr::complex<double>* out, const kfr::complex<double>* in,
+                                           kfr::u8* temp, bool) const;
+template dft_plan_md_real<double>::dft_plan_md_real(const std::vector<size_t>&);
+template void dft_plan_md_real<double>::execute(kfr::complex<double>* out, const double* in,
+                                                kfr::u8* temp) const;
+template void dft_plan_md_real<double>::execute(double* out, const kfr::complex<double>* in,
+                                                kfr::u8* temp) const;
+template void dft_plan_real<double>::execute_batch(kfr::complex<double>* out, const double* in, kfr::u8* temp,
+                                                   size_t, size_t, size_t, kfr::dft_pack_format) const;
+template void dft_plan_real<double>::execute_batch(double* out, const kfr::complex<double>* in, kfr::u8* temp,
+                                                   size_t, size_t, size_t, kfr::dft_pack_format) const;
+template void dft_plan_real<double>::execute_batch(kfr::complex<double>* const* out, const double* const* in,
+                                                   kfr::u8* temp, size_t, kfr::dft_pack_format) const;
+template void dft_plan_real<double>::execute_batch(double* const* out, const kfr::complex<double>* const* in,
+                                                   kfr::u8* temp, size_t, kfr::dft_pack_format) const;
+template dct_plan<double>::dct_plan(size_t, dct_type);
+template void dct_plan<double>::execute_dct(cometa::cbool_t<false>, double* out, const double* in,
+                                            kfr::u8* temp) const;
+template void dct_plan<double>::execute_dct(cometa::cbool_t<true>, double* out, const double* in,
+                                            kfr::u8* temp) const;
+template mdct_plan<double>::mdct_plan(size_t, const univector<double>&);
+template void mdct_plan<double>::execute(double* out, const double* in, kfr::u8* temp) const;
+template void mdct_plan<double>::execute_inverse(double* out, const double* in, kfr::u8* temp) const;
 
 } // namespace kfr
 
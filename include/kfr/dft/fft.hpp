@@ -31,6 +31,8 @@
 #include "../base/read_write.hpp"
 #include "../base/small_buffer.hpp"
 #include "../base/vec.hpp"
+#include <memory>
+#include <vector>
 
 CMT_PRAGMA_GNU(GCC diagnostic push)
 #if CMT_HAS_WARNING("-Wshadow")
@@ -56,6 +58,38 @@ constexpr cbools_t<false, true> inverse{};
 template <typename T>
 struct dft_stage;
 
+// Plan data blocks in a serialized blob are padded to this size
+constexpr size_t dft_data_alignment = 64;
+
+// Reads precomputed plan data written by dft_plan::save_data
+struct dft_data_reader
+{
+    dft_data_reader(const u8* data, size_t size, std::shared_ptr<const void> owner = nullptr)
+        : ptr(data), end(data + size), owner(std::move(owner)), failed(false)
+    {
+    }
+
+    // Returns the next block or nullptr if there is not enough data left
+    const u8* read(size_t size)
+    {
+        const size_t padded = align_up(size, dft_data_alignment);
+        if (failed || static_cast<size_t>(end - ptr) < padded)
+        {
+            failed = true;
+            return nullptr;
+        }
+        const u8* result = ptr;
+        ptr += padded;
+        return result;
+    }
+
+    const u8* ptr;
+    const u8* end;
+    // If set, plans use the data in place and keep the owner alive instead of copying the data
+    std::shared_ptr<const void> owner;
+    bool failed;
+};
+
 template <typename T>
 struct dft_plan
 {
@@ -64,8 +98,12 @@ struct dft_plan
     size_t size;
     size_t temp_size;
 
+    // threads is the number of worker threads used by very large power-of-two transforms,
+    // 0 means one thread per hardware core
+    // If reader is not null, precomputed data is taken from it instead of being calculated
     template <bool direct = true, bool inverse = true>
-    dft_plan(size_t size, cbools_t<direct, inverse> type = dft_type::both);
+    dft_plan(size_t size, cbools_t<direct, inverse> type = dft_type::both, size_t threads = 1,
+             dft_data_reader* reader = nullptr);
 
     KFR_INTRIN void execute(complex<T>* out, const complex<T>* in, u8* temp, bool inverse = false) const
     {
@@ -97,25 +135,69 @@ struct dft_plan
         execute_dft(inv, out.data(), in.data(), temp.data());
     }
 
+    // Executes the transform on split-format data, real and imaginary parts are in separate arrays.
+    // The first stage of power-of-two plans of 512 points and more and of mixed-radix plans of more than
+    // one stage reads the split input, the last stage of power-of-two plans of 512 points and more and of
+    // mixed-radix plans writes the split output. Otherwise the data is converted in a separate pass.
+    // temp must be at least split_temp_size bytes
+    void execute(T* out_re, T* out_im, const T* in_re, const T* in_im, u8* temp, bool inverse = false) const;
+    template <size_t Tag1, size_t Tag2, size_t Tag3, size_t Tag4, size_t Tag5>
+    KFR_INTRIN void execute(univector<T, Tag1>& out_re, univector<T, Tag2>& out_im,
+                            const univector<T, Tag3>& in_re, const univector<T, Tag4>& in_im,
+                            univector<u8, Tag5>& temp, bool inverse = false) const
+    {
+        execute(out_re.data(), out_im.data(), in_re.data(), in_im.data(), temp.data(), inverse);
+    }
+
+    // Size of the temporary buffer required by execute_batch, not less than temp_size
+    size_t batch_temp_size;
+    // Size of the temporary buffer required by the split-format execute
+    size_t split_temp_size;
+
+    // Appends the precomputed data of the plan and its nested plans to blob
+    void save_data(std::vector<u8>& blob) const;
+    // Size of the precomputed data of the plan and its nested plans in bytes
+    size_t data_memory() const;
+
+    // Executes count transforms, the i-th reads in + i * istride and writes out + i * ostride
+    void execute_batch(complex<T>* out, const complex<T>* in, u8* temp, size_t count, size_t ostride,
+                       size_t istride, bool inverse = false) const;
+    // Executes count transforms, the i-th reads in[i] and writes out[i]
+    void execute_batch(complex<T>* const* out, const complex<T>* const* in, u8* temp, size_t count,
+                       bool inverse = false) const;
+
 protected:
     autofree<u8> data;
+    const u8* data_ptr;
+    std::shared_ptr<const void> data_owner;
     size_t data_size;
     std::vector<dft_stage_ptr> stages[2];
+    univector<complex<T>> batch_twiddle;
 
-    template <template <bool inverse> class Stage>
-    void add_stage(size_t stage_size, cbools_t<true, true>);
-    template <template <bool inverse> class Stage>
-    void add_stage(size_t stage_size, cbools_t<true, false>);
-    template <template <bool inverse> class Stage>
-    void add_stage(size_t stage_size, cbools_t<false, true>);
+    template <template <bool inverse> class Stage, typename... Args>
+    void add_stage(cbools_t<true, true>, const Args&... args);
+    template <template <bool inverse> class Stage, typename... Args>
+    void add_stage(cbools_t<true, false>, const Args&... args);
+    template <template <bool inverse> class Stage, typename... Args>
+    void add_stage(cbools_t<false, true>, const Args&... args);
 
     template <bool direct, bool inverse, bool is_even, bool first>
     void make_fft(size_t stage_size, cbools_t<direct, inverse> type, cbool_t<is_even>, cbool_t<first>);
 
     template <bool direct, bool inverse>
-    void initialize(cbools_t<direct, inverse>);
+    void make_dft(size_t size, cbools_t<direct, inverse> type, dft_data_reader* reader);
+
+    template <bool direct, bool inverse>
+    void initialize(cbools_t<direct, inverse>, dft_data_reader* reader);
     template <bool inverse>
     void execute_dft(cbool_t<inverse>, complex<T>* out, const complex<T>* in, u8* temp) const;
+    // If in_re is not null, the first stage reads split-format input from in_re and in_im instead of in.
+    // If out_re is not null, the last stage writes split-format output to out_re and out_im
+    template <bool inverse>
+    void execute_stages(cbool_t<inverse>, complex<T>* out, const complex<T>* in, const T* in_re,
+                        const T* in_im, T* out_re, T* out_im, u8* temp) const;
+    template <bool inverse, typename OutFn, typename InFn>
+    void execute_batch_dft(cbool_t<inverse>, size_t count, OutFn&& out, InFn&& in, u8* temp) const;
 };
 
 enum class dft_pack_format
@@ -129,7 +211,11 @@ struct dft_plan_real : dft_plan<T>
 {
     size_t size;
     template <bool direct = true, bool inverse = true>
-    dft_plan_real(size_t size, cbools_t<direct, inverse> type = dft_type::both);
+    dft_plan_real(size_t size, cbools_t<direct, inverse> type = dft_type::both, size_t threads = 1,
+                  dft_data_reader* reader = nullptr);
+
+    void save_data(std::vector<u8>& blob) const;
+    size_t data_memory() const;
 
     KFR_INTRIN void execute(complex<T>* out, const T* in, u8* temp,
                             dft_pack_format fmt = dft_pack_format::CCs) const
@@ -161,6 +247,17 @@ struct dft_plan_real : dft_plan<T>
         this->execute_dft(ctrue, outdata, outdata, temp.data());
     }
 
+    // Executes count direct transforms, the i-th reads in + i * istride and writes out + i * ostride
+    void execute_batch(complex<T>* out, const T* in, u8* temp, size_t count, size_t ostride, size_t istride,
+                       dft_pack_format fmt = dft_pack_format::CCs) const;
+    // Executes count inverse transforms, the i-th reads in + i * istride and writes out + i * ostride
+    void execute_batch(T* out, const complex<T>* in, u8* temp, size_t count, size_t ostride, size_t istride,
+                       dft_pack_format fmt = dft_pack_format::CCs) const;
+    void execute_batch(complex<T>* const* out, const T* const* in, u8* temp, size_t count,
+                       dft_pack_format fmt = dft_pack_format::CCs) const;
+    void execute_batch(T* const* out, const complex<T>* const* in, u8* temp, size_t count,
+                       dft_pack_format fmt = dft_pack_format::CCs) const;
+
 private:
     univector<complex<T>> rtwiddle;
 
@@ -168,6 +265,65 @@ private:
     void from_fmt(complex<T>* out, const complex<T>* in, dft_pack_format fmt) const;
 };
 
+// Multidimensional complex DFT of a row-major array, the last axis is contiguous.
+// An empty shape or a zero extent gives a plan with an empty shape and size 0 that does nothing
+template <typename T>
+struct dft_plan_md
+{
+    std::vector<size_t> shape;
+    size_t size;
+    size_t temp_size;
+
+    explicit dft_plan_md(const std::vector<size_t>& shape);
+
+    void execute(complex<T>* out, const complex<T>* in, u8* temp, bool inverse = false) const;
+
+    template <size_t Tag1, size_t Tag2, size_t Tag3>
+    KFR_INTRIN void execute(univector<complex<T>, Tag1>& out, const univector<complex<T>, Tag2>& in,
+                            univector<u8, Tag3>& temp, bool inverse = false) const
+    {
+        execute(out.data(), in.data(), temp.data(), inverse);
+    }
+
+private:
+    std::vector<std::shared_ptr<const dft_plan<T>>> plans;
+};
+
+// Multidimensional real DFT of a row-major array.
+// The spectrum has the same shape except for the last axis that holds shape.back() / 2 + 1 values.
+// The last extent must be even, an invalid shape gives a plan with an empty shape and size 0
+// that does nothing
+template <typename T>
+struct dft_plan_md_real
+{
+    std::vector<size_t> shape;
+    size_t size;
+    size_t complex_size;
+    size_t temp_size;
+
+    explicit dft_plan_md_real(const std::vector<size_t>& shape);
+
+    void execute(complex<T>* out, const T* in, u8* temp) const;
+    void execute(T* out, const complex<T>* in, u8* temp) const;
+
+    template <size_t Tag1, size_t Tag2, size_t Tag3>
+    KFR_INTRIN void execute(univector<complex<T>, Tag1>& out, const univector<T, Tag2>& in,
+                            univector<u8, Tag3>& temp) const
+    {
+        execute(out.data(), in.data(), temp.data());
+    }
+    template <size_t Tag1, size_t Tag2, size_t Tag3>
+    KFR_INTRIN void execute(univector<T, Tag1>& out, const univector<complex<T>, Tag2>& in,
+                            univector<u8, Tag3>& temp) const
+    {
+        execute(out.data(), in.data(), temp.data());
+    }
+
+private:
+    std::vector<std::shared_ptr<const dft_plan<T>>> plans;
+    std::shared_ptr<const dft_plan_real<T>> real_plan;
+};
+
 template <typename T, size_t Tag1, size_t Tag2, size_t Tag3>
 void fft_multiply(univector<complex<T>, Tag1>& dest, const univector<complex<T>, Tag2>& src1,
                   const univector<complex<T>, Tag3>& src2, dft_pack_format fmt = dft_pack_format::CCs)
@@ -542,8 +542,10 @@ KFR_INTRIN vec<T, width> cmul_by_twiddle(const vec<T, width>& x)
 template <size_t N, typename T>
 KFR_INTRIN void butterfly2(const cvec<T, N>& a0, const cvec<T, N>& a1, cvec<T, N>& w0, cvec<T, N>& w1)
 {
-    w0 = a0 + a1;
-    w1 = a0 - a1;
+    const cvec<T, N> sum = a0 + a1;
+    const cvec<T, N> dif = a0 - a1;
+    w0                   = sum;
+    w1                   = dif;
 }
 
 template <size_t N, typename T>
@@ -1020,8 +1022,8 @@ template <size_t N, bool inverse = false, typename T>
 KFR_INTRIN void butterfly3(const cvec<T, N>& a00, const cvec<T, N>& a01, const cvec<T, N>& a02,
                            cvec<T, N>& w00, cvec<T, N>& w01, cvec<T, N>& w02)
 {
-    constexpr cvec<T, N> tw3r1 = static_cast<T>(-0.5);
-    constexpr cvec<T, N> tw3i1 =
+    const cvec<T, N> tw3r1 = static_cast<T>(-0.5 - 1.0);
+    const cvec<T, N> tw3i1 =
         static_cast<T>(0.86602540378443864676372317075) * twiddleimagmask<T, N, inverse>();
 
     const cvec<T, N> sum1 = a01 + a02;
@@ -1079,14 +1081,14 @@ KFR_INTRIN void butterfly7(const cvec<T, N>& a00, const cvec<T, N>& a01, const c
                            const cvec<T, N>& a06, cvec<T, N>& w00, cvec<T, N>& w01, cvec<T, N>& w02,
                            cvec<T, N>& w03, cvec<T, N>& w04, cvec<T, N>& w05, cvec<T, N>& w06)
 {
-    constexpr cvec<T, N> tw7r1 = static_cast<T>(0.623489801858733530525004884);
-    constexpr cvec<T, N> tw7i1 =
+    const cvec<T, N> tw7r1 = static_cast<T>(0.623489801858733530525004884 - 1.0);
+    const cvec<T, N> tw7i1 =
         static_cast<T>(0.78183148246802980870844452667) * twiddleimagmask<T, N, inverse>();
-    constexpr cvec<T, N> tw7r2 = static_cast<T>(-0.2225209339563144042889025645);
-    constexpr cvec<T, N> tw7i2 =
+    const cvec<T, N> tw7r2 = static_cast<T>(-0.2225209339563144042889025645 - 1.0);
+    const cvec<T, N> tw7i2 =
         static_cast<T>(0.97492791218182360701813168299) * twiddleimagmask<T, N, inverse>();
-    constexpr cvec<T, N> tw7r3 = static_cast<T>(-0.90096886790241912623610231951);
-    constexpr cvec<T, N> tw7i3 =
+    const cvec<T, N> tw7r3 = static_cast<T>(-0.90096886790241912623610231951 - 1.0);
+    const cvec<T, N> tw7i3 =
         static_cast<T>(0.43388373911755812047576833285) * twiddleimagmask<T, N, inverse>();
 
     const cvec<T, N> sum1 = a01 + a06;
@@ -1125,11 +1127,11 @@ KFR_INTRIN void butterfly5(const cvec<T, N>& a00, const cvec<T, N>& a01, const c
                            const cvec<T, N>& a03, const cvec<T, N>& a04, cvec<T, N>& w00, cvec<T, N>& w01,
                            cvec<T, N>& w02, cvec<T, N>& w03, cvec<T, N>& w04)
 {
-    constexpr cvec<T, N> tw5r1 = static_cast<T>(0.30901699437494742410229341718);
-    constexpr cvec<T, N> tw5i1 =
+    const cvec<T, N> tw5r1 = static_cast<T>(0.30901699437494742410229341718 - 1.0);
+    const cvec<T, N> tw5i1 =
         static_cast<T>(0.95105651629515357211643933338) * twiddleimagmask<T, N, inverse>();
-    constexpr cvec<T, N> tw5r2 = static_cast<T>(-0.80901699437494742410229341718);
-    constexpr cvec<T, N> tw5i2 =
+    const cvec<T, N> tw5r2 = static_cast<T>(-0.80901699437494742410229341718 - 1.0);
+    const cvec<T, N> tw5i2 =
         static_cast<T>(0.58778525229247312916870595464) * twiddleimagmask<T, N, inverse>();
 
     const cvec<T, N> sum1 = a01 + a04;
@@ -1262,12 +1264,12 @@ KFR_INTRIN void cread_transposed(cbool_t<transposed>, const complex<T>* ptr, vec
     split(temp, w...);
 }
 
-// Warning: Reads past the end. Use with care
 KFR_INTRIN void cread_transposed(cbool_t<true>, const complex<f32>* ptr, cvec<f32, 4>& w0, cvec<f32, 4>& w1,
                                  cvec<f32, 4>& w2)
 {
     cvec<f32, 4> w3;
-    cvec<f32, 16> v16 = concat(cread<4>(ptr), cread<4>(ptr + 3), cread<4>(ptr + 6), cread<4>(ptr + 9));
+    cvec<f32, 16> v16 = concat(cread<4>(ptr), cread<4>(ptr + 3), cread<4>(ptr + 6),
+                               concat(cread<3>(ptr + 9), cvec<f32, 1>()));
     v16 = digitreverse4<2>(v16);
     split(v16, w0, w1, w2, w3);
 }
@@ -1318,6 +1320,25 @@ KFR_INTRIN void butterfly_helper(csizes_t<I...>, size_t i, csize_t<width>, csize
         0)... };
 }
 
+// Non-final, reads split-format input
+template <typename T, size_t width, size_t radix, bool inverse, size_t... I>
+KFR_INTRIN void butterfly_helper(csizes_t<I...>, size_t i, csize_t<width>, csize_t<radix>, cbool_t<inverse>,
+                                 complex<T>* out, const T* in_re, const T* in_im, const complex<T>* tw,
+                                 size_t stride)
+{
+    carray<cvec<T, width>, radix> inout;
+
+    swallow{ (inout.get(csize_t<I>()) = interleavehalfs(
+                  concat(read<width>(in_re + i + stride * I), read<width>(in_im + i + stride * I))))... };
+
+    butterfly(cbool_t<inverse>(), inout.template get<I>()..., inout.template get<I>()...);
+
+    swallow{ (
+        cwrite<width>(out + i + stride * I,
+                      mul_tw<I, radix>(cbool_t<inverse>(), inout.template get<I>(), tw + i * (radix - 1))),
+        0)... };
+}
+
 // Final
 template <typename T, size_t width, size_t radix, bool inverse, size_t... I>
 KFR_INTRIN void butterfly_helper(csizes_t<I...>, size_t i, csize_t<width>, csize_t<radix>, cbool_t<inverse>,
@@ -1360,6 +1381,17 @@ KFR_INTRIN void butterflies(size_t count, csize_t<width>, Args&&... args)
     butterfly_cycle(i, count, csize_t<width>(), std::forward<Args>(args)...);
 }
 
+template <typename T>
+KFR_INTRIN vec<T, 2> hcadd(const vec<T, 2>& value)
+{
+    return value;
+}
+template <typename T, size_t N, KFR_ENABLE_IF(N > 2)>
+KFR_INTRIN vec<T, 2> hcadd(const vec<T, N>& value)
+{
+    return hcadd(low(value) + high(value));
+}
+
 template <typename T, bool inverse, typename Tstride>
 KFR_INTRIN void generic_butterfly_cycle(csize_t<0>, size_t, cbool_t<inverse>, complex<T>*, const complex<T>*,
                                         Tstride, size_t, size_t, const complex<T>*, size_t)
@@ -1384,7 +1416,7 @@ KFR_INTRIN void generic_butterfly_cycle(csize_t<width>, size_t radix, cbool_t<in
             const cvec<T, 1> inb = cread<1>(in + radix - (j + 1));
             cvec<T, width> tw    = cread<width>(twiddle);
             if (inverse)
-                tw = cconj(tw);
+                tw = negodd(tw);
 
             cmul_2conj(sum0, sum1, ina, inb, tw);
             twiddle += halfradix;
@@ -24,13 +24,16 @@
 
 #include "base.hpp"
 
+#include "dsp/adaptive.hpp"
 #include "dsp/biquad.hpp"
 #include "dsp/biquad_design.hpp"
+#include "dsp/cic.hpp"
 #include "dsp/dcremove.hpp"
 #include "dsp/delay.hpp"
 #include "dsp/ebu.hpp"
 #include "dsp/fir.hpp"
 #include "dsp/fir_design.hpp"
+#include "dsp/fixed_point.hpp"
 #include "dsp/fracdelay.hpp"
 #include "dsp/goertzel.hpp"
 #include "dsp/interpolation.hpp"
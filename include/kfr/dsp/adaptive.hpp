@@ -0,0 +1,288 @@
+/** @addtogroup dsp
+ *  @{
+ */
+/*
+  Copyright (C) 2016 D Levin (https://www.kfrlib.com)
+  This file is part of KFR
+
+  KFR is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  KFR is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with KFR.
+
+  If GPL is not suitable for your project, you must purchase a commercial license to use KFR.
+  Buying a commercial license is mandatory as soon as you develop commercial activities without
+  disclosing the source code of your own applications.
+  See https://www.kfrlib.com for details.
+ */
+#pragma once
+
+#include "../base/basic_expressions.hpp"
+#include "../base/horizontal.hpp"
+#include "../base/reduce.hpp"
+#include "../base/univector.hpp"
+#include "../base/vec.hpp"
+
+namespace kfr
+{
+
+namespace internal
+{
+// Returns the sum of w[k] * x[k]
+template <typename T>
+T adaptive_filter_pass(const T* w, const T* x, size_t size)
+{
+    constexpr size_t width = platform<T>::vector_width * 2;
+    vec<T, width> acc      = T(0);
+    size_t k               = 0;
+    for (; k + width <= size; k += width)
+        acc = fmadd(read<width>(w + k), read<width>(x + k), acc);
+    T result = hadd(acc);
+    for (; k < size; k++)
+        result += w[k] * x[k];
+    return result;
+}
+
+// w[k] += step * x[k]
+template <typename T>
+void adaptive_update_pass(T* w, const T* x, size_t size, T step)
+{
+    constexpr size_t width = platform<T>::vector_width * 2;
+    size_t k               = 0;
+    for (; k + width <= size; k += width)
+        write(w + k, fmadd(read<width>(x + k), step, read<width>(w + k)));
+    for (; k < size; k++)
+        w[k] += step * x[k];
+}
+
+// Updates the taps with the previous window xa and filters the next window xb with the updated taps
+// in the same pass, so the taps are loaded and stored once per sample. Returns the sum of w[k] * xb[k]
+template <typename T>
+T adaptive_update_filter_pass(T* w, const T* xa, const T* xb, size_t size, T step)
+{
+    constexpr size_t width = platform<T>::vector_width * 2;
+    vec<T, width> acc      = T(0);
+    size_t k               = 0;
+    for (; k + width <= size; k += width)
+    {
+        const vec<T, width> wk = fmadd(read<width>(xa + k), step, read<width>(w + k));
+        write(w + k, wk);
+        acc = fmadd(wk, read<width>(xb + k), acc);
+    }
+    T result = hadd(acc);
+    for (; k < size; k++)
+    {
+        w[k] += step * xa[k];
+        result += w[k] * xb[k];
+    }
+    return result;
+}
+
+// Taps and delay line shared by the LMS filters. The delay line is mirrored with one spare slot,
+// so the windows of the current and of the next sample are both contiguous and writing the next sample
+// does not overwrite the current window. The taps are stored in the order of the window, oldest first
+template <typename T>
+struct adaptive_state
+{
+    explicit adaptive_state(size_t tapcount)
+        : tapcount(tapcount), capacity(tapcount + 1), weights(tapcount), delayline(capacity * 2)
+    {
+        reset();
+    }
+
+    void reset()
+    {
+        std::fill(weights.begin(), weights.end(), T(0));
+        std::fill(delayline.begin(), delayline.end(), T(0));
+        cursor = 0;
+    }
+
+    void push(T x)
+    {
+        cursor = cursor + 1 == capacity ? 0 : cursor + 1;
+        delayline[cursor]            = x;
+        delayline[cursor + capacity] = x;
+    }
+
+    // Window ending with the most recent sample
+    const T* window() const { return delayline.data() + cursor + capacity - (tapcount - 1); }
+
+    univector<T> taps() const
+    {
+        univector<T> result(tapcount);
+        for (size_t i = 0; i < tapcount; i++)
+            result[i] = weights[tapcount - 1 - i];
+        return result;
+    }
+
+    const size_t tapcount;
+    const size_t capacity;
+    univector<T> weights;
+    univector<T> delayline;
+    size_t cursor;
+};
+
+template <typename T, bool Normalized>
+class lms_filter_base
+{
+public:
+    lms_filter_base(size_t tapcount, T step, T regularization)
+        : step(step), regularization(regularization), state(tapcount)
+    {
+    }
+
+    size_t tapcount() const { return state.tapcount; }
+
+    /// @brief Current coefficients, the first one applies to the most recent input sample
+    univector<T> taps() const { return state.taps(); }
+
+    void reset() { state.reset(); }
+
+    /// @brief Filters size samples of input and adapts the coefficients towards desired after each sample.
+    /// Writes the estimate of desired to output and the difference desired - estimate to error,
+    /// either of them may be nullptr
+    void apply(T* output, T* error, const T* input, const T* desired, size_t size)
+    {
+        if (size == 0)
+            return;
+        const size_t n = state.tapcount;
+        state.push(input[0]);
+        T power = Normalized ? adaptive_filter_pass(state.window(), state.window(), n) : T(0);
+        T y     = adaptive_filter_pass(state.weights.data(), state.window(), n);
+        for (size_t i = 0; i < size; i++)
+        {
+            const T e = desired[i] - y;
+            if (output)
+                output[i] = y;
+            if (error)
+                error[i] = e;
+            const T mu  = Normalized ? step / (regularization + power) : step;
+            const T* xa = state.window();
+            if (i + 1 == size)
+            {
+                // The next sample is not available yet, it is filtered at the start of the next call
+                adaptive_update_pass(state.weights.data(), xa, n, mu * e);
+                break;
+            }
+            const T oldest = xa[0];
+            state.push(input[i + 1]);
+            if (Normalized)
+                power = std::max(T(0), power + input[i + 1] * input[i + 1] - oldest * oldest);
+            y = adaptive_update_filter_pass(state.weights.data(), xa, state.window(), n, mu * e);
+        }
+    }
+
+protected:
+    const T step;
+    const T regularization;
+    adaptive_state<T> state;
+};
+} // namespace internal
+
+/**
+ * @brief Least mean squares adaptive FIR filter. Each sample updates the coefficients by
+ * step * error * input window, the update and the filtering of the next sample share one pass over the taps
+ */
+template <typename T>
+class lms_filter : public internal::lms_filter_base<T, false>
+{
+public:
+    lms_filter(size_t tapcount, T step) : internal::lms_filter_base<T, false>(tapcount, step, T(0)) {}
+};
+
+/**
+ * @brief Normalized least mean squares adaptive FIR filter. The step is divided by the energy of the input
+ * window plus regularization, so convergence does not depend on the input level and is stable for steps
+ * between 0 and 2. The energy is tracked incrementally and recomputed once per call of apply
+ */
+template <typename T>
+class nlms_filter : public internal::lms_filter_base<T, true>
+{
+public:
+    nlms_filter(size_t tapcount, T step, T regularization = T(1e-6))
+        : internal::lms_filter_base<T, true>(tapcount, step, regularization)
+    {
+    }
+};
+
+/**
+ * @brief Exponentially weighted recursive least squares adaptive FIR filter. Converges in a few times
+ * tapcount samples regardless of the input spectrum, but costs O(tapcount^2) per sample, so it suits
+ * short filters. The inverse correlation matrix starts as identity / regularization and is updated
+ * with the forgetting factor 0 < forgetting <= 1. Prefer double for more than a few dozen taps
+ */
+template <typename T>
+class rls_filter
+{
+public:
+    rls_filter(size_t tapcount, T forgetting = T(0.999), T regularization = T(0.01))
+        : forgetting(forgetting), regularization(regularization), state(tapcount),
+          inverse_corr(tapcount * tapcount), gain(tapcount), px(tapcount)
+    {
+        reset();
+    }
+
+    size_t tapcount() const { return state.tapcount; }
+
+    /// @brief Current coefficients, the first one applies to the most recent input sample
+    univector<T> taps() const { return state.taps(); }
+
+    void reset()
+    {
+        state.reset();
+        const size_t n = state.tapcount;
+        std::fill(inverse_corr.begin(), inverse_corr.end(), T(0));
+        for (size_t i = 0; i < n; i++)
+            inverse_corr[i * n + i] = reciprocal(regularization);
+    }
+
+    /// @brief Filters size samples of input and adapts the coefficients towards desired after each sample.
+    /// Writes the estimate of desired to output and the difference desired - estimate to error,
+    /// either of them may be nullptr
+    void apply(T* output, T* error, const T* input, const T* desired, size_t size)
+    {
+        const size_t n    = state.tapcount;
+        const T invlambda = reciprocal(forgetting);
+        for (size_t i = 0; i < size; i++)
+        {
+            state.push(input[i]);
+            const T* x = state.window();
+            // The matrix is symmetric, so P * x is also the transpose of x' * P
+            for (size_t r = 0; r < n; r++)
+                px[r] = internal::adaptive_filter_pass(inverse_corr.data() + r * n, x, n);
+            const T denom = forgetting + internal::adaptive_filter_pass(x, px.data(), n);
+            gain          = px * reciprocal(denom);
+
+            const T y = internal::adaptive_filter_pass(state.weights.data(), x, n);
+            const T e = desired[i] - y;
+            if (output)
+                output[i] = y;
+            if (error)
+                error[i] = e;
+            internal::adaptive_update_pass(state.weights.data(), gain.data(), n, e);
+
+            for (size_t r = 0; r < n; r++)
+            {
+                univector_ref<T> row = make_univector(inverse_corr.data() + r * n, n);
+                row                  = (row - px * gain[r]) * invlambda;
+            }
+        }
+    }
+
+protected:
+    const T forgetting;
+    const T regularization;
+    internal::adaptive_state<T> state;
+    univector<T> inverse_corr;
+    univector<T> gain;
+    univector<T> px;
+};
+} // namespace kfr
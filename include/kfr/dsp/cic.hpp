@@ -0,0 +1,346 @@
+/** @addtogroup dsp
+ *  @{
+ */
+/*
+  Copyright (C) 2016 D Levin (https://www.kfrlib.com)
+  This file is part of KFR
+
+  KFR is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  KFR is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with KFR.
+
+  If GPL is not suitable for your project, you must purchase a commercial license to use KFR.
+  Buying a commercial license is mandatory as soon as you develop commercial activities without
+  disclosing the source code of your own applications.
+  See https://www.kfrlib.com for details.
+ */
+#pragma once
+
+#include "../base/basic_expressions.hpp"
+#include "../base/filter.hpp"
+#include "../base/pointer.hpp"
+#include "../base/reduce.hpp"
+#include "../base/univector.hpp"
+#include "../base/vec.hpp"
+#include <cmath>
+
+namespace kfr
+{
+
+namespace internal
+{
+// Integrator and comb sections of a CIC filter for interleaved channels. Arithmetic is done in the unsigned
+// type of the accumulator, the integrators overflow freely and the combs cancel the wraparound as long
+// as the output fits in the accumulator
+template <typename Acc>
+struct cic_state
+{
+    using A = utype<Acc>;
+
+    cic_state(size_t order, size_t differential_delay, size_t channels)
+        : order(order), delay(differential_delay), channels(channels), integrators(order * channels),
+          combs(differential_delay * order * channels)
+    {
+        reset();
+    }
+
+    void reset()
+    {
+        std::fill(integrators.begin(), integrators.end(), A(0));
+        std::fill(combs.begin(), combs.end(), A(0));
+        comb_cursor = 0;
+    }
+
+    // Runs one frame through all integrators, x is replaced with the output
+    void integrate(A* x)
+    {
+        constexpr size_t width = platform<A>::vector_width;
+        block_process(channels, csizes_t<width, 1>(), [&](size_t c, auto w) {
+            constexpr size_t width = val_of(decltype(w)());
+            vec<A, width> y        = read<width>(x + c);
+            for (size_t s = 0; s < order; s++)
+            {
+                A* acc = integrators.data() + s * channels + c;
+                y      = read<width>(acc) + y;
+                write(acc, y);
+            }
+            write(x + c, y);
+        });
+    }
+
+    // Runs one frame through all combs, x is replaced with the output
+    void comb(A* x)
+    {
+        constexpr size_t width = platform<A>::vector_width;
+        A* delayed             = combs.data() + comb_cursor * order * channels;
+        block_process(channels, csizes_t<width, 1>(), [&](size_t c, auto w) {
+            constexpr size_t width = val_of(decltype(w)());
+            vec<A, width> y        = read<width>(x + c);
+            for (size_t s = 0; s < order; s++)
+            {
+                A* d                       = delayed + s * channels + c;
+                const vec<A, width> oldest = read<width>(d);
+                write(d, y);
+                y = y - oldest;
+            }
+            write(x + c, y);
+        });
+        if (++comb_cursor == delay)
+            comb_cursor = 0;
+    }
+
+    const size_t order;
+    const size_t delay;
+    const size_t channels;
+    univector<A> integrators;
+    univector<A> combs;
+    size_t comb_cursor;
+};
+} // namespace internal
+
+/**
+ * @brief Cascaded integrator-comb decimator. Filters with order moving sums of factor * differential_delay
+ * samples and keeps every factor-th output starting from the first one, without multiplies. Input and output
+ * are integer samples of channels() interleaved channels, the output is scaled by gain(), Acc must hold
+ * the input scaled by gain(). Integrators wrap around, which does not affect the output
+ */
+template <typename T, typename Acc = i64>
+class cic_decimator
+{
+public:
+    cic_decimator(size_t factor, size_t order, size_t differential_delay = 1, size_t channels = 1)
+        : decimation(factor), state(order, differential_delay, channels), frame(channels)
+    {
+        reset();
+    }
+
+    size_t factor() const { return decimation; }
+    size_t order() const { return state.order; }
+    size_t channels() const { return state.channels; }
+
+    /// @brief DC gain, (factor * differential_delay) ^ order
+    double gain() const { return std::pow(double(decimation * state.delay), double(state.order)); }
+
+    void reset()
+    {
+        state.reset();
+        // The first input frame completes the first output
+        fill = decimation - 1;
+    }
+
+    /// @brief Number of output frames the next call of apply with size input frames will produce
+    size_t output_size(size_t size) const { return (size + fill) / decimation; }
+
+    /// @brief Filters size frames and writes output_size(size) frames to dest, returns the number of frames
+    /// written
+    size_t apply(Acc* dest, const T* src, size_t size)
+    {
+        using A         = utype<Acc>;
+        const size_t ch = channels();
+        size_t written  = 0;
+        A* x            = frame.data();
+        for (size_t i = 0; i < size; i++)
+        {
+            for (size_t c = 0; c < ch; c++)
+                x[c] = static_cast<A>(static_cast<Acc>(src[i * ch + c]));
+            state.integrate(x);
+            if (++fill < decimation)
+                continue;
+            fill = 0;
+            state.comb(x);
+            for (size_t c = 0; c < ch; c++)
+                dest[written * ch + c] = static_cast<Acc>(x[c]);
+            written++;
+        }
+        return written;
+    }
+
+protected:
+    const size_t decimation;
+    internal::cic_state<Acc> state;
+    univector<utype<Acc>> frame;
+    size_t fill;
+};
+
+/**
+ * @brief Cascaded integrator-comb interpolator. Inserts factor - 1 zeros after each input frame and filters
+ * with order moving sums of factor * differential_delay samples, without multiplies. Input and output are
+ * integer samples of channels() interleaved channels, the output is scaled by gain(), Acc must hold the
+ * input scaled by gain()
+ */
+template <typename T, typename Acc = i64>
+class cic_interpolator
+{
+public:
+    cic_interpolator(size_t factor, size_t order, size_t differential_delay = 1, size_t channels = 1)
+        : interpolation(factor), state(order, differential_delay, channels), frame(channels)
+    {
+    }
+
+    size_t factor() const { return interpolation; }
+    size_t order() const { return state.order; }
+    size_t channels() const { return state.channels; }
+
+    /// @brief DC gain, (factor * differential_delay) ^ order / factor
+    double gain() const
+    {
+        return std::pow(double(interpolation * state.delay), double(state.order)) / interpolation;
+    }
+
+    void reset() { state.reset(); }
+
+    /// @brief Filters size frames and writes size * factor() frames to dest, returns the number of frames
+    /// written
+    size_t apply(Acc* dest, const T* src, size_t size)
+    {
+        using A         = utype<Acc>;
+        const size_t ch = channels();
+        A* x            = frame.data();
+        for (size_t i = 0; i < size; i++)
+        {
+            for (size_t c = 0; c < ch; c++)
+                x[c] = static_cast<A>(static_cast<Acc>(src[i * ch + c]));
+            state.comb(x);
+            for (size_t r = 0; r < interpolation; r++)
+            {
+                state.integrate(x);
+                Acc* out = dest + (i * interpolation + r) * ch;
+                for (size_t c = 0; c < ch; c++)
+                {
+                    out[c] = static_cast<Acc>(x[c]);
+                    x[c]   = A(0);
+                }
+            }
+        }
+        return size * interpolation;
+    }
+
+protected:
+    const size_t interpolation;
+    internal::cic_state<Acc> state;
+    univector<utype<Acc>> frame;
+};
+
+/**
+ * @brief Cascaded integrator-comb filter without rate change, order moving sums of length samples.
+ * Implements the filter<T> interface, so it chains with the other filters. cic_decimator is this filter
+ * with length = factor * differential_delay keeping every factor-th output, cic_interpolator is this filter
+ * applied to the input with factor - 1 zeros inserted after each sample. The output is scaled by gain(),
+ * T must be an integer type that holds the input scaled by gain()
+ */
+template <typename T>
+class cic_filter : public filter<T>
+{
+public:
+    static_assert(std::is_integral<T>::value, "cic_filter requires an integer type");
+
+    cic_filter(size_t length, size_t order) : state(order, length, 1) {}
+
+    size_t length() const { return state.delay; }
+    size_t order() const { return state.order; }
+
+    /// @brief DC gain, length ^ order
+    double gain() const { return std::pow(double(state.delay), double(state.order)); }
+
+    void reset() final { state.reset(); }
+
+protected:
+    void process_buffer(T* dest, const T* src, size_t size) final
+    {
+        using A = utype<T>;
+        for (size_t i = 0; i < size; i++)
+        {
+            A x = static_cast<A>(src[i]);
+            state.integrate(&x);
+            state.comb(&x);
+            dest[i] = static_cast<T>(x);
+        }
+    }
+    void process_expression(T* dest, const expression_pointer<T>& src, size_t size) final
+    {
+        constexpr size_t block_size = 256;
+        T input[block_size];
+        for (size_t offset = 0; offset < size; offset += block_size)
+        {
+            const size_t block           = std::min(block_size, size - offset);
+            make_univector(input, block) = slice(src, offset, block);
+            process_buffer(dest + offset, input, block);
+        }
+    }
+
+    internal::cic_state<T> state;
+};
+
+namespace intrinsics
+{
+template <typename T>
+void cic_compensation(univector_ref<T> taps, size_t order, size_t factor, size_t differential_delay,
+                      T cutoff, const expression_pointer<T>& window)
+{
+    // The desired response is the inverse of the normalized CIC response up to cutoff and zero above it,
+    // the taps are its inverse transform integrated on a dense grid
+    const size_t size   = taps.size();
+    const size_t grid   = size * 16;
+    const double center = (size - 1) * 0.5;
+    const double df     = double(cutoff) / grid;
+    const double rm     = double(factor * differential_delay);
+    for (size_t n = 0; n < size; n++)
+        taps[n] = T(0);
+    for (size_t g = 0; g < grid; g++)
+    {
+        const double f    = (g + 0.5) * df;
+        const double x    = c_pi<double> * f;
+        const double cic  = std::pow(std::abs(std::sin(x * differential_delay) / (rm * std::sin(x / factor))),
+                                    double(order));
+        const double gain = 2 * df / cic;
+        for (size_t n = 0; n < size; n++)
+            taps[n] += T(gain * std::cos(c_pi<double, 2> * f * (n - center)));
+    }
+    taps = taps * window;
+    // Rounding makes the response slightly asymmetric, keep it exact for the symmetric FIR kernel
+    for (size_t n = 0; n < size / 2; n++)
+        taps[size - 1 - n] = taps[n];
+    const T invsum = reciprocal(sum(taps));
+    taps           = taps * invsum;
+}
+}
+KFR_I_FN(cic_compensation)
+
+/**
+ * @brief Calculates coefficients for the FIR filter that compensates the passband droop of a CIC filter,
+ * run at the low rate of the CIC filter (after a decimator, before an interpolator)
+ * @param taps array where computed coefficients are stored
+ * @param order order of the CIC filter
+ * @param factor decimation or interpolation factor of the CIC filter
+ * @param differential_delay differential delay of the CIC filter
+ * @param cutoff passband edge normalized to the low sample rate, the response is zero above it
+ * @param window pointer to a window function
+ */
+template <typename T, size_t Tag>
+CMT_INLINE void cic_compensation(univector<T, Tag>& taps, size_t order, size_t factor,
+                                 size_t differential_delay, identity<T> cutoff,
+                                 const expression_pointer<T>& window)
+{
+    return intrinsics::cic_compensation(taps.slice(), order, factor, differential_delay, cutoff, window);
+}
+
+/**
+ * @copydoc kfr::cic_compensation
+ */
+template <typename T>
+CMT_INLINE void cic_compensation(const univector_ref<T>& taps, size_t order, size_t factor,
+                                 size_t differential_delay, identity<T> cutoff,
+                                 const expression_pointer<T>& window)
+{
+    return intrinsics::cic_compensation(taps, order, factor, differential_delay, cutoff, window);
+}
+}
@@ -30,6 +30,8 @@
 #include "../base/reduce.hpp"
 #include "../base/univector.hpp"
 #include "../base/vec.hpp"
+#include <algorithm>
+#include <vector>
 
 namespace kfr
 {
@@ -54,17 +56,414 @@ struct short_fir_state
     mutable vec<U, tapcount - 1> delayline;
 };
 
+/// @brief Maximum number of outputs computed from the delay line in one pass of the block FIR kernel
+constexpr size_t fir_block_size = 256;
+
+/// @brief Tap symmetry of a FIR filter, the taps of linear-phase filters are symmetric or antisymmetric
+enum class fir_symmetry
+{
+    none,
+    symmetric,
+    antisymmetric
+};
+
+/// @brief Returns the symmetry of the taps, taps[k] == taps[N - 1 - k] or taps[k] == -taps[N - 1 - k]
+template <typename T>
+fir_symmetry fir_detect_symmetry(const array_ref<const T>& taps)
+{
+    const size_t size = taps.size();
+    if (size < 2)
+        return fir_symmetry::none;
+    bool symmetric     = true;
+    bool antisymmetric = true;
+    for (size_t k = 0; k < size / 2; k++)
+    {
+        symmetric     = symmetric && taps[k] == taps[size - 1 - k];
+        antisymmetric = antisymmetric && taps[k] == -taps[size - 1 - k];
+    }
+    if (size % 2)
+        antisymmetric = antisymmetric && taps[size / 2] == T(0);
+    return symmetric ? fir_symmetry::symmetric
+                     : antisymmetric ? fir_symmetry::antisymmetric : fir_symmetry::none;
+}
+
+namespace internal
+{
+// Makes the value of ptr opaque to the optimizer. Without it, GCC's predictive commoning sees that
+// the vector loaded at src + width for one tap is loaded again at src for tap + width, and rebuilds
+// the overlapping vector loads of the register-blocked kernels from scalar loads and inserts
+template <typename T>
+CMT_INLINE void fir_opaque_pointer(const T*& ptr)
+{
+#ifdef CMT_COMPILER_GCC
+    __asm__("" : "+r"(ptr));
+#else
+    (void)ptr;
+#endif
+}
+
+// acc[n] += sum(k) taps[k] * window[n + k] for count outputs. As in fir_block_multichannel, four vectors
+// of outputs stay in registers while each tap is broadcast and applied to all of them
+template <typename R, typename T, typename U>
+CMT_INLINE void fir_accumulate(R* acc, const U* window, const T* taps, size_t tapcount, size_t count)
+{
+    constexpr size_t width = platform<subtype<U>>::vector_width;
+    size_t n               = 0;
+    for (; n + width * 4 <= count; n += width * 4)
+    {
+        const U* src       = window + n;
+        vec<R, width> sum0 = read<width>(acc + n);
+        vec<R, width> sum1 = read<width>(acc + n + width);
+        vec<R, width> sum2 = read<width>(acc + n + width * 2);
+        vec<R, width> sum3 = read<width>(acc + n + width * 3);
+        for (size_t k = 0; k < tapcount; k++, src++)
+        {
+            fir_opaque_pointer(src);
+            const T tap = taps[k];
+            sum0 += static_cast<vec<R, width>>(read<width>(src)) * tap;
+            sum1 += static_cast<vec<R, width>>(read<width>(src + width)) * tap;
+            sum2 += static_cast<vec<R, width>>(read<width>(src + width * 2)) * tap;
+            sum3 += static_cast<vec<R, width>>(read<width>(src + width * 3)) * tap;
+        }
+        write(acc + n, sum0);
+        write(acc + n + width, sum1);
+        write(acc + n + width * 2, sum2);
+        write(acc + n + width * 3, sum3);
+    }
+    block_process(count - n, csizes_t<width, 1>(), [&](size_t i, auto w) {
+        constexpr size_t width = val_of(decltype(w)());
+        const U* src           = window + n + i;
+        vec<R, width> sum      = read<width>(acc + n + i);
+        for (size_t k = 0; k < tapcount; k++)
+            sum += static_cast<vec<R, width>>(read<width>(src + k)) * taps[k];
+        write(acc + n + i, sum);
+    });
+}
+
+// Same as fir_accumulate for taps[k] == taps[tapcount - 1 - k] (or -taps[tapcount - 1 - k] if antisymmetric),
+// the mirrored samples are added (or subtracted) first, so each pair of taps costs one multiply
+template <bool antisymmetric, typename R, typename T, typename U>
+CMT_INLINE void fir_accumulate_symmetric(R* acc, const U* window, const T* taps, size_t tapcount,
+                                         size_t count, cbool_t<antisymmetric>)
+{
+    constexpr size_t width = platform<subtype<U>>::vector_width;
+    const size_t half      = tapcount / 2;
+    const auto pair        = [](const U* src1, const U* src2, auto w) {
+        constexpr size_t width = val_of(decltype(w)());
+        const vec<R, width> x1 = static_cast<vec<R, width>>(read<width>(src1));
+        const vec<R, width> x2 = static_cast<vec<R, width>>(read<width>(src2));
+        return antisymmetric ? x1 - x2 : x1 + x2;
+    };
+    size_t n = 0;
+    for (; n + width * 4 <= count; n += width * 4)
+    {
+        const U* src1      = window + n;
+        const U* src2      = window + n + tapcount - 1;
+        vec<R, width> sum0 = read<width>(acc + n);
+        vec<R, width> sum1 = read<width>(acc + n + width);
+        vec<R, width> sum2 = read<width>(acc + n + width * 2);
+        vec<R, width> sum3 = read<width>(acc + n + width * 3);
+        for (size_t k = 0; k < half; k++, src1++, src2--)
+        {
+            fir_opaque_pointer(src1);
+            fir_opaque_pointer(src2);
+            const T tap = taps[k];
+            sum0 += pair(src1, src2, csize_t<width>()) * tap;
+            sum1 += pair(src1 + width, src2 + width, csize_t<width>()) * tap;
+            sum2 += pair(src1 + width * 2, src2 + width * 2, csize_t<width>()) * tap;
+            sum3 += pair(src1 + width * 3, src2 + width * 3, csize_t<width>()) * tap;
+        }
+        write(acc + n, sum0);
+        write(acc + n + width, sum1);
+        write(acc + n + width * 2, sum2);
+        write(acc + n + width * 3, sum3);
+    }
+    block_process(count - n, csizes_t<width, 1>(), [&](size_t i, auto w) {
+        constexpr size_t width = val_of(decltype(w)());
+        const U* src1          = window + n + i;
+        const U* src2          = window + n + i + tapcount - 1;
+        vec<R, width> sum      = read<width>(acc + n + i);
+        for (size_t k = 0; k < half; k++)
+            sum += pair(src1 + k, src2 - k, csize_t<width>()) * taps[k];
+        write(acc + n + i, sum);
+    });
+    if (!antisymmetric && tapcount % 2)
+        fir_accumulate(acc, window + half, taps + half, 1, count);
+}
+
+// Selects the kernel for the symmetry of the taps
+template <typename R, typename T, typename U>
+CMT_INLINE void fir_accumulate(R* acc, const U* window, const T* taps, size_t tapcount, size_t count,
+                               fir_symmetry symmetry)
+{
+    switch (symmetry)
+    {
+    case fir_symmetry::symmetric:
+        fir_accumulate_symmetric(acc, window, taps, tapcount, count, cfalse);
+        break;
+    case fir_symmetry::antisymmetric:
+        fir_accumulate_symmetric(acc, window, taps, tapcount, count, ctrue);
+        break;
+    default:
+        fir_accumulate(acc, window, taps, tapcount, count);
+        break;
+    }
+}
+
+// out[n] = sum(k) taps[k] * window[n + k] for count <= fir_block_size outputs
+template <typename T, typename U>
+CMT_INLINE void fir_block(U* out, const U* window, const T* taps, size_t tapcount, size_t count,
+                          fir_symmetry symmetry = fir_symmetry::none)
+{
+    using R                = decltype(std::declval<U>() * std::declval<T>());
+    constexpr size_t width = platform<subtype<U>>::vector_width;
+    alignas(platform<>::native_cache_alignment) R acc[fir_block_size];
+    std::fill(acc, acc + count, R(0));
+    fir_accumulate(acc, window, taps, tapcount, count, symmetry);
+    block_process(count, csizes_t<width, 1>(), [&](size_t n, auto w) {
+        constexpr size_t width = val_of(decltype(w)());
+        write(out + n, static_cast<vec<U, width>>(read<width>(acc + n)));
+    });
+}
+
+// out[n] = a[n] + (b[n] - a[n]) * (position + n + 1) / length, where a and b are the outputs of taps0
+// and taps1 over the same window. Both sums stay in registers and share each window load, as in
+// fir_accumulate, and are mixed before the outputs are written. The symmetric kernels are not used here,
+// a crossfade is short and the two sets need not have the same symmetry
+template <typename T, typename U>
+CMT_INLINE void fir_block_crossfade(U* out, const U* window, const T* taps0, const T* taps1, size_t tapcount,
+                                    size_t count, size_t position, size_t length)
+{
+    using R                = decltype(std::declval<U>() * std::declval<T>());
+    using G                = subtype<R>;
+    constexpr size_t width = platform<subtype<U>>::vector_width;
+    const G step           = G(1) / G(length);
+    const auto mix         = [&](size_t n, const auto& a, const auto& b) {
+        constexpr size_t width = std::decay_t<decltype(a)>::size();
+        const vec<G, width> g  = (enumerate<G, width>() + G(position + n + 1)) * step;
+        write(out + n, static_cast<vec<U, width>>(a + (b - a) * static_cast<vec<R, width>>(g)));
+    };
+    size_t n = 0;
+    for (; n + width * 4 <= count; n += width * 4)
+    {
+        const U* src = window + n;
+        vec<R, width> a0(0), a1(0), a2(0), a3(0);
+        vec<R, width> b0(0), b1(0), b2(0), b3(0);
+        for (size_t k = 0; k < tapcount; k++, src++)
+        {
+            fir_opaque_pointer(src);
+            const T tap0           = taps0[k];
+            const T tap1           = taps1[k];
+            const vec<R, width> x0 = static_cast<vec<R, width>>(read<width>(src));
+            const vec<R, width> x1 = static_cast<vec<R, width>>(read<width>(src + width));
+            const vec<R, width> x2 = static_cast<vec<R, width>>(read<width>(src + width * 2));
+            const vec<R, width> x3 = static_cast<vec<R, width>>(read<width>(src + width * 3));
+            a0 += x0 * tap0;
+            b0 += x0 * tap1;
+            a1 += x1 * tap0;
+            b1 += x1 * tap1;
+            a2 += x2 * tap0;
+            b2 += x2 * tap1;
+            a3 += x3 * tap0;
+            b3 += x3 * tap1;
+        }
+        mix(n, a0, b0);
+        mix(n + width, a1, b1);
+        mix(n + width * 2, a2, b2);
+        mix(n + width * 3, a3, b3);
+    }
+    block_process(count - n, csizes_t<width, 1>(), [&](size_t i, auto w) {
+        constexpr size_t width = val_of(decltype(w)());
+        const U* src           = window + n + i;
+        vec<R, width> a(0), b(0);
+        for (size_t k = 0; k < tapcount; k++)
+        {
+            const vec<R, width> x = static_cast<vec<R, width>>(read<width>(src + k));
+            a += x * taps0[k];
+            b += x * taps1[k];
+        }
+        mix(n + i, a, b);
+    });
+}
+
+// out[n * stride + c] = sum(k) taps[k] * window[(n + k) * stride + c] for count frames of stride channels,
+// stride is a multiple of the vector width, each tap is broadcast over a vector of channels and is
+// applied to four frames at once
+template <typename T, typename U>
+CMT_INLINE void fir_block_multichannel(U* out, const U* window, const T* taps, size_t tapcount, size_t count,
+                                       size_t stride)
+{
+    using R                = decltype(std::declval<U>() * std::declval<T>());
+    constexpr size_t width = platform<subtype<U>>::vector_width;
+    for (size_t c = 0; c < stride; c += width)
+    {
+        size_t n = 0;
+        for (; n + 4 <= count; n += 4)
+        {
+            const U* src       = window + n * stride + c;
+            vec<R, width> sum0 = 0;
+            vec<R, width> sum1 = 0;
+            vec<R, width> sum2 = 0;
+            vec<R, width> sum3 = 0;
+            for (size_t k = 0; k < tapcount; k++, src += stride)
+            {
+                sum0 += static_cast<vec<R, width>>(read<width, true>(src)) * taps[k];
+                sum1 += static_cast<vec<R, width>>(read<width, true>(src + stride)) * taps[k];
+                sum2 += static_cast<vec<R, width>>(read<width, true>(src + stride * 2)) * taps[k];
+                sum3 += static_cast<vec<R, width>>(read<width, true>(src + stride * 3)) * taps[k];
+            }
+            write<true>(out + n * stride + c, static_cast<vec<U, width>>(sum0));
+            write<true>(out + (n + 1) * stride + c, static_cast<vec<U, width>>(sum1));
+            write<true>(out + (n + 2) * stride + c, static_cast<vec<U, width>>(sum2));
+            write<true>(out + (n + 3) * stride + c, static_cast<vec<U, width>>(sum3));
+        }
+        for (; n < count; n++)
+        {
+            const U* src      = window + n * stride + c;
+            vec<R, width> sum = 0;
+            for (size_t k = 0; k < tapcount; k++, src += stride)
+                sum += static_cast<vec<R, width>>(read<width, true>(src)) * taps[k];
+            write<true>(out + n * stride + c, static_cast<vec<U, width>>(sum));
+        }
+    }
+}
+} // namespace internal
+
 template <typename T, typename U = T>
 struct fir_state
 {
-    fir_state(const array_ref<const T>& taps)
-        : taps(taps.size()), delayline(taps.size(), U(0)), delayline_cursor(0)
+    /// @brief The delay line is allocated for max_tapcount taps (at least taps.size()), so replace_taps
+    /// can take up to max_tapcount taps without allocation
+    fir_state(const array_ref<const T>& taps, size_t max_tapcount = 0)
+        : taps(taps.size()),
+          delayline((std::max(taps.size(), max_tapcount) - 1 + fir_block_size) * 2, U(0)),
+          delayline_cursor(0), symmetry(fir_detect_symmetry(taps)), fade_position(0), fade_length(0),
+          fade_tapcount(0), fade_symmetry(fir_symmetry::none)
     {
         this->taps = reverse(make_univector(taps.data(), taps.size()));
+        this->taps.reserve(this->max_tapcount());
+        fade_taps.reserve(this->max_tapcount());
+    }
+
+    /// @brief Largest tap count replace_taps takes without reallocation
+    size_t max_tapcount() const { return delayline.size() / 2 - fir_block_size + 1; }
+
+    /// @brief Replaces the taps keeping the delay line, so the output continues from the current history.
+    /// If crossfade is not zero, the output moves linearly from the current taps to the new ones over
+    /// crossfade samples, both sets are applied in the same pass. A replacement during a crossfade starts
+    /// from the response reached so far. Performs no allocation, returns false and changes nothing
+    /// if taps.size() > max_tapcount(). Not thread-safe, must not run concurrently with process
+    bool replace_taps(const array_ref<const T>& new_taps, size_t crossfade = 0)
+    {
+        const size_t count = new_taps.size();
+        if (count == 0 || count > max_tapcount())
+            return false;
+        if (crossfade == 0)
+        {
+            fade_length = 0;
+            set_reversed(taps, new_taps, count);
+            symmetry = fir_detect_symmetry(new_taps);
+            return true;
+        }
+        if (fade_length)
+        {
+            // Bake the current mix into fade_taps, taps and fade_taps have the same size during a crossfade
+            const T g = T(fade_position) / T(fade_length);
+            for (size_t k = 0; k < taps.size(); k++)
+                fade_taps[k] = fade_taps[k] + (taps[k] - fade_taps[k]) * g;
+        }
+        else
+        {
+            fade_taps.resize(taps.size());
+            std::copy(taps.begin(), taps.end(), fade_taps.begin());
+        }
+        // Both sets are aligned to the most recent sample, the shorter one is padded with leading zeros
+        const size_t size = std::max(fade_taps.size(), count);
+        pad_front(fade_taps, size);
+        set_reversed(taps, new_taps, size);
+        fade_tapcount = count;
+        fade_symmetry = fir_detect_symmetry(new_taps);
+        fade_position = 0;
+        fade_length   = crossfade;
+        return true;
     }
-    univector_dyn<T> taps;
+
+    /// @brief Appends count input samples to the delay line and writes count outputs, src and dest may be
+    /// the same
+    void process(U* dest, const U* src, size_t count) const
+    {
+        // The delay line is written twice, at cursor and cursor + capacity, so the window
+        // of any output is contiguous in memory and the kernel can read it without wrapping
+        const size_t capacity = delayline.size() / 2;
+        U* data               = delayline.data();
+        while (count > 0)
+        {
+            size_t block = std::min(std::min(count, fir_block_size), capacity - delayline_cursor);
+            if (fade_length)
+                block = std::min(block, fade_length - fade_position);
+            internal::builtin_memcpy(data + delayline_cursor, src, block * sizeof(U));
+            internal::builtin_memcpy(data + delayline_cursor + capacity, src, block * sizeof(U));
+            const U* window = data + delayline_cursor + capacity - (taps.size() - 1);
+            if (fade_length)
+            {
+                internal::fir_block_crossfade(dest, window, fade_taps.data(), taps.data(), taps.size(), block,
+                                              fade_position, fade_length);
+                fade_position += block;
+                if (fade_position == fade_length)
+                    finish_crossfade();
+            }
+            else
+                internal::fir_block(dest, window, taps.data(), taps.size(), block, symmetry);
+            delayline_cursor += block;
+            if (delayline_cursor == capacity)
+                delayline_cursor = 0;
+            src += block;
+            dest += block;
+            count -= block;
+        }
+    }
+
+    // Changes only when a crossfade ends
+    mutable univector_dyn<T> taps;
     mutable univector_dyn<U> delayline;
     mutable size_t delayline_cursor;
+    // Linear-phase taps are detected on construction and use the kernel that halves the multiplies
+    mutable fir_symmetry symmetry;
+
+    // Taps being faded out, the crossfade ends after fade_length samples
+    mutable univector_dyn<T> fade_taps;
+    mutable size_t fade_position;
+    mutable size_t fade_length;
+    mutable size_t fade_tapcount;
+    mutable fir_symmetry fade_symmetry;
+
+protected:
+    // Writes the reversed taps to the end of dest resized to size, the rest is zero. size <= capacity
+    static void set_reversed(univector_dyn<T>& dest, const array_ref<const T>& taps, size_t size)
+    {
+        dest.resize(size);
+        std::fill(dest.begin(), dest.end() - taps.size(), T(0));
+        for (size_t k = 0; k < taps.size(); k++)
+            dest[size - 1 - k] = taps[k];
+    }
+
+    // Inserts leading zeros up to size, size <= capacity
+    static void pad_front(univector_dyn<T>& taps, size_t size)
+    {
+        const size_t count = taps.size();
+        taps.resize(size);
+        std::copy_backward(taps.begin(), taps.begin() + count, taps.end());
+        std::fill(taps.begin(), taps.end() - count, T(0));
+    }
+
+    void finish_crossfade() const
+    {
+        // Drop the padding of the new taps
+        std::copy(taps.begin() + (taps.size() - fade_tapcount), taps.end(), taps.begin());
+        taps.resize(fade_tapcount);
+        symmetry    = fade_symmetry;
+        fade_length = 0;
+    }
 };
 
 namespace internal
@@ -122,29 +521,43 @@ struct expression_fir : expression_base<E1>
     using value_type = U;
 
     expression_fir(E1&& e1, const fir_state<T, U>& state)
-        : expression_base<E1>(std::forward<E1>(e1)), state(state)
+        : expression_base<E1>(std::forward<E1>(e1)), state(state), begin(0), count(0)
     {
     }
 
+    // The input is read and filtered in chunks of up to fir_block_size samples, so that the block kernel
+    // runs over whole chunks, and the outputs are served from a buffer. Indices must be requested in order
     template <size_t N>
-    CMT_INLINE vec<U, N> operator()(cinput_t cinput, size_t index, vec_t<U, N> x) const
+    CMT_INLINE vec<U, N> operator()(cinput_t cinput, size_t index, vec_t<U, N>) const
     {
-        const size_t tapcount = state.s.taps.size();
-        const vec<U, N> input = this->argument_first(cinput, index, x);
-
-        vec<U, N> output;
-        size_t cursor = state.s.delayline_cursor;
-        CMT_LOOP_NOUNROLL
-        for (size_t i = 0; i < N; i++)
-        {
-            state.s.delayline.ringbuf_write(cursor, input[i]);
-            output[i] = dotproduct(state.s.taps, state.s.delayline.slice(cursor) /*, tapcount - cursor*/) +
-                        dotproduct(state.s.taps.slice(tapcount - cursor), state.s.delayline /*, cursor*/);
-        }
-        state.s.delayline_cursor = cursor;
-        return output;
+        if (index < begin || index + N > begin + count)
+            refill(cinput, index);
+        return read<N>(buffer + (index - begin));
     }
     state_holder<fir_state<T, U>, stateless> state;
+
+protected:
+    // Keeps the buffered outputs from index on and filters the next chunk of the input after them
+    void refill(cinput_t cinput, size_t index) const
+    {
+        constexpr size_t width = platform<U>::vector_width;
+        const size_t kept      = index >= begin && index < begin + count ? begin + count - index : 0;
+        std::copy(buffer + (count - kept), buffer + count, buffer);
+        begin              = index;
+        const size_t start = index + kept;
+        const size_t size  = std::min(fir_block_size - kept, size_sub(this->size(), start));
+        alignas(platform<>::native_cache_alignment) U input[fir_block_size];
+        block_process(size, csizes_t<width, 1>(), [&](size_t i, auto w) {
+            constexpr size_t width = val_of(decltype(w)());
+            write(input + i, this->argument_first(cinput, start + i, vec_t<U, width>()));
+        });
+        state.s.process(buffer + kept, input, size);
+        count = kept + size;
+    }
+
+    alignas(platform<>::native_cache_alignment) mutable U buffer[fir_block_size];
+    mutable size_t begin;
+    mutable size_t count;
 };
 }
 
@@ -188,21 +601,29 @@ template <typename T, typename U = T>
 class filter_fir : public filter<U>
 {
 public:
-    filter_fir(const array_ref<const T>& taps) : state(taps) {}
+    /// @brief Taps up to max_tapcount long can be set later without allocation
+    filter_fir(const array_ref<const T>& taps, size_t max_tapcount = 0) : state(taps, max_tapcount) {}
+
+    /// @brief Replaces the taps keeping the history, optionally with a crossfade over crossfade samples
+    /// that avoids clicks. Does not allocate unless taps.size() exceeds max_tapcount(), then the state is
+    /// reallocated for the new taps and the history is cleared. Must not be called concurrently with apply
+    void set_taps(const array_ref<const T>& taps, size_t crossfade = 0)
+    {
+        if (!state.replace_taps(taps, crossfade))
+            state = fir_state<T, U>(taps, std::max(taps.size(), state.max_tapcount()));
+    }
 
-    void set_taps(const array_ref<const T>& taps) { state = fir_state<T, U>(taps); }
+    /// @brief Largest tap count set_taps takes without allocation
+    size_t max_tapcount() const { return state.max_tapcount(); }
 
     void reset() final
     {
-        state.delayline.fill(0);
+        std::fill(state.delayline.begin(), state.delayline.end(), U(0));
         state.delayline_cursor = 0;
     }
 
 protected:
-    void process_buffer(U* dest, const U* src, size_t size) final
-    {
-        make_univector(dest, size) = fir(state, make_univector(src, size));
-    }
+    void process_buffer(U* dest, const U* src, size_t size) final { state.process(dest, src, size); }
     void process_expression(U* dest, const expression_pointer<U>& src, size_t size) final
     {
         make_univector(dest, size) = fir(state, src);
@@ -211,4 +632,581 @@ protected:
 private:
     fir_state<T, U> state;
 };
+
+/// @brief FIR filter applying the same taps to several channels. The delay line is channel-interleaved,
+/// so one vector holds the same time index of consecutive channels and each tap is a single broadcast
+/// multiply-add across them. Use it instead of one filter_fir per channel for arrays and multichannel EQ
+template <typename T, typename U = T>
+class filter_fir_multichannel
+{
+public:
+    filter_fir_multichannel(const array_ref<const T>& taps, size_t channels)
+        : channel_count(channels), stride(align_up(channels, platform<subtype<U>>::vector_width)),
+          scratch(fir_block_size * stride)
+    {
+        set_taps(taps);
+    }
+
+    size_t channels() const { return channel_count; }
+
+    /// @brief Replaces the taps and clears the delay line
+    void set_taps(const array_ref<const T>& taps)
+    {
+        this->taps.resize(taps.size());
+        this->taps = reverse(make_univector(taps.data(), taps.size()));
+        capacity   = taps.size() - 1 + fir_block_size;
+        delayline.resize(capacity * 2 * stride);
+        reset();
+    }
+
+    void reset()
+    {
+        std::fill(delayline.begin(), delayline.end(), U(0));
+        cursor = 0;
+    }
+
+    /// @brief Processes size samples of each channel, output and input point to arrays of channel pointers
+    void apply(U* const* output, const U* const* input, size_t size)
+    {
+        process(size,
+                [&](U* rows, size_t offset, size_t count) {
+                    for (size_t ch = 0; ch < channel_count; ch++)
+                        for (size_t i = 0; i < count; i++)
+                            rows[i * stride + ch] = input[ch][offset + i];
+                },
+                [&](const U* rows, size_t offset, size_t count) {
+                    for (size_t ch = 0; ch < channel_count; ch++)
+                        for (size_t i = 0; i < count; i++)
+                            output[ch][offset + i] = rows[i * stride + ch];
+                });
+    }
+
+    /// @brief Processes size frames of interleaved samples, output and input hold size * channels() values
+    void apply_interleaved(U* output, const U* input, size_t size)
+    {
+        process(size,
+                [&](U* rows, size_t offset, size_t count) {
+                    for (size_t i = 0; i < count; i++)
+                        internal::builtin_memcpy(rows + i * stride, input + (offset + i) * channel_count,
+                                                 channel_count * sizeof(U));
+                },
+                [&](const U* rows, size_t offset, size_t count) {
+                    for (size_t i = 0; i < count; i++)
+                        internal::builtin_memcpy(output + (offset + i) * channel_count, rows + i * stride,
+                                                 channel_count * sizeof(U));
+                });
+    }
+
+protected:
+    // Delay line rows are written twice, at cursor and cursor + capacity, as in fir_state
+    template <typename Load, typename Store>
+    void process(size_t size, Load&& load, Store&& store)
+    {
+        const size_t tapcount = taps.size();
+        U* data               = delayline.data();
+        size_t offset         = 0;
+        while (offset < size)
+        {
+            const size_t block = std::min(std::min(size - offset, fir_block_size), capacity - cursor);
+            load(data + cursor * stride, offset, block);
+            internal::builtin_memcpy(data + (cursor + capacity) * stride, data + cursor * stride,
+                                     block * stride * sizeof(U));
+            const U* window = data + (cursor + capacity - (tapcount - 1)) * stride;
+            internal::fir_block_multichannel(scratch.data(), window, taps.data(), tapcount, block, stride);
+            store(scratch.data(), offset, block);
+            cursor += block;
+            if (cursor == capacity)
+                cursor = 0;
+            offset += block;
+        }
+    }
+
+    const size_t channel_count;
+    const size_t stride;
+    univector<T> taps;
+    univector<U> delayline;
+    univector<U> scratch;
+    size_t capacity;
+    size_t cursor;
+};
+
+/// @brief FIR filter with few non-zero taps spread over a long response, such as early reflections
+/// or multipath channel models. Stores (delay, gain) pairs and the input in a power-of-two ring,
+/// so the cost grows with the number of non-zero taps instead of the length of the response.
+/// The ring is extended by one block past its end, so each tap reads a contiguous run of samples per block
+template <typename T, typename U = T>
+class filter_fir_sparse : public filter<U>
+{
+public:
+    filter_fir_sparse(const array_ref<const size_t>& delays, const array_ref<const T>& gains)
+    {
+        set_taps(delays, gains);
+    }
+
+    /// @brief Keeps the non-zero taps of a dense response
+    explicit filter_fir_sparse(const array_ref<const T>& taps) { set_taps(taps); }
+
+    /// @brief Number of non-zero taps
+    size_t tapcount() const { return gains.size(); }
+
+    /// @brief Length of the response, the largest delay plus one
+    size_t length() const { return delays.empty() ? 0 : delays.back() + 1; }
+
+    /// @brief Replaces the taps and clears the delay line
+    void set_taps(const array_ref<const size_t>& delays, const array_ref<const T>& gains)
+    {
+        std::vector<size_t> order(std::min(delays.size(), gains.size()));
+        for (size_t i = 0; i < order.size(); i++)
+            order[i] = i;
+        // Ascending delays keep the reads of consecutive taps close to each other
+        std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return delays[a] < delays[b]; });
+        this->delays.resize(order.size());
+        this->gains.resize(order.size());
+        for (size_t i = 0; i < order.size(); i++)
+        {
+            this->delays[i] = delays[order[i]];
+            this->gains[i]  = gains[order[i]];
+        }
+        mask = next_poweroftwo(length() + fir_block_size) - 1;
+        ring.resize(mask + 1 + fir_block_size);
+        reset();
+    }
+
+    /// @brief Replaces the taps with the non-zero taps of a dense response and clears the delay line
+    void set_taps(const array_ref<const T>& taps)
+    {
+        std::vector<size_t> delays;
+        std::vector<T> gains;
+        for (size_t k = 0; k < taps.size(); k++)
+        {
+            if (taps[k] == T(0))
+                continue;
+            delays.push_back(k);
+            gains.push_back(taps[k]);
+        }
+        set_taps(delays, gains);
+    }
+
+    void reset() final
+    {
+        std::fill(ring.begin(), ring.end(), U(0));
+        cursor = 0;
+    }
+
+protected:
+    void process_buffer(U* dest, const U* src, size_t size) final
+    {
+        using R                = decltype(std::declval<U>() * std::declval<T>());
+        constexpr size_t width = platform<subtype<U>>::vector_width;
+        const size_t ringsize  = mask + 1;
+        U* data                = ring.data();
+        alignas(platform<>::native_cache_alignment) R acc[fir_block_size];
+        for (size_t offset = 0; offset < size;)
+        {
+            const size_t block = std::min(size - offset, fir_block_size);
+            const size_t first = std::min(block, ringsize - cursor);
+            internal::builtin_memcpy(data + cursor, src + offset, first * sizeof(U));
+            internal::builtin_memcpy(data, src + offset + first, (block - first) * sizeof(U));
+            // The extension mirrors the start of the ring, refresh it when the start is written
+            if (cursor < fir_block_size || first < block)
+                internal::builtin_memcpy(data + ringsize, data, fir_block_size * sizeof(U));
+
+            std::fill(acc, acc + block, R(0));
+            size_t k = 0;
+            // Four taps per pass, the accumulator is loaded and stored once for all of them
+            for (; k + 4 <= delays.size(); k += 4)
+            {
+                const U* x0 = data + ((cursor - delays[k]) & mask);
+                const U* x1 = data + ((cursor - delays[k + 1]) & mask);
+                const U* x2 = data + ((cursor - delays[k + 2]) & mask);
+                const U* x3 = data + ((cursor - delays[k + 3]) & mask);
+                const T g0  = gains[k];
+                const T g1  = gains[k + 1];
+                const T g2  = gains[k + 2];
+                const T g3  = gains[k + 3];
+                block_process(block, csizes_t<width, 1>(), [=, &acc](size_t n, auto w) {
+                    constexpr size_t width = val_of(decltype(w)());
+                    using V                = vec<R, width>;
+                    write(acc + n, read<width>(acc + n) + static_cast<V>(read<width>(x0 + n)) * g0 +
+                                       static_cast<V>(read<width>(x1 + n)) * g1 +
+                                       static_cast<V>(read<width>(x2 + n)) * g2 +
+                                       static_cast<V>(read<width>(x3 + n)) * g3);
+                });
+            }
+            for (; k < delays.size(); k++)
+                internal::fir_accumulate(acc, data + ((cursor - delays[k]) & mask), gains.data() + k, 1,
+                                         block);
+            block_process(block, csizes_t<width, 1>(), [&](size_t n, auto w) {
+                constexpr size_t width = val_of(decltype(w)());
+                write(dest + offset + n, static_cast<vec<U, width>>(read<width>(acc + n)));
+            });
+            cursor = (cursor + block) & mask;
+            offset += block;
+        }
+    }
+    void process_expression(U* dest, const expression_pointer<U>& src, size_t size) final
+    {
+        // The input is evaluated in blocks through a stack buffer, so this path does not allocate
+        alignas(platform<>::native_cache_alignment) U input[fir_block_size];
+        for (size_t offset = 0; offset < size; offset += fir_block_size)
+        {
+            const size_t block           = std::min(fir_block_size, size - offset);
+            make_univector(input, block) = slice(src, offset, block);
+            process_buffer(dest + offset, input, block);
+        }
+    }
+
+    std::vector<size_t> delays;
+    univector<T> gains;
+    univector<U> ring;
+    size_t mask;
+    size_t cursor;
+};
+
+namespace internal
+{
+// Nonzero part of a polyphase branch, the taps [offset, offset + size) of the branch, and its symmetry.
+// The branches of half-band filters are a single tap and a symmetric set of taps
+struct fir_branch
+{
+    size_t offset;
+    size_t size;
+    fir_symmetry symmetry;
+};
+
+// Splits taps into factor branches, branch p holds taps[p], taps[p + factor], ... reversed and padded
+// with zeros to the same length
+template <typename T>
+univector<T> fir_polyphase_branches(const array_ref<const T>& taps, size_t factor, size_t& branch_length,
+                                    std::vector<fir_branch>& layout)
+{
+    branch_length = (taps.size() + factor - 1) / factor;
+    univector<T> branches(branch_length * factor, T(0));
+    for (size_t k = 0; k < taps.size(); k++)
+        branches[k % factor * branch_length + branch_length - 1 - k / factor] = taps[k];
+    layout.resize(factor);
+    for (size_t p = 0; p < factor; p++)
+    {
+        const T* branch = branches.data() + p * branch_length;
+        size_t first    = 0;
+        size_t last     = branch_length;
+        while (first < last && branch[first] == T(0))
+            first++;
+        while (last > first && branch[last - 1] == T(0))
+            last--;
+        layout[p] = { first, last - first,
+                      fir_detect_symmetry(array_ref<const T>(branch + first, last - first)) };
+    }
+    return branches;
+}
+
+template <typename R, typename T, typename U>
+CMT_INLINE void fir_accumulate(R* acc, const U* window, const T* branch, const fir_branch& layout,
+                               size_t count)
+{
+    if (layout.size)
+        fir_accumulate(acc, window + layout.offset, branch + layout.offset, layout.size, count,
+                       layout.symmetry);
+}
+} // namespace internal
+
+/// @brief Decimating FIR filter, the output is fir(taps) of the input taken at every factor-th sample
+/// starting from the first one. Taps are split into factor polyphase branches, each branch filters one
+/// phase of the input, so only the retained outputs are computed. Factor can be given as a template
+/// argument or, if it is 0, at runtime
+template <typename T, typename U = T, size_t Factor = 0>
+class filter_fir_decimator
+{
+public:
+    filter_fir_decimator(const array_ref<const T>& taps, size_t factor = Factor)
+        : decimation(Factor ? Factor : factor)
+    {
+        set_taps(taps);
+    }
+
+    size_t factor() const { return Factor ? Factor : decimation; }
+
+    /// @brief Replaces the taps and clears the delay line
+    void set_taps(const array_ref<const T>& taps)
+    {
+        branches = internal::fir_polyphase_branches(taps, factor(), branch_length, layout);
+        capacity = branch_length - 1 + fir_block_size;
+        delayline.resize(capacity * 2 * factor());
+        reset();
+    }
+
+    void reset()
+    {
+        std::fill(delayline.begin(), delayline.end(), U(0));
+        cursor = 0;
+        // The first input sample completes the first output
+        fill = factor() - 1;
+    }
+
+    /// @brief Number of outputs the next call of apply with size inputs will produce
+    size_t output_size(size_t size) const { return (size + fill) / factor(); }
+
+    /// @brief Filters size input samples and writes output_size(size) samples to dest, returns the number of
+    /// samples written. Input of any size can be given, incomplete frames are kept until the next call
+    size_t apply(U* dest, const U* src, size_t size)
+    {
+        const size_t m = factor();
+        size_t pending = 0;
+        size_t written = 0;
+        for (size_t i = 0; i < size;)
+        {
+            // Phase p holds the samples x[j * factor - p] of the frame j
+            if (fill == 0 && size - i >= m)
+            {
+                // Whole frames are split into the phases at once
+                const size_t frames = std::min(std::min((size - i) / m, fir_block_size - pending),
+                                               capacity - cursor);
+                for (size_t p = 0; p < m; p++)
+                {
+                    U* slot     = delayline.data() + p * capacity * 2 + cursor;
+                    const U* in = src + i + m - 1 - p;
+                    for (size_t j = 0; j < frames; j++)
+                        slot[j] = in[j * m];
+                    internal::builtin_memcpy(slot + capacity, slot, frames * sizeof(U));
+                }
+                i += frames * m;
+                cursor += frames;
+                pending += frames;
+            }
+            else
+            {
+                U* slot = delayline.data() + (m - 1 - fill) * capacity * 2 + cursor;
+                slot[0] = slot[capacity] = src[i++];
+                if (++fill < m)
+                    continue;
+                fill = 0;
+                ++cursor;
+                ++pending;
+            }
+            if (pending == fir_block_size || cursor == capacity)
+            {
+                flush(dest + written, pending);
+                written += pending;
+                pending = 0;
+                if (cursor == capacity)
+                    cursor = 0;
+            }
+        }
+        flush(dest + written, pending);
+        return written + pending;
+    }
+
+protected:
+    // Computes the outputs of the last count complete frames
+    void flush(U* dest, size_t count)
+    {
+        using R                = decltype(std::declval<U>() * std::declval<T>());
+        constexpr size_t width = platform<subtype<U>>::vector_width;
+        if (count == 0)
+            return;
+        alignas(platform<>::native_cache_alignment) R acc[fir_block_size];
+        std::fill(acc, acc + count, R(0));
+        const size_t first = cursor - count + capacity - (branch_length - 1);
+        for (size_t p = 0; p < factor(); p++)
+            internal::fir_accumulate(acc, delayline.data() + p * capacity * 2 + first,
+                                     branches.data() + p * branch_length, layout[p], count);
+        block_process(count, csizes_t<width, 1>(), [&](size_t n, auto w) {
+            constexpr size_t width = val_of(decltype(w)());
+            write(dest + n, static_cast<vec<U, width>>(read<width>(acc + n)));
+        });
+    }
+
+    const size_t decimation;
+    univector<T> branches;
+    std::vector<internal::fir_branch> layout;
+    univector<U> delayline;
+    size_t branch_length;
+    size_t capacity;
+    size_t cursor;
+    size_t fill;
+};
+
+/// @brief Interpolating FIR filter, the output is fir(taps) of the input with factor - 1 zeros inserted
+/// after each sample. Taps are split into factor polyphase branches that filter the input directly, so the
+/// inserted zeros are never multiplied. Factor can be given as a template argument or, if it is 0, at
+/// runtime
+template <typename T, typename U = T, size_t Factor = 0>
+class filter_fir_interpolator
+{
+public:
+    filter_fir_interpolator(const array_ref<const T>& taps, size_t factor = Factor)
+        : interpolation(Factor ? Factor : factor)
+    {
+        set_taps(taps);
+    }
+
+    size_t factor() const { return Factor ? Factor : interpolation; }
+
+    /// @brief Replaces the taps and clears the delay line
+    void set_taps(const array_ref<const T>& taps)
+    {
+        branches = internal::fir_polyphase_branches(taps, factor(), branch_length, layout);
+        capacity = branch_length - 1 + fir_block_size;
+        delayline.resize(capacity * 2);
+        reset();
+    }
+
+    void reset()
+    {
+        std::fill(delayline.begin(), delayline.end(), U(0));
+        cursor = 0;
+    }
+
+    /// @brief Filters size input samples and writes size * factor() samples to dest, returns the number of
+    /// samples written
+    size_t apply(U* dest, const U* src, size_t size)
+    {
+        using R        = decltype(std::declval<U>() * std::declval<T>());
+        const size_t m = factor();
+        U* data        = delayline.data();
+        alignas(platform<>::native_cache_alignment) R acc[fir_block_size];
+        for (size_t offset = 0; offset < size;)
+        {
+            const size_t block = std::min(std::min(size - offset, fir_block_size), capacity - cursor);
+            internal::builtin_memcpy(data + cursor, src + offset, block * sizeof(U));
+            internal::builtin_memcpy(data + cursor + capacity, src + offset, block * sizeof(U));
+            const U* window = data + cursor + capacity - (branch_length - 1);
+            for (size_t p = 0; p < m; p++)
+            {
+                std::fill(acc, acc + block, R(0));
+                internal::fir_accumulate(acc, window, branches.data() + p * branch_length, layout[p], block);
+                U* out = dest + offset * m + p;
+                for (size_t n = 0; n < block; n++)
+                    out[n * m] = static_cast<U>(acc[n]);
+            }
+            cursor += block;
+            if (cursor == capacity)
+                cursor = 0;
+            offset += block;
+        }
+        return size * m;
+    }
+
+protected:
+    const size_t interpolation;
+    univector<T> branches;
+    std::vector<internal::fir_branch> layout;
+    univector<U> delayline;
+    size_t branch_length;
+    size_t capacity;
+    size_t cursor;
+};
+
+/// @brief 2x decimator for half-band taps (see fir_halfband). The odd branch of a half-band filter is the
+/// center tap alone and the even branch is symmetric, so an output costs (N + 5) / 4 multiplies for N taps
+/// instead of 2 * N for fir() followed by downsample2()
+template <typename T, typename U = T>
+class filter_halfband_decimator : public filter_fir_decimator<T, U, 2>
+{
+public:
+    filter_halfband_decimator(const array_ref<const T>& taps) : filter_fir_decimator<T, U, 2>(taps) {}
+};
+
+/// @brief 2x interpolator for half-band taps (see fir_halfband), every other output is the delayed input
+/// scaled by the center tap and the others use the symmetric even branch
+template <typename T, typename U = T>
+class filter_halfband_interpolator : public filter_fir_interpolator<T, U, 2>
+{
+public:
+    filter_halfband_interpolator(const array_ref<const T>& taps) : filter_fir_interpolator<T, U, 2>(taps) {}
+};
+
+namespace internal
+{
+template <typename T, typename U, typename E1>
+struct expression_halfband_decimator : expression_base<E1>
+{
+    using value_type = U;
+
+    expression_halfband_decimator(E1&& e1, const array_ref<const T>& taps)
+        : expression_base<E1>(std::forward<E1>(e1)), filter(taps)
+    {
+    }
+    size_t size() const noexcept { return expression_base<E1>::size() / 2; }
+
+    template <size_t N>
+    CMT_INLINE vec<U, N> operator()(cinput_t cinput, size_t index, vec_t<U, N>) const
+    {
+        const vec<U, N * 2> input = this->argument_first(cinput, index * 2, vec_t<U, N * 2>());
+        vec<U, N> output;
+        filter.apply(ptr_cast<U>(&output), ptr_cast<U>(&input), N * 2);
+        return output;
+    }
+    mutable filter_halfband_decimator<T, U> filter;
+};
+
+template <typename T, typename U, typename E1>
+struct expression_halfband_interpolator : expression_base<E1>
+{
+    using value_type = U;
+
+    expression_halfband_interpolator(E1&& e1, const array_ref<const T>& taps)
+        : expression_base<E1>(std::forward<E1>(e1)), filter(taps)
+    {
+    }
+    size_t size() const noexcept { return expression_base<E1>::size() * 2; }
+
+    template <size_t N>
+    CMT_INLINE vec<U, N> operator()(cinput_t cinput, size_t index, vec_t<U, N>) const
+    {
+        vec<U, N> output;
+        if (index % 2 == 0)
+        {
+            const vec<U, N / 2> input = this->argument_first(cinput, index / 2, vec_t<U, N / 2>());
+            filter.apply(ptr_cast<U>(&output), ptr_cast<U>(&input), N / 2);
+            // Keep the last pair for a following scalar read
+            pair[0] = output[N - 2];
+            pair[1] = output[N - 1];
+            return output;
+        }
+        for (size_t i = 0; i < N; i++)
+            output[i] = sample(cinput, index + i);
+        return output;
+    }
+    CMT_INLINE vec<U, 1> operator()(cinput_t cinput, size_t index, vec_t<U, 1>) const
+    {
+        return sample(cinput, index);
+    }
+
+    // Both outputs of an input are computed when the even one is read, the odd one is kept for the next call
+    U sample(cinput_t cinput, size_t index) const
+    {
+        if (index % 2 == 0)
+        {
+            const vec<U, 1> input = this->argument_first(cinput, index / 2, vec_t<U, 1>());
+            filter.apply(pair, ptr_cast<U>(&input), 1);
+        }
+        return pair[index % 2];
+    }
+    mutable filter_halfband_interpolator<T, U> filter;
+    mutable U pair[2];
+};
+} // namespace internal
+
+/**
+ * @brief Returns an expression equal to downsample2(fir(e1, taps)) for half-band taps, computed with
+ * filter_halfband_decimator. Input is read sequentially, as with fir()
+ */
+template <typename T, typename E1, size_t Tag>
+CMT_INLINE internal::expression_halfband_decimator<T, value_type_of<E1>, E1> halfband_decimate2(
+    E1&& e1, const univector<T, Tag>& taps)
+{
+    return internal::expression_halfband_decimator<T, value_type_of<E1>, E1>(std::forward<E1>(e1), taps);
+}
+
+/**
+ * @brief Returns an expression equal to fir(upsample2(e1), taps) for half-band taps, computed with
+ * filter_halfband_interpolator. Input is read sequentially, as with fir()
+ */
+template <typename T, typename E1, size_t Tag>
+CMT_INLINE internal::expression_halfband_interpolator<T, value_type_of<E1>, E1> halfband_interpolate2(
+    E1&& e1, const univector<T, Tag>& taps)
+{
+    return internal::expression_halfband_interpolator<T, value_type_of<E1>, E1>(std::forward<E1>(e1), taps);
+}
 }
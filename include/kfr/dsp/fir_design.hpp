@@ -32,6 +32,16 @@ namespace kfr
 
 namespace intrinsics
 {
+// The windowed sinc is symmetric only up to rounding, copying the first half keeps it exact,
+// so fir_state can detect the symmetry and use the kernel that halves the multiplies
+template <typename T>
+void fir_symmetrize(univector_ref<T> taps)
+{
+    const size_t size = taps.size();
+    for (size_t k = 0; k < size / 2; k++)
+        taps[size - 1 - k] = taps[k];
+}
+
 template <typename T>
 void fir_lowpass(univector_ref<T> taps, T cutoff, const expression_pointer<T>& window, bool normalize = true)
 {
@@ -43,6 +53,8 @@ void fir_lowpass(univector_ref<T> taps, T cutoff, const expression_pointer<T>& w
     if (is_odd(taps.size()))
         taps[taps.size() / 2] = scale;
 
+    fir_symmetrize(taps);
+
     if (normalize)
     {
         const T invsum = reciprocal(sum(taps));
@@ -60,6 +72,8 @@ void fir_highpass(univector_ref<T> taps, T cutoff, const expression_pointer<T>&
     if (is_odd(taps.size()))
         taps[taps.size() / 2] = 1 - 2.0 * cutoff;
 
+    fir_symmetrize(taps);
+
     if (normalize)
     {
         const T invsum = reciprocal(sum(taps) + 1);
@@ -84,6 +98,8 @@ void fir_bandpass(univector_ref<T> taps, T frequency1, T frequency2, const expre
     if (is_odd(taps.size()))
         taps[taps.size() / 2] = 2 * (frequency2 - frequency1);
 
+    fir_symmetrize(taps);
+
     if (normalize)
     {
         const T invsum = reciprocal(sum(taps) + 1);
@@ -108,17 +124,48 @@ void fir_bandstop(univector_ref<T> taps, T frequency1, T frequency2, const expre
     if (is_odd(taps.size()))
         taps[taps.size() / 2] = 1 - 2 * (frequency2 - frequency1);
 
+    fir_symmetrize(taps);
+
     if (normalize)
     {
         const T invsum = reciprocal(sum(taps));
         taps           = taps * invsum;
     }
 }
+
+template <typename T>
+bool fir_halfband(univector_ref<T> taps, const expression_pointer<T>& window, bool normalize = true)
+{
+    // Only odd lengths have the center tap that makes every other tap zero
+    if (!is_odd(taps.size()))
+    {
+        std::fill(taps.begin(), taps.end(), T(0));
+        return false;
+    }
+    fir_lowpass(taps, T(0.25), window, false);
+
+    // Taps at an even distance from the centre are zeros of the sinc, make them exact
+    const size_t center = taps.size() / 2;
+    for (size_t k = 0; k < taps.size(); k++)
+        if (k != center && (k + center) % 2 == 0)
+            taps[k] = T(0);
+
+    if (normalize)
+    {
+        // The other taps sum to one half and the center tap is one half, so H(w) + H(pi - w) == 1
+        taps[center]   = T(0);
+        const T invsum = reciprocal(sum(taps) * 2);
+        taps           = taps * invsum;
+        taps[center]   = T(0.5);
+    }
+    return true;
+}
 }
 KFR_I_FN(fir_lowpass)
 KFR_I_FN(fir_highpass)
 KFR_I_FN(fir_bandpass)
 KFR_I_FN(fir_bandstop)
+KFR_I_FN(fir_halfband)
 
 /**
  * @brief Calculates coefficients for the low-pass FIR filter
@@ -178,6 +225,21 @@ CMT_INLINE void fir_bandstop(univector<T, Tag>& taps, identity<T> frequency1, id
     return intrinsics::fir_bandstop(taps.slice(), frequency1, frequency2, window, normalize);
 }
 
+/**
+ * @brief Calculates coefficients for the half-band low-pass FIR filter (cutoff at a quarter of the sample
+ * rate). Every other tap except the center one is zero. The size must be odd, 4k+3 avoids zero end taps
+ * @param taps array where computed coefficients are stored
+ * @param window pointer to a window function
+ * @param normalize true for normalized coefficients
+ * @return false and zero taps if the size is even
+ */
+template <typename T, size_t Tag>
+CMT_INLINE bool fir_halfband(univector<T, Tag>& taps, const expression_pointer<T>& window,
+                             bool normalize = true)
+{
+    return intrinsics::fir_halfband(taps.slice(), window, normalize);
+}
+
 /**
  * @copydoc kfr::fir_lowpass
  */
@@ -217,4 +279,14 @@ CMT_INLINE void fir_bandstop(const univector_ref<T>& taps, identity<T> frequency
 {
     return intrinsics::fir_bandstop(taps, frequency1, frequency2, window, normalize);
 }
+
+/**
+ * @copydoc kfr::fir_halfband
+ */
+template <typename T>
+CMT_INLINE bool fir_halfband(const univector_ref<T>& taps, const expression_pointer<T>& window,
+                             bool normalize = true)
+{
+    return intrinsics::fir_halfband(taps, window, normalize);
+}
 }
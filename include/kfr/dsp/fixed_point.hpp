@@ -0,0 +1,368 @@
+/** @addtogroup dsp
+ *  @{
+ */
+/*
+  Copyright (C) 2016 D Levin (https://www.kfrlib.com)
+  This file is part of KFR
+
+  KFR is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  KFR is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with KFR.
+
+  If GPL is not suitable for your project, you must purchase a commercial license to use KFR.
+  Buying a commercial license is mandatory as soon as you develop commercial activities without
+  disclosing the source code of your own applications.
+  See https://www.kfrlib.com for details.
+ */
+#pragma once
+
+#include "../base/filter.hpp"
+#include "../base/memory.hpp"
+#include "../base/min_max.hpp"
+#include "../base/saturation.hpp"
+#include "../base/univector.hpp"
+#include "../base/vec.hpp"
+#include "biquad.hpp"
+#include "fir.hpp"
+#include <cmath>
+#include <vector>
+
+namespace kfr
+{
+
+/// @brief Converts a value to fixed point with frac_bits fractional bits, rounding to nearest
+/// and saturating to the range of T
+template <typename T, typename U>
+T quantize_fixed(U value, int frac_bits = typebits<T>::bits - 1)
+{
+    const double scaled = std::floor(double(value) * std::ldexp(1.0, frac_bits) + 0.5);
+    if (scaled >= double(std::numeric_limits<T>::max()))
+        return std::numeric_limits<T>::max();
+    if (scaled <= double(std::numeric_limits<T>::min()))
+        return std::numeric_limits<T>::min();
+    return static_cast<T>(scaled);
+}
+
+/// @brief Converts values to Q15 (T = i16) or Q31 (T = i32) with rounding and saturation
+template <typename T, typename U, size_t Tag>
+univector<T> quantize_fixed(const univector<U, Tag>& values)
+{
+    univector<T> result(values.size());
+    for (size_t i = 0; i < values.size(); i++)
+        result[i] = quantize_fixed<T>(values[i]);
+    return result;
+}
+
+namespace internal
+{
+// Portable pmaddwd, x86 targets use the overloads from simd_x86.hpp for native vector sizes
+template <size_t N, KFR_ENABLE_IF(N <= 8)>
+CMT_INLINE vec<i32, N / 2> madd_pairs(const vec<i16, N>& x, const vec<i16, N>& y) noexcept
+{
+    vec<i32, N / 2> result;
+    for (size_t i = 0; i < N / 2; i++)
+        result[i] = static_cast<i32>(static_cast<u32>(i32(x[i * 2]) * y[i * 2]) +
+                                     static_cast<u32>(i32(x[i * 2 + 1]) * y[i * 2 + 1]));
+    return result;
+}
+template <size_t N, KFR_ENABLE_IF(N > 8), typename = void>
+CMT_INLINE vec<i32, N / 2> madd_pairs(const vec<i16, N>& x, const vec<i16, N>& y) noexcept
+{
+    return concat(madd_pairs(low(x), low(y)), madd_pairs(high(x), high(y)));
+}
+
+// Rounds an accumulator with frac_bits fractional bits to the nearest integer and saturates it to T
+template <typename T, int frac_bits, typename A, size_t N>
+CMT_INLINE vec<T, N> round_saturate(const vec<A, N>& acc)
+{
+    const vec<A, N> rounded = satadd(acc, vec<A, N>(A(1) << (frac_bits - 1))) >> frac_bits;
+    return static_cast<vec<T, N>>(
+        min(max(rounded, A(std::numeric_limits<T>::min())), A(std::numeric_limits<T>::max())));
+}
+
+template <typename T, KFR_ARCH_DEP>
+struct fir_fixed_state;
+
+// Q15 taps and samples, 32-bit accumulation. The delay line holds a pair (x[i], x[i + 1]) at each position,
+// so a multiply-add of two adjacent taps over consecutive outputs is a single pmaddwd without shuffles.
+// The tap count is rounded up to even with a leading zero
+template <cpu_t cpu>
+struct fir_fixed_state<i16, cpu>
+{
+    explicit fir_fixed_state(const array_ref<const i16>& taps)
+        : tapcount(align_up(taps.size(), 2)), capacity(tapcount - 1 + fir_block_size),
+          tappairs(tapcount / 2), pairs(capacity * 4)
+    {
+        // Reversed taps, oldest sample first, packed as (taps[k], taps[k + 1]) in one 32-bit value
+        univector<i16> reversed(tapcount, 0);
+        for (size_t k = 0; k < taps.size(); k++)
+            reversed[tapcount - 1 - k] = taps[k];
+        internal::builtin_memcpy(tappairs.data(), reversed.data(), tapcount * sizeof(i16));
+        reset();
+    }
+
+    void reset()
+    {
+        std::fill(pairs.begin(), pairs.end(), i16(0));
+        cursor = 0;
+        last   = 0;
+    }
+
+    void process(i16* dest, const i16* src, size_t size)
+    {
+        constexpr size_t width = platform<i32>::vector_width;
+        alignas(platform<>::native_cache_alignment) i32 acc[fir_block_size];
+        alignas(platform<>::native_cache_alignment) i16 block_pairs[fir_block_size * 2 + 2];
+        size_t offset = 0;
+        while (offset < size)
+        {
+            const size_t block = std::min(std::min(size - offset, fir_block_size), capacity - cursor);
+            // Pairs of the previous and of each new sample, the pair of the last sample is completed
+            // by the next block
+            block_pairs[0] = last;
+            for (size_t i = 0; i < block; i++)
+            {
+                block_pairs[i * 2 + 1] = src[offset + i];
+                block_pairs[i * 2 + 2] = src[offset + i];
+            }
+            last = src[offset + block - 1];
+            if (cursor > 0)
+                store_pairs(cursor - 1, block_pairs, block);
+            else
+            {
+                store_pairs(capacity - 1, block_pairs, 1);
+                store_pairs(0, block_pairs + 2, block - 1);
+            }
+
+            const i16* window = pairs.data() + (cursor + capacity - (tapcount - 1)) * 2;
+            std::fill(acc, acc + block, i32(0));
+            for (size_t k = 0; k < tappairs.size(); k++)
+            {
+                const i16* x                = window + k * 4;
+                const vec<i16, width * 2> t = bitcast<i16>(vec<i32, width>(tappairs[k]));
+                size_t n                    = 0;
+                for (; n + width <= block; n += width)
+                    write(acc + n, read<width>(acc + n) + madd_pairs(read<width * 2>(x + n * 2), t));
+                for (; n < block; n++)
+                    acc[n] += madd_pairs(read<2>(x + n * 2), slice<0, 2>(t))[0];
+            }
+            block_process(block, csizes_t<width, 1>(), [&](size_t n, auto w) {
+                constexpr size_t width = val_of(decltype(w)());
+                write(dest + offset + n, round_saturate<i16, 15>(read<width>(acc + n)));
+            });
+            cursor += block;
+            if (cursor == capacity)
+                cursor = 0;
+            offset += block;
+        }
+    }
+
+    void store_pairs(size_t position, const i16* values, size_t count)
+    {
+        internal::builtin_memcpy(pairs.data() + position * 2, values, count * 2 * sizeof(i16));
+        internal::builtin_memcpy(pairs.data() + (position + capacity) * 2, values, count * 2 * sizeof(i16));
+    }
+
+    const size_t tapcount;
+    const size_t capacity;
+    univector<i32> tappairs;
+    univector<i16> pairs;
+    size_t cursor;
+    i16 last;
+};
+
+// Q31 taps and samples, 64-bit accumulation over a mirrored delay line as in fir_state
+template <cpu_t cpu>
+struct fir_fixed_state<i32, cpu>
+{
+    explicit fir_fixed_state(const array_ref<const i32>& taps)
+        : tapcount(taps.size()), capacity(tapcount - 1 + fir_block_size), taps(tapcount),
+          delayline(capacity * 2)
+    {
+        for (size_t k = 0; k < tapcount; k++)
+            this->taps[tapcount - 1 - k] = taps[k];
+        reset();
+    }
+
+    void reset()
+    {
+        std::fill(delayline.begin(), delayline.end(), i32(0));
+        cursor = 0;
+    }
+
+    void process(i32* dest, const i32* src, size_t size)
+    {
+        constexpr size_t width = platform<i64>::vector_width;
+        alignas(platform<>::native_cache_alignment) i64 acc[fir_block_size];
+        size_t offset = 0;
+        while (offset < size)
+        {
+            const size_t block = std::min(std::min(size - offset, fir_block_size), capacity - cursor);
+            internal::builtin_memcpy(delayline.data() + cursor, src + offset, block * sizeof(i32));
+            internal::builtin_memcpy(delayline.data() + cursor + capacity, src + offset,
+                                     block * sizeof(i32));
+            const i32* window = delayline.data() + cursor + capacity - (tapcount - 1);
+            std::fill(acc, acc + block, i64(0));
+            for (size_t k = 0; k < tapcount; k++)
+            {
+                const i32* x  = window + k;
+                const i64 tap = taps[k];
+                block_process(block, csizes_t<width, 1>(), [=, &acc](size_t n, auto w) {
+                    constexpr size_t width = val_of(decltype(w)());
+                    const vec<i64, width> xn = static_cast<vec<i64, width>>(read<width>(x + n));
+                    write(acc + n, read<width>(acc + n) + xn * tap);
+                });
+            }
+            block_process(block, csizes_t<width, 1>(), [&](size_t n, auto w) {
+                constexpr size_t width = val_of(decltype(w)());
+                write(dest + offset + n, round_saturate<i32, 31>(read<width>(acc + n)));
+            });
+            cursor += block;
+            if (cursor == capacity)
+                cursor = 0;
+            offset += block;
+        }
+    }
+
+    const size_t tapcount;
+    const size_t capacity;
+    univector<i32> taps;
+    univector<i32> delayline;
+    size_t cursor;
+};
+} // namespace internal
+
+/**
+ * @brief Fixed-point FIR filter for Q15 (T = i16) or Q31 (T = i32) samples and taps. Products are accumulated
+ * without rounding in 32 bits for Q15 and 64 bits for Q31, the sum is rounded to nearest and saturated once
+ * per output, so the output is bit-exact on every target. For Q15 the sum of the absolute values
+ * of the taps must stay below 2, otherwise the accumulator wraps around
+ */
+template <typename T, KFR_ARCH_DEP>
+class filter_fir_fixed : public filter<T>
+{
+public:
+    static_assert(std::is_same<T, i16>::value || std::is_same<T, i32>::value, "T must be i16 or i32");
+
+    filter_fir_fixed(const array_ref<const T>& taps) : state(taps) {}
+
+    void reset() final { state.reset(); }
+
+protected:
+    void process_buffer(T* dest, const T* src, size_t size) final { state.process(dest, src, size); }
+    void process_expression(T* dest, const expression_pointer<T>& src, size_t size) final
+    {
+        alignas(platform<>::native_cache_alignment) T input[fir_block_size];
+        for (size_t offset = 0; offset < size; offset += fir_block_size)
+        {
+            const size_t block           = std::min(fir_block_size, size - offset);
+            make_univector(input, block) = slice(src, offset, block);
+            state.process(dest + offset, input, block);
+        }
+    }
+
+    internal::fir_fixed_state<T, cpu> state;
+};
+
+/**
+ * @brief Fixed-point cascade of biquad filters for Q15 (T = i16) or Q31 (T = i32) samples in direct form I.
+ * Coefficients are normalized by a0 and quantized with two integer bits (Q14 or Q30), so they cover
+ * the range [-2, 2). Each section sums its five products in 64 bits and rounds and saturates the result
+ * once, so the output is bit-exact on every target. Q31 products are shifted right by three guard bits
+ * before the sum, so full-scale samples cannot overflow the accumulator.
+ * Unlike biquad_filter, sections are not pipelined across vector lanes: without 64-bit vector multiplies
+ * and arithmetic shifts (before AVX-512) the scalar loop is faster
+ */
+template <typename T, KFR_ARCH_DEP>
+class biquad_filter_fixed : public filter<T>
+{
+public:
+    static_assert(std::is_same<T, i16>::value || std::is_same<T, i32>::value, "T must be i16 or i32");
+
+    template <typename U>
+    biquad_filter_fixed(const biquad_params<U>* bq, size_t count) : sections(count)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            const biquad_params<U> b = bq[i].normalized_a0();
+            sections[i].coefs[0]     = quantize_fixed<T>(b.b0, frac_bits);
+            sections[i].coefs[1]     = quantize_fixed<T>(b.b1, frac_bits);
+            sections[i].coefs[2]     = quantize_fixed<T>(b.b2, frac_bits);
+            sections[i].coefs[3]     = quantize_fixed<T>(-b.a1, frac_bits);
+            sections[i].coefs[4]     = quantize_fixed<T>(-b.a2, frac_bits);
+        }
+        reset();
+    }
+
+    template <typename U, size_t N>
+    biquad_filter_fixed(const biquad_params<U> (&bq)[N]) : biquad_filter_fixed(bq, N)
+    {
+    }
+
+    void reset() final
+    {
+        for (section& s : sections)
+            std::fill(s.state, s.state + 4, T(0));
+    }
+
+protected:
+    constexpr static int frac_bits  = typebits<T>::bits - 2;
+    constexpr static int guard_bits = std::is_same<T, i32>::value ? 3 : 0;
+    constexpr static int shift      = frac_bits - guard_bits;
+    constexpr static i64 lowest     = std::numeric_limits<T>::min();
+    constexpr static i64 highest    = std::numeric_limits<T>::max();
+
+    // Each product is at most 2^(2 * bits - 2), so five of them sum to less than 2^63 after the guard shift
+    CMT_INLINE static i64 product(T x, T coef) { return (i64(x) * coef) >> guard_bits; }
+
+    void process_buffer(T* dest, const T* src, size_t size) final
+    {
+        for (size_t i = 0; i < size; i++)
+        {
+            T x = src[i];
+            for (section& s : sections)
+            {
+                // state holds x[n - 1], x[n - 2], y[n - 1], y[n - 2]
+                const i64 acc = product(x, s.coefs[0]) + product(s.state[0], s.coefs[1]) +
+                                product(s.state[1], s.coefs[2]) + product(s.state[2], s.coefs[3]) +
+                                product(s.state[3], s.coefs[4]);
+                // The headroom left by the guard bits also covers the rounding term
+                const i64 rounded = (acc + (i64(1) << (shift - 1))) >> shift;
+                const T y         = static_cast<T>(std::min(std::max(rounded, i64(lowest)), i64(highest)));
+                s.state[1] = s.state[0];
+                s.state[0] = x;
+                s.state[3] = s.state[2];
+                s.state[2] = y;
+                x          = y;
+            }
+            dest[i] = x;
+        }
+    }
+    void process_expression(T* dest, const expression_pointer<T>& src, size_t size) final
+    {
+        alignas(platform<>::native_cache_alignment) T input[fir_block_size];
+        for (size_t offset = 0; offset < size; offset += fir_block_size)
+        {
+            const size_t block           = std::min(fir_block_size, size - offset);
+            make_univector(input, block) = slice(src, offset, block);
+            process_buffer(dest + offset, input, block);
+        }
+    }
+
+    struct section
+    {
+        T coefs[5];
+        T state[4];
+    };
+    std::vector<section> sections;
+};
+} // namespace kfr
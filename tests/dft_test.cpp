@@ -10,6 +10,8 @@
 #include <kfr/dft.hpp>
 #include <kfr/dsp.hpp>
 #include <kfr/io.hpp>
+#include <complex>
+#include <thread>
 
 using namespace kfr;
 
@@ -38,6 +40,203 @@ TEST(test_fft_convolve)
     CHECK(rms(dest - univector<fbase>({ 0.25, 1., 2.75, 2.5, 3.75 })) < 0.0001);
 }
 
+TEST(fft_convolve_buffered)
+{
+    testo::matrix(named("type") = dft_float_types, named("chunk") = std::vector<size_t>{ 1, 32, 100, 256 },
+                  [](auto type, size_t chunk) {
+                      using float_type = type_of<decltype(type)>;
+                      univector<float_type> ir(1000);
+                      univector<float_type> in(3000);
+                      for (size_t i = 0; i < ir.size(); i++)
+                          ir[i] = float_type(std::sin(i * 0.731) * std::exp(-double(i) / ir.size()));
+                      for (size_t i = 0; i < in.size(); i++)
+                          in[i] = float_type(std::cos(i * 1.37 + 0.1 * i * i));
+                      const univector<float_type> ref = convolve(in, ir);
+
+                      convolve_filter<float_type> filter(ir, 256, true);
+                      univector<float_type> out(in.size());
+                      for (size_t i = 0; i < in.size(); i += chunk)
+                          filter.apply(out.data() + i, in.data() + i, std::min(chunk, in.size() - i));
+                      const size_t latency = filter.latency();
+                      CHECK(latency == 256);
+                      CHECK(rms(out.slice(0, latency)) == 0);
+                      CHECK(rms(out.slice(latency) - ref.slice(0, in.size() - latency)) <
+                            std::numeric_limits<float_type>::epsilon() * 100);
+                  });
+}
+
+TEST(fft_convolve_swap)
+{
+    testo::matrix(named("type") = dft_float_types, named("buffered") = std::make_tuple(false, true),
+                  named("chunk") = std::vector<size_t>{ 1, 100, 256 },
+                  [](auto type, bool buffered, size_t chunk) {
+                      using float_type  = type_of<decltype(type)>;
+                      const size_t block = 256;
+                      univector<float_type> ir1(1000);
+                      univector<float_type> ir2(600);
+                      univector<float_type> in(3000);
+                      for (size_t i = 0; i < ir1.size(); i++)
+                          ir1[i] = float_type(std::sin(i * 0.731) * std::exp(-double(i) / ir1.size()));
+                      for (size_t i = 0; i < ir2.size(); i++)
+                          ir2[i] = float_type(std::cos(i * 0.25) * std::exp(-double(i) / ir2.size()));
+                      for (size_t i = 0; i < in.size(); i++)
+                          in[i] = float_type(std::cos(i * 1.37 + 0.1 * i * i));
+                      const univector<float_type> ref1 = convolve(in, ir1);
+                      const univector<float_type> ref2 = convolve(in, ir2);
+
+                      convolve_filter<float_type> filter(ir1, block, buffered);
+                      univector<float_type> out(in.size());
+                      const size_t swap = block * 2;
+                      size_t processed = 0;
+                      while (processed < in.size())
+                      {
+                          if (processed == swap)
+                          {
+                              CHECK(!filter.prepare_data(univector<float_type>(1001)));
+                              CHECK(filter.prepare_data(ir2));
+                              CHECK(!filter.prepare_data(ir2));
+                          }
+                          const size_t end   = processed < swap ? swap : in.size();
+                          const size_t count = std::min(chunk, end - processed);
+                          filter.apply(out.data() + processed, in.data() + processed, count);
+                          processed += count;
+                      }
+
+                      // ir1 before the swap, linear crossfade during one block, ir2 afterwards
+                      univector<float_type> ref(in.size());
+                      for (size_t i = 0; i < in.size(); i++)
+                      {
+                          const double fade = std::min(std::max((double(i) - swap + 1) / block, 0.0), 1.0);
+                          ref[i]            = float_type(ref1[i] * (1 - fade) + ref2[i] * fade);
+                      }
+                      const size_t latency = filter.latency();
+                      CHECK(rms(out.slice(latency) - ref.slice(0, in.size() - latency)) <
+                            std::numeric_limits<float_type>::epsilon() * 100);
+                      CHECK(filter.prepare_data(ir1));
+                  });
+}
+
+TEST(convolve_matrix)
+{
+    testo::matrix(named("type") = dft_float_types, named("chunk") = std::vector<size_t>{ 1, 100, 256 },
+                  [](auto type, size_t chunk) {
+                      using float_type            = type_of<decltype(type)>;
+                      const size_t length         = 2000;
+                      const size_t inputs         = 3;
+                      const size_t outputs        = 2;
+                      const size_t ir_sizes[3][2] = { { 700, 100 }, { 0, 1000 }, { 300, 1 } };
+                      std::vector<std::vector<univector<float_type>>> irs(inputs);
+                      std::vector<univector<float_type>> in(inputs, univector<float_type>(length));
+                      std::vector<univector<float_type>> out(outputs, univector<float_type>(length));
+                      std::vector<univector<float_type>> ref(outputs, univector<float_type>(length, 0));
+                      for (size_t i = 0; i < inputs; i++)
+                      {
+                          for (size_t n = 0; n < length; n++)
+                              in[i][n] = float_type(std::cos(n * 1.37 + 0.1 * n * n + i));
+                          for (size_t o = 0; o < outputs; o++)
+                          {
+                              univector<float_type> ir(ir_sizes[i][o]);
+                              for (size_t n = 0; n < ir.size(); n++)
+                                  ir[n] = float_type(std::sin(n * 0.731 + o) *
+                                                     std::exp(-double(n) / ir.size()));
+                              if (!ir.empty())
+                              {
+                                  const univector<float_type> conv = convolve(in[i], ir);
+                                  ref[o] = ref[o] + conv.slice(0, length);
+                              }
+                              irs[i].push_back(ir);
+                          }
+                      }
+
+                      convolve_matrix<float_type> matrix(irs, 256);
+                      CHECK(matrix.inputs() == inputs);
+                      CHECK(matrix.outputs() == outputs);
+                      const size_t latency = matrix.latency();
+                      for (size_t n = 0; n < length; n += chunk)
+                      {
+                          const float_type* in_ptrs[inputs] = { in[0].data() + n, in[1].data() + n,
+                                                                in[2].data() + n };
+                          float_type* out_ptrs[outputs]     = { out[0].data() + n, out[1].data() + n };
+                          matrix.apply(out_ptrs, in_ptrs, std::min(chunk, length - n));
+                      }
+                      for (size_t o = 0; o < outputs; o++)
+                      {
+                          CHECK(rms(out[o].slice(0, latency)) == 0);
+                          CHECK(rms(out[o].slice(latency) - ref[o].slice(0, length - latency)) <
+                                std::numeric_limits<float_type>::epsilon() * 100);
+                      }
+                  });
+}
+
+TEST(nonuniform_convolve)
+{
+    testo::matrix(named("type") = dft_float_types, named("background") = std::make_tuple(false, true),
+                  named("chunk") = std::vector<size_t>{ 1, 37, 256 },
+                  [](auto type, bool background, size_t chunk) {
+                      using float_type = type_of<decltype(type)>;
+                      univector<float_type> ir(5000);
+                      univector<float_type> in(8000);
+                      for (size_t i = 0; i < ir.size(); i++)
+                          ir[i] = float_type(std::sin(i * 0.731) * std::exp(-double(i) / ir.size()));
+                      for (size_t i = 0; i < in.size(); i++)
+                          in[i] = float_type(std::cos(i * 1.37 + 0.1 * i * i));
+                      const univector<float_type> ref = convolve(in, ir);
+
+                      nonuniform_convolve_filter<float_type> filter(ir, 32, 512, background);
+                      univector<float_type> out(in.size());
+                      for (size_t i = 0; i < in.size(); i += chunk)
+                          filter.apply(out.data() + i, in.data() + i, std::min(chunk, in.size() - i));
+                      const size_t latency = filter.latency();
+                      CHECK(latency == 32);
+                      CHECK(rms(out.slice(0, latency)) == 0);
+                      CHECK(rms(out.slice(latency) - ref.slice(0, in.size() - latency)) <
+                            std::numeric_limits<float_type>::epsilon() * 100);
+                      // Without the background thread nothing can be late
+                      if (!background)
+                          CHECK(filter.late() == 0);
+                  });
+}
+
+TEST(partitioned_lms)
+{
+    testo::matrix(named("type") = dft_float_types, named("chunk") = std::vector<size_t>{ 1, 100, 256 },
+                  [](auto type, size_t chunk) {
+                      using float_type    = type_of<decltype(type)>;
+                      const size_t length = 20000;
+                      univector<float_type> system(300);
+                      for (size_t i = 0; i < system.size(); i++)
+                          system[i] = float_type(std::sin(i * 0.731) * std::exp(-4.0 * i / system.size()));
+                      univector<float_type> input(length);
+                      u32 seed = 1;
+                      for (size_t i = 0; i < length; i++)
+                      {
+                          seed     = seed * 1664525u + 1013904223u;
+                          input[i] = float_type((seed >> 8) / 16777216.0 - 0.5);
+                      }
+                      const univector<float_type> desired = convolve(input, system).slice(0, length);
+
+                      partitioned_lms_filter<float_type> filter(300, float_type(0.5), 64);
+                      CHECK(filter.tapcount() == 320);
+                      CHECK(filter.latency() == 64);
+                      univector<float_type> output(length);
+                      univector<float_type> error(length);
+                      for (size_t i = 0; i < length; i += chunk)
+                      {
+                          const size_t size = std::min(chunk, length - i);
+                          filter.apply(output.data() + i, error.data() + i, input.data() + i,
+                                       desired.data() + i, size);
+                      }
+                      const size_t latency = filter.latency();
+                      CHECK(rms(output.slice(0, latency)) == 0);
+                      CHECK(absmaxof(output.slice(latency) + error.slice(latency) -
+                                     desired.slice(0, length - latency)) < 1e-5);
+                      const univector<float_type> taps = filter.taps();
+                      CHECK(absmaxof(taps.slice(0, 300) - system) < 1e-4);
+                      CHECK(absmaxof(taps.slice(300)) < 1e-4);
+                      CHECK(rms(error.slice(length - 1000)) < 1e-4);
+                  });
+}
+
 TEST(test_correlate)
 {
     univector<fbase, 5> a({ 1, 2, 3, 4, 5 });
@@ -47,6 +246,49 @@ TEST(test_correlate)
     CHECK(rms(c - univector<fbase>({ 1.5, 1., 1.5, 2.5, 3.75, -4., 7.75, 3.5, 1.25 })) < 0.0001);
 }
 
+TEST(convolve_buffers)
+{
+    testo::matrix(named("type") = dft_float_types, named("size1") = std::vector<size_t>{ 1, 7, 100, 3000 },
+                  named("size2") = std::vector<size_t>{ 1, 8, 33, 500 },
+                  [](auto type, size_t size1, size_t size2) {
+                      using float_type = type_of<decltype(type)>;
+                      univector<float_type> src1(size1);
+                      univector<float_type> src2(size2);
+                      for (size_t i = 0; i < size1; i++)
+                          src1[i] = float_type(std::sin(i * 0.731 + 0.5));
+                      for (size_t i = 0; i < size2; i++)
+                          src2[i] = float_type(std::cos(i * 1.37 + 0.1 * i * i));
+                      univector<double> refconv(size1 + size2 - 1, 0);
+                      univector<double> refcorr(size1 + size2 - 1, 0);
+                      for (size_t i = 0; i < size1; i++)
+                          for (size_t j = 0; j < size2; j++)
+                          {
+                              refconv[i + j] += double(src1[i]) * src2[j];
+                              refcorr[i + size2 - 1 - j] += double(src1[i]) * src2[j];
+                          }
+
+                      univector<float_type> conv(size1 + size2 - 1);
+                      univector<float_type> corr(size1 + size2 - 1);
+                      univector<u8> temp(convolve_temp_size<float_type>(size1, size2));
+                      convolve(conv, src1, src2, temp);
+                      correlate(corr, src1, src2, temp);
+                      const double tolerance =
+                          std::numeric_limits<float_type>::epsilon() * (size1 + size2) * 4;
+                      CHECK(rms(refconv - univector<double>(conv)) < tolerance);
+                      CHECK(rms(refcorr - univector<double>(corr)) < tolerance);
+                      CHECK(rms(refconv - univector<double>(convolve(src1, src2))) < tolerance);
+                      CHECK(rms(refcorr - univector<double>(correlate(src1, src2))) < tolerance);
+                  });
+}
+
+TEST(test_autocorrelate)
+{
+    univector<fbase, 4> a({ 1, 2, 3, 4 });
+    univector<fbase> c = autocorrelate(a);
+    CHECK(c.size() == 4);
+    CHECK(rms(c - univector<fbase>({ 30, 20, 11, 4 })) < 0.0001);
+}
+
 #ifdef CMT_ARCH_ARM
 constexpr size_t stopsize = 12;
 #else
@@ -122,6 +364,485 @@ TEST(fft_accuracy)
                   });
 }
 
+TEST(dft_mixed_radix)
+{
+    random_bit_generator gen(2247448713, 915890490, 864203735, 2982561);
+
+    testo::matrix(named("type")    = dft_float_types, //
+                  named("inverse") = std::make_tuple(false, true), //
+                  named("size")    = std::vector<size_t>{ 3,   5,   6,   7,   9,   10,  11,   12,   15,  18,
+                                                       30,  33,  45,  49,  96,  100, 143,  480,  960, 1764,
+                                                       127, 211, 422, 1021, 2062 },
+                  [&gen](auto type, bool inverse, size_t size) {
+                      using float_type  = type_of<decltype(type)>;
+                      const double ops     = std::log2(size) * 100;
+                      const double epsilon = std::numeric_limits<float_type>::epsilon();
+
+                      {
+                          univector<complex<float_type>> in =
+                              truncate(gen_random_range<float_type>(gen, -1.0, +1.0), size);
+                          univector<complex<float_type>> out    = in;
+                          univector<complex<float_type>> refout = out;
+                          const dft_plan<float_type> dft(size);
+                          univector<u8> temp(dft.temp_size);
+
+                          reference_dft(refout.data(), in.data(), size, inverse);
+                          dft.execute(out, out, temp, inverse);
+                          CHECK(rms(cabs(refout - out)) < epsilon * ops);
+
+                          out = scalar(qnan);
+                          dft.execute(out, in, temp, inverse);
+                          CHECK(rms(cabs(refout - out)) < epsilon * ops);
+                      }
+
+                      if (is_even(size))
+                      {
+                          univector<float_type> in =
+                              truncate(gen_random_range<float_type>(gen, -1.0, +1.0), size);
+                          univector<complex<float_type>> cin    = in;
+                          univector<complex<float_type>> out    = truncate(scalar(qnan), size);
+                          univector<complex<float_type>> refout = truncate(scalar(qnan), size);
+                          const dft_plan_real<float_type> dft(size);
+                          univector<u8> temp(dft.temp_size);
+
+                          reference_dft(refout.data(), cin.data(), size);
+                          dft.execute(out, in, temp);
+                          CHECK(rms(cabs(refout.truncate(size / 2 + 1) - out.truncate(size / 2 + 1))) <
+                                epsilon * ops * 2);
+
+                          univector<float_type> out2(size, 0.f);
+                          dft.execute(out2, out, temp);
+                          out2 = out2 / size;
+                          CHECK(rms(in - out2) < epsilon * ops * 2);
+                      }
+                  });
+}
+
+TEST(dft_batch)
+{
+    random_bit_generator gen(2247448713, 915890490, 864203735, 2982561);
+
+    testo::matrix(named("type")    = dft_float_types, //
+                  named("inverse") = std::make_tuple(false, true), //
+                  named("size")    = std::vector<size_t>{ 8, 16, 64, 96, 128, 512 },
+                  [&gen](auto type, bool inverse, size_t size) {
+                      using float_type     = type_of<decltype(type)>;
+                      const double epsilon = std::numeric_limits<float_type>::epsilon();
+                      const size_t count   = 19;
+                      const size_t stride  = size + 3;
+
+                      {
+                          univector<complex<float_type>> in =
+                              truncate(gen_random_range<float_type>(gen, -1.0, +1.0), stride * count);
+                          univector<complex<float_type>> out    = truncate(scalar(qnan), stride * count);
+                          univector<complex<float_type>> refout = out;
+                          const dft_plan<float_type> dft(size);
+                          univector<u8> temp(dft.batch_temp_size);
+
+                          std::vector<complex<float_type>*> outptrs(count);
+                          std::vector<const complex<float_type>*> inptrs(count);
+                          for (size_t i = 0; i < count; i++)
+                          {
+                              outptrs[i] = out.data() + (count - 1 - i) * stride;
+                              inptrs[i]  = in.data() + i * stride;
+                              dft.execute(refout.data() + i * stride, in.data() + i * stride, temp.data(),
+                                          inverse);
+                          }
+                          dft.execute_batch(out.data(), in.data(), temp.data(), count, stride, stride,
+                                            inverse);
+                          for (size_t i = 0; i < count; i++)
+                              CHECK(rms(cabs(refout.slice(i * stride, size) - out.slice(i * stride, size))) <
+                                    epsilon * size);
+
+                          dft.execute_batch(outptrs.data(), inptrs.data(), temp.data(), count, inverse);
+                          for (size_t i = 0; i < count; i++)
+                              CHECK(rms(cabs(refout.slice(i * stride, size) -
+                                             out.slice((count - 1 - i) * stride, size))) < epsilon * size);
+                      }
+
+                      if (!inverse)
+                      {
+                          const size_t cstride = size / 2 + 1;
+                          univector<float_type> in =
+                              truncate(gen_random_range<float_type>(gen, -1.0, +1.0), stride * count);
+                          univector<complex<float_type>> out    = truncate(scalar(qnan), cstride * count);
+                          univector<complex<float_type>> refout = out;
+                          univector<float_type> back            = truncate(scalar(qnan), size * count);
+                          const dft_plan_real<float_type> dft(size);
+                          univector<u8> temp(dft.batch_temp_size);
+
+                          for (size_t i = 0; i < count; i++)
+                              dft.execute(refout.data() + i * cstride, in.data() + i * stride, temp.data());
+                          dft.execute_batch(out.data(), in.data(), temp.data(), count, cstride, stride);
+                          CHECK(rms(cabs(refout - out)) < epsilon * size);
+
+                          dft.execute_batch(back.data(), out.data(), temp.data(), count, size, cstride);
+                          for (size_t i = 0; i < count; i++)
+                              CHECK(rms(in.slice(i * stride, size) - back.slice(i * size, size) / size) <
+                                    epsilon * size);
+                      }
+                  });
+}
+
+TEST(dft_fourstep)
+{
+    random_bit_generator gen(2247448713, 915890490, 864203735, 2982561);
+
+    testo::matrix(named("type")    = dft_float_types, //
+                  named("inverse") = std::make_tuple(false, true), //
+                  [&gen](auto type, bool inverse) {
+                      using float_type     = type_of<decltype(type)>;
+                      const size_t size    = size_t(1) << 22;
+                      const double epsilon = std::numeric_limits<float_type>::epsilon();
+
+                      univector<complex<float_type>> in =
+                          truncate(gen_random_range<float_type>(gen, -1.0, +1.0), size);
+                      univector<complex<float_type>> out    = truncate(scalar(qnan), size);
+                      univector<complex<float_type>> refout = truncate(scalar(qnan), size);
+                      const dft_plan<float_type> dft(size, dft_type::both, 3);
+                      const dft_plan<float_type> refdft(size);
+                      univector<u8> temp(std::max(dft.temp_size, refdft.temp_size));
+
+                      refdft.execute(refout, in, temp, inverse);
+                      const double norm = rms(cabs(refout));
+                      // Concurrent calls share the worker threads
+                      univector<complex<float_type>> other_out = truncate(scalar(qnan), size);
+                      univector<u8> other_temp(dft.temp_size);
+                      std::thread other([&]() { dft.execute(other_out, in, other_temp, inverse); });
+                      dft.execute(out, in, temp, inverse);
+                      other.join();
+                      CHECK(rms(cabs(refout - out)) < norm * epsilon * 22 * 10);
+                      CHECK(rms(cabs(refout - other_out)) < norm * epsilon * 22 * 10);
+
+                      dft.execute(in, in, temp, inverse);
+                      CHECK(rms(cabs(refout - in)) < norm * epsilon * 22 * 10);
+                  });
+}
+
+template <typename T>
+static void reference_dft_md(complex<T>* out, const complex<T>* in, const std::vector<size_t>& shape,
+                             size_t size, bool inverse)
+{
+    for (size_t k = 0; k < size; k++)
+    {
+        std::complex<double> sum = 0;
+        for (size_t n = 0; n < size; n++)
+        {
+            double phase = 0;
+            for (size_t a = shape.size(), kk = k, nn = n; a-- > 0; kk /= shape[a], nn /= shape[a])
+                phase += double(kk % shape[a] * (nn % shape[a]) % shape[a]) / shape[a];
+            sum += std::complex<double>(in[n].real(), in[n].imag()) *
+                   std::polar(1.0, (inverse ? 2 : -2) * c_pi<double> * phase);
+        }
+        out[k] = complex<T>(static_cast<T>(sum.real()), static_cast<T>(sum.imag()));
+    }
+}
+
+TEST(dft_md)
+{
+    random_bit_generator gen(2247448713, 915890490, 864203735, 2982561);
+
+    const std::vector<std::vector<size_t>> shapes{ { 4, 8 },    { 3, 5 },    { 16, 12 },  { 1, 16 },
+                                                   { 2, 3, 4 }, { 8, 8, 8 }, { 9, 1, 10 } };
+
+    testo::matrix(named("type")    = dft_float_types, //
+                  named("inverse") = std::make_tuple(false, true), //
+                  [&gen, &shapes](auto type, bool inverse) {
+                      using float_type     = type_of<decltype(type)>;
+                      const double epsilon = std::numeric_limits<float_type>::epsilon();
+
+                      for (const std::vector<size_t>& shape : shapes)
+                      {
+                          const dft_plan_md<float_type> dft(shape);
+                          const size_t size = dft.size;
+                          univector<complex<float_type>> in =
+                              truncate(gen_random_range<float_type>(gen, -1.0, +1.0), size);
+                          univector<complex<float_type>> out    = truncate(scalar(qnan), size);
+                          univector<complex<float_type>> refout = truncate(scalar(qnan), size);
+                          univector<u8> temp(dft.temp_size);
+
+                          reference_dft_md(refout.data(), in.data(), shape, size, inverse);
+                          dft.execute(out, in, temp, inverse);
+                          CHECK(rms(cabs(refout - out)) < epsilon * size);
+                          dft.execute(in, in, temp, inverse);
+                          CHECK(rms(cabs(refout - in)) < epsilon * size);
+
+                          if (inverse || !is_even(shape.back()))
+                              continue;
+
+                          const dft_plan_md_real<float_type> rdft(shape);
+                          const size_t last  = shape.back();
+                          const size_t clast = last / 2 + 1;
+                          univector<float_type> rin =
+                              truncate(gen_random_range<float_type>(gen, -1.0, +1.0), size);
+                          univector<complex<float_type>> cin = rin;
+                          univector<complex<float_type>> rout(rdft.complex_size);
+                          univector<float_type> back(size);
+                          univector<u8> rtemp(rdft.temp_size);
+
+                          reference_dft_md(refout.data(), cin.data(), shape, size, false);
+                          rdft.execute(rout, rin, rtemp);
+                          for (size_t r = 0; r < size / last; r++)
+                              CHECK(rms(cabs(refout.slice(r * last, clast) - rout.slice(r * clast, clast))) <
+                                    epsilon * size);
+                          rdft.execute(back, rout, rtemp);
+                          CHECK(rms(rin - back / size) < epsilon * size);
+                      }
+                  });
+}
+
+TEST(dft_md_invalid_shape)
+{
+    for (const std::vector<size_t>& shape :
+         std::vector<std::vector<size_t>>{ {}, { 0 }, { 4, 0, 8 }, { 8, 0 } })
+    {
+        const dft_plan_md<float> dft(shape);
+        CHECK(dft.shape.empty());
+        CHECK(dft.size == 0);
+        CHECK(dft.temp_size == 0);
+        dft.execute(nullptr, nullptr, nullptr);
+
+        const dft_plan_md_real<float> rdft(shape);
+        CHECK(rdft.shape.empty());
+        CHECK(rdft.size == 0);
+        CHECK(rdft.complex_size == 0);
+        rdft.execute(static_cast<complex<float>*>(nullptr), static_cast<const float*>(nullptr), nullptr);
+    }
+    // The last extent of a real transform must be even
+    CHECK(dft_plan_md_real<float>({ 4, 5 }).size == 0);
+    CHECK(dft_plan_md_real<float>({ 4, 6 }).size == 24);
+}
+
+TEST(dft_split)
+{
+    random_bit_generator gen(2247448713, 915890490, 864203735, 2982561);
+
+    // 7, 143 and 210 are mixed-radix plans of one, two and four stages
+    testo::matrix(named("type")    = dft_float_types, //
+                  named("inverse") = std::make_tuple(false, true), //
+                  named("size")    = std::vector<size_t>{ 16, 256, 512, 1024, 2048, 8192, 7, 143, 210, 960,
+                                                           1021 },
+                  [&gen](auto type, bool inverse, size_t size) {
+                      using float_type = type_of<decltype(type)>;
+                      const dft_plan<float_type> dft(size);
+                      univector<complex<float_type>> in =
+                          truncate(gen_random_range<float_type>(gen, -1.0, +1.0), size);
+                      univector<complex<float_type>> refout(size);
+                      univector<float_type> re(size);
+                      univector<float_type> im(size);
+                      univector<float_type> out_re(size);
+                      univector<float_type> out_im(size);
+                      for (size_t i = 0; i < size; i++)
+                      {
+                          re[i] = in[i].real();
+                          im[i] = in[i].imag();
+                      }
+                      univector<u8> temp(std::max(dft.temp_size, dft.split_temp_size));
+                      dft.execute(refout, in, temp, inverse);
+                      dft.execute(out_re, out_im, re, im, temp, inverse);
+                      float_type error = 0;
+                      for (size_t i = 0; i < size; i++)
+                          error = std::max(error, cabs(refout[i] - make_complex(out_re[i], out_im[i])));
+                      CHECK(error < std::numeric_limits<float_type>::epsilon() * size);
+                  });
+}
+
+TEST(dft_wisdom)
+{
+    random_bit_generator gen(2247448713, 915890490, 864203735, 2982561);
+
+    dft_cache& cache = dft_cache::instance();
+    const std::vector<size_t> sizes{ 256, 960, 1021, 6144 };
+    for (size_t size : sizes)
+    {
+        cache.get(ctype<float>, size);
+        cache.get(ctype<double>, size);
+        cache.getreal(ctype<float>, size * 2);
+    }
+    std::vector<u8> blob = cache.save_wisdom();
+    const char* path     = "dft_test_wisdom.bin";
+    CHECK(cache.save_wisdom(path));
+
+    // the layout block of the first plan in the blob does not match, that plan is recalculated
+    std::vector<u8> mismatched = blob;
+    mismatched[2 * dft_data_alignment] ^= 1;
+    // an owned blob that is not aligned is copied instead of being used in place
+    const std::shared_ptr<std::vector<u8>> unaligned = std::make_shared<std::vector<u8>>(blob.size() + 1);
+    std::copy(blob.begin(), blob.end(), unaligned->begin() + 1);
+
+    for (int mode = 0; mode < 5; mode++)
+    {
+        cache.clear();
+        const bool ok = mode == 0   ? cache.load_wisdom(blob.data(), blob.size())
+                        : mode == 3 ? cache.load_wisdom(mismatched.data(), mismatched.size())
+                        : mode == 4 ? cache.load_wisdom(unaligned->data() + 1, blob.size(), unaligned)
+                                    : cache.load_wisdom(path, mode == 1);
+        CHECK(ok);
+        for (size_t size : sizes)
+        {
+            const dft_plan<float> dft(size);
+            const dft_plan_ptr<float> loaded = cache.get(ctype<float>, size);
+            univector<complex<float>> in     = truncate(gen_random_range<float>(gen, -1.0, +1.0), size);
+            univector<complex<float>> out(size);
+            univector<complex<float>> refout(size);
+            univector<u8> temp(std::max(dft.temp_size, loaded->temp_size));
+            dft.execute(refout, in, temp);
+            loaded->execute(out, in, temp);
+            CHECK(rms(cabs(refout - out)) == 0);
+
+            const dft_plan_real<float> rdft(size * 2);
+            const dft_plan_real_ptr<float> rloaded = cache.getreal(ctype<float>, size * 2);
+            univector<float> rin = truncate(gen_random_range<float>(gen, -1.0, +1.0), size * 2);
+            univector<complex<float>> rout(size + 1);
+            univector<complex<float>> rrefout(size + 1);
+            univector<u8> rtemp(std::max(rdft.temp_size, rloaded->temp_size));
+            rdft.execute(rrefout, rin, rtemp);
+            rloaded->execute(rout, rin, rtemp);
+            CHECK(rms(cabs(rrefout - rout)) == 0);
+        }
+    }
+    std::remove(path);
+
+    std::vector<u8> bad_record = blob;
+    bad_record[dft_data_alignment + offsetof(internal::dft_wisdom_record, type_size)] = 3;
+    CHECK(!cache.load_wisdom(bad_record.data(), bad_record.size()));
+    std::vector<u8> bad_header = blob;
+    bad_header[offsetof(internal::dft_wisdom_header, record_size)] += 8;
+    CHECK(!cache.load_wisdom(bad_header.data(), bad_header.size()));
+
+    blob[0] = 0;
+    CHECK(!cache.load_wisdom(blob.data(), blob.size()));
+    CHECK(!cache.load_wisdom(blob.data(), 16));
+    cache.clear();
+}
+
+TEST(dft_cache)
+{
+    dft_cache& cache = dft_cache::instance();
+    cache.clear();
+    const dft_cache_stats initial = cache.stats();
+
+    const dft_plan_ptr<float> plan           = cache.get(ctype<float>, 1024);
+    const dft_plan_ptr<double> plan64        = cache.get(ctype<double>, 1024);
+    const dft_plan_real_ptr<float> real_plan = cache.getreal(ctype<float>, 960);
+    CHECK(cache.get(ctype<float>, 1024) == plan);
+    dft_cache_stats stats = cache.stats();
+    CHECK(stats.hits - initial.hits == 1);
+    CHECK(stats.misses - initial.misses == 3);
+    CHECK(stats.count == 3);
+    CHECK(stats.bytes == plan->data_memory() + plan64->data_memory() + real_plan->data_memory());
+
+    // the real plan is the least recently used one
+    cache.set_budget(stats.bytes);
+    cache.get(ctype<float>, 1024);
+    cache.get(ctype<double>, 1024);
+    cache.get(ctype<float>, 16);
+    stats = cache.stats();
+    CHECK(stats.evictions - initial.evictions == 1);
+    CHECK(stats.count == 3);
+    CHECK(cache.get(ctype<float>, 1024) == plan);
+
+    cache.set_budget(0);
+    stats = cache.stats();
+    CHECK(stats.count == 0);
+    CHECK(stats.bytes == 0);
+    // evicted plans stay valid
+    univector<complex<float>> in(1024, 1.f);
+    univector<complex<float>> out(1024);
+    univector<u8> temp(plan->temp_size);
+    plan->execute(out, in, temp);
+    CHECK(out[0] == complex<float>(1024.f));
+
+    cache.set_budget(std::numeric_limits<size_t>::max());
+}
+
+TEST(dct)
+{
+    testo::matrix(named("type") = dft_float_types, named("sine") = std::make_tuple(false, true),
+                  named("size") = std::vector<size_t>{ 4, 6, 16, 18, 64, 960 },
+                  [](auto type, bool sine, size_t size) {
+                      using float_type = type_of<decltype(type)>;
+                      const double pi  = c_pi<double>;
+                      const double N   = size;
+                      univector<float_type> in(size);
+                      for (size_t i = 0; i < size; i++)
+                          in[i] = float_type(std::sin(i * 1.7 + 0.3) + 0.1 * i);
+                      for (dct_type kind : { dct_type::II, dct_type::III, dct_type::IV })
+                      {
+                          const dct_plan<float_type> plan(size, kind);
+                          univector<u8> temp(plan.temp_size);
+                          univector<float_type> out(size);
+                          univector<double> refout(size);
+                          if (sine)
+                              plan.execute_dst(out, in, temp);
+                          else
+                              plan.execute(out, in, temp);
+                          for (size_t k = 0; k < size; k++)
+                          {
+                              double sum = 0;
+                              for (size_t n = 0; n < size; n++)
+                              {
+                                  if (kind == dct_type::II)
+                                      sum += in[n] * (sine ? std::sin(pi / N * (n + 0.5) * (k + 1))
+                                                           : std::cos(pi / N * (n + 0.5) * k));
+                                  else if (kind == dct_type::IV)
+                                      sum += in[n] * (sine ? std::sin(pi / N * (n + 0.5) * (k + 0.5))
+                                                           : std::cos(pi / N * (n + 0.5) * (k + 0.5)));
+                                  else if (!sine)
+                                      sum += n == 0 ? in[0] * 0.5 : in[n] * std::cos(pi / N * (k + 0.5) * n);
+                                  else if (n == size - 1)
+                                      sum += (k % 2 ? -0.5 : 0.5) * in[n];
+                                  else
+                                      sum += in[n] * std::sin(pi / N * (k + 0.5) * (n + 1));
+                              }
+                              refout[k] = sum;
+                          }
+                          const double error = rms(refout - univector<double>(out)) / rms(refout);
+                          CHECK(error < std::numeric_limits<float_type>::epsilon() * size);
+                      }
+                  });
+}
+
+TEST(mdct)
+{
+    testo::matrix(named("type") = dft_float_types, named("size") = std::vector<size_t>{ 4, 64, 480 },
+                  [](auto type, size_t size) {
+                      using float_type = type_of<decltype(type)>;
+                      const size_t length = size * 8;
+                      univector<float_type> window(size * 2);
+                      for (size_t i = 0; i < size * 2; i++)
+                          window[i] = float_type(std::sin(c_pi<double> / (size * 2) * (i + 0.5)));
+                      const mdct_plan<float_type> plan(size, window);
+                      univector<u8> temp(plan.temp_size);
+                      univector<float_type> in(length + size * 2, 0);
+                      univector<float_type> out(length + size * 2, 0);
+                      for (size_t i = 0; i < length; i++)
+                          in[size + i] = float_type(std::cos(i * 0.37));
+                      univector<float_type> coefs(size);
+                      univector<float_type> frame(size * 2);
+                      double error = 0;
+                      for (size_t start = 0; start + size * 2 <= in.size(); start += size)
+                      {
+                          plan.execute(coefs.data(), in.data() + start, temp.data());
+                          for (size_t k = 0; k < size; k++)
+                          {
+                              double sum = 0;
+                              for (size_t n = 0; n < size * 2; n++)
+                                  sum += window[n] * in[start + n] *
+                                         std::cos(c_pi<double> / size * (n + 0.5 + size * 0.5) * (k + 0.5));
+                              error = std::max(error, std::fabs(sum - coefs[k]) / size);
+                          }
+                          plan.execute_inverse(frame.data(), coefs.data(), temp.data());
+                          out.slice(start, size * 2) = out.slice(start, size * 2) + frame;
+                      }
+                      CHECK(error < std::numeric_limits<float_type>::epsilon() * (size + 16));
+                      // time domain aliasing cancellation restores the input scaled by size / 2
+                      const double tdac_error =
+                          rms(out.slice(size, length) * float_type(2.0 / size) - in.slice(size, length));
+                      CHECK(tdac_error < std::numeric_limits<float_type>::epsilon() * 8);
+                  });
+}
+
 #ifndef KFR_NO_MAIN
 int main()
 {
@@ -375,6 +375,685 @@ TEST(fir_complex)
     });
 }
 
+TEST(fir_block)
+{
+    // Tap count and chunk sizes straddle the kernel block size and the delay line wrap
+    univector<double> data(2000);
+    univector<double> taps(300);
+    for (size_t i = 0; i < data.size(); i++)
+        data[i] = std::sin(i * 0.37) + (i % 7) * 0.125;
+    for (size_t i = 0; i < taps.size(); i++)
+        taps[i] = std::cos(i * 0.11) / (1 + i);
+
+    auto reference = [&](size_t index) -> double {
+        double result = 0.0;
+        for (size_t i = 0; i < taps.size(); i++)
+            result += data.get(index - i, 0.0) * taps[i];
+        return result;
+    };
+
+    univector<double> output = fir(data, taps);
+    double maxerr            = 0.0;
+    for (size_t i = 0; i < data.size(); i++)
+        maxerr = std::max(maxerr, std::abs(output[i] - reference(i)));
+    CHECK(maxerr < 1e-12);
+
+    filter_fir<double> filter(taps);
+    for (int pass = 0; pass < 2; pass++)
+    {
+        const size_t chunks[] = { 1, 17, 256, 300, 5, 511, 910 };
+        size_t offset         = 0;
+        for (size_t chunk : chunks)
+        {
+            filter.apply(output.data() + offset, data.data() + offset, chunk);
+            offset += chunk;
+        }
+        CHECK(offset == data.size());
+        maxerr = 0.0;
+        for (size_t i = 0; i < data.size(); i++)
+            maxerr = std::max(maxerr, std::abs(output[i] - reference(i)));
+        CHECK(maxerr < 1e-12);
+        filter.reset();
+    }
+}
+
+TEST(fir_set_taps)
+{
+    univector<double> data(3000);
+    for (size_t i = 0; i < data.size(); i++)
+        data[i] = std::sin(i * 0.37 + 0.001 * i * i);
+    univector<double> taps1(40);
+    univector<double> taps2(25);
+    univector<double> taps3(300);
+    for (size_t i = 0; i < taps1.size(); i++)
+        taps1[i] = std::cos(i * 0.3) / (1 + i);
+    for (size_t i = 0; i < taps2.size(); i++)
+        taps2[i] = std::sin(i * 0.7 + 1) / (1 + i);
+    fir_lowpass(taps3, 0.2, to_pointer(window_kaiser(taps3.size(), 3.0)), true);
+
+    auto reference = [&](const univector<double>& taps, size_t index) -> double {
+        double result = 0.0;
+        for (size_t i = 0; i < taps.size(); i++)
+            result += data.get(index - i, 0.0) * taps[i];
+        return result;
+    };
+
+    testo::matrix(named("chunk") = std::vector<size_t>{ 1, 50, 1000 }, [&](size_t chunk) {
+        filter_fir<double> filter(taps1, 300);
+        CHECK(filter.max_tapcount() == 300);
+        univector<double> output(data.size());
+        size_t offset = 0;
+        auto run      = [&](size_t end) {
+            for (; offset < end; offset += std::min(chunk, end - offset))
+                filter.apply(output.data() + offset, data.data() + offset, std::min(chunk, end - offset));
+        };
+        // Crossfade from taps1 to taps2 over 1000..1299, from the mix reached at 1150 to taps3
+        // over 1150..1649, then switch back to taps1 at 2000 without crossfade
+        run(1000);
+        filter.set_taps(taps2, 300);
+        run(1150);
+        filter.set_taps(taps3, 500);
+        run(2000);
+        filter.set_taps(taps1);
+        run(data.size());
+
+        double maxerr = 0.0;
+        for (size_t n = 0; n < data.size(); n++)
+        {
+            double result;
+            if (n < 1000 || n >= 2000)
+                result = reference(taps1, n);
+            else if (n < 1150)
+                result = mix((n - 999) / 300.0, reference(taps1, n), reference(taps2, n));
+            else if (n < 1650)
+                result = mix((n - 1149) / 500.0, mix(0.5, reference(taps1, n), reference(taps2, n)),
+                             reference(taps3, n));
+            else
+                result = reference(taps3, n);
+            maxerr = std::max(maxerr, std::abs(output[n] - result));
+        }
+        CHECK(maxerr < 1e-12);
+    });
+
+    // Longer taps than the delay line holds reallocate and clear the history
+    filter_fir<double> filter(taps2);
+    univector<double> output(data.size());
+    filter.apply(output, data);
+    filter.set_taps(taps1, 100);
+    CHECK(filter.max_tapcount() == taps1.size());
+    filter.apply(output, data);
+    double maxerr = 0.0;
+    for (size_t n = 0; n < data.size(); n++)
+        maxerr = std::max(maxerr, std::abs(output[n] - reference(taps1, n)));
+    CHECK(maxerr < 1e-12);
+    // The grown bound is kept for later updates
+    filter.set_taps(taps2, 100);
+    CHECK(filter.max_tapcount() == taps1.size());
+}
+
+TEST(fir_multichannel)
+{
+    testo::matrix(named("channels") = std::vector<size_t>{ 1, 3, 8, 19 },
+                  named("tapcount") = std::vector<size_t>{ 1, 7, 300 },
+                  [](size_t channels, size_t tapcount) {
+                      const size_t size = 700;
+                      univector<double> taps(tapcount);
+                      for (size_t i = 0; i < tapcount; i++)
+                          taps[i] = std::cos(i * 0.11) / (1 + i);
+                      std::vector<univector<double>> data(channels);
+                      for (size_t ch = 0; ch < channels; ch++)
+                      {
+                          data[ch].resize(size);
+                          for (size_t i = 0; i < size; i++)
+                              data[ch][i] = std::sin(i * 0.37 + ch) + ((i + ch) % 7) * 0.125;
+                      }
+                      auto reference = [&](size_t ch, size_t index) -> double {
+                          double result = 0.0;
+                          for (size_t i = 0; i < tapcount; i++)
+                              result += data[ch].get(index - i, 0.0) * taps[i];
+                          return result;
+                      };
+
+                      filter_fir_multichannel<double> filter(taps, channels);
+                      CHECK(filter.channels() == channels);
+
+                      std::vector<univector<double>> planar(channels, univector<double>(size));
+                      std::vector<double*> out(channels);
+                      std::vector<const double*> in(channels);
+                      univector<double> interleaved_in(size * channels);
+                      univector<double> interleaved_out(size * channels);
+                      for (size_t ch = 0; ch < channels; ch++)
+                      {
+                          out[ch] = planar[ch].data();
+                          in[ch]  = data[ch].data();
+                          for (size_t i = 0; i < size; i++)
+                              interleaved_in[i * channels + ch] = data[ch][i];
+                      }
+                      const size_t chunks[] = { 1, 100, 256, 343 };
+                      size_t offset         = 0;
+                      for (size_t chunk : chunks)
+                      {
+                          for (size_t ch = 0; ch < channels; ch++)
+                          {
+                              out[ch] = planar[ch].data() + offset;
+                              in[ch]  = data[ch].data() + offset;
+                          }
+                          filter.apply(out.data(), in.data(), chunk);
+                          offset += chunk;
+                      }
+                      filter.reset();
+                      filter.apply_interleaved(interleaved_out.data(), interleaved_in.data(), size);
+
+                      double maxerr = 0.0;
+                      for (size_t ch = 0; ch < channels; ch++)
+                          for (size_t i = 0; i < size; i++)
+                          {
+                              const double ref = reference(ch, i);
+                              maxerr           = std::max(maxerr, std::abs(planar[ch][i] - ref));
+                              maxerr = std::max(maxerr, std::abs(interleaved_out[i * channels + ch] - ref));
+                          }
+                      CHECK(maxerr < 1e-12);
+                  });
+}
+
+TEST(fir_polyphase)
+{
+    testo::matrix(named("factor") = std::vector<size_t>{ 1, 2, 3, 5 },
+                  named("tapcount") = std::vector<size_t>{ 1, 31, 300 },
+                  [](size_t factor, size_t tapcount) {
+                      univector<double> taps(tapcount);
+                      for (size_t i = 0; i < tapcount; i++)
+                          taps[i] = std::cos(i * 0.11) / (1 + i);
+                      univector<double> data(1500);
+                      for (size_t i = 0; i < data.size(); i++)
+                          data[i] = std::sin(i * 0.37) + (i % 7) * 0.125;
+                      const size_t chunks[] = { 1, 2, 700, 3, 794 };
+
+                      const univector<double> filtered = fir(data, taps);
+                      filter_fir_decimator<double> decimator(taps, factor);
+                      univector<double> decimated(data.size() / factor + 1);
+                      size_t offset  = 0;
+                      size_t written = 0;
+                      for (size_t chunk : chunks)
+                      {
+                          const size_t expected = decimator.output_size(chunk);
+                          const size_t count =
+                              decimator.apply(decimated.data() + written, data.data() + offset, chunk);
+                          CHECK(count == expected);
+                          offset += chunk;
+                          written += count;
+                      }
+                      CHECK(written == (data.size() + factor - 1) / factor);
+                      double maxerr = 0.0;
+                      for (size_t i = 0; i < written; i++)
+                          maxerr = std::max(maxerr, std::abs(decimated[i] - filtered[i * factor]));
+                      CHECK(maxerr < 1e-12);
+
+                      univector<double> stuffed(data.size() * factor, 0.0);
+                      for (size_t i = 0; i < data.size(); i++)
+                          stuffed[i * factor] = data[i];
+                      const univector<double> reference = fir(stuffed, taps);
+                      filter_fir_interpolator<double> interpolator(taps, factor);
+                      univector<double> interpolated(stuffed.size());
+                      offset = 0;
+                      for (size_t chunk : chunks)
+                      {
+                          const size_t count = interpolator.apply(interpolated.data() + offset * factor,
+                                                                  data.data() + offset, chunk);
+                          CHECK(count == chunk * factor);
+                          offset += chunk;
+                      }
+                      CHECK(rms(interpolated - reference) < 1e-12);
+                  });
+
+    univector<float> taps(40);
+    for (size_t i = 0; i < taps.size(); i++)
+        taps[i] = std::cos(i * 0.2f) / (1 + i);
+    univector<float> data(999);
+    for (size_t i = 0; i < data.size(); i++)
+        data[i] = std::sin(i * 0.31f) + 0.5f;
+    filter_fir_decimator<float, float, 4> decimator(taps);
+    filter_fir_decimator<float> runtime_decimator(taps, 4);
+    univector<float> out1(250);
+    univector<float> out2(250);
+    CHECK(decimator.apply(out1.data(), data.data(), data.size()) == 250);
+    CHECK(runtime_decimator.apply(out2.data(), data.data(), data.size()) == 250);
+    CHECK(rms(out1 - out2) == 0);
+}
+
+TEST(fir_symmetric)
+{
+    univector<double> lowpass(127);
+    univector<double> highpass(127);
+    univector<double> bandpass(128);
+    univector<double> bandstop(127);
+    const expression_pointer<double> kaiser = to_pointer(window_kaiser(127, 3.0));
+    fir_lowpass(lowpass, 0.2, kaiser, true);
+    fir_highpass(highpass, 0.2, kaiser, true);
+    fir_bandpass(bandpass, 0.2, 0.4, to_pointer(window_kaiser(128, 3.0)), true);
+    fir_bandstop(bandstop, 0.2, 0.4, kaiser, true);
+    CHECK(fir_detect_symmetry<double>(lowpass) == fir_symmetry::symmetric);
+    CHECK(fir_detect_symmetry<double>(highpass) == fir_symmetry::symmetric);
+    CHECK(fir_detect_symmetry<double>(bandpass) == fir_symmetry::symmetric);
+    CHECK(fir_detect_symmetry<double>(bandstop) == fir_symmetry::symmetric);
+
+    univector<double> data(1000);
+    for (size_t i = 0; i < data.size(); i++)
+        data[i] = std::sin(i * 0.37) + (i % 7) * 0.125;
+
+    auto check = [&](const univector<double>& taps, fir_symmetry symmetry) {
+        CHECK(fir_detect_symmetry<double>(taps) == symmetry);
+        filter_fir<double> filter(taps);
+        univector<double> output(data.size());
+        filter.apply(output.data(), data.data(), 300);
+        filter.apply(output.data() + 300, data.data() + 300, 700);
+        double maxerr = 0.0;
+        for (size_t n = 0; n < data.size(); n++)
+        {
+            double result = 0.0;
+            for (size_t i = 0; i < taps.size(); i++)
+                result += data.get(n - i, 0.0) * taps[i];
+            maxerr = std::max(maxerr, std::abs(output[n] - result));
+        }
+        CHECK(maxerr < 1e-12);
+    };
+    check(lowpass, fir_symmetry::symmetric);
+    check(bandpass, fir_symmetry::symmetric);
+    univector<double> antisymmetric(31);
+    for (size_t i = 0; i < antisymmetric.size(); i++)
+        antisymmetric[i] = std::sin((i - 15.0) * 0.3) / (1 + i * (30 - i));
+    check(antisymmetric, fir_symmetry::antisymmetric);
+    check(antisymmetric.slice(1), fir_symmetry::none);
+    check(univector<double>{ 1, -2, 2, -1 }, fir_symmetry::antisymmetric);
+}
+
+TEST(fir_halfband)
+{
+    univector<double> taps(31);
+    CHECK(fir_halfband(taps, to_pointer(window_kaiser(taps.size(), 6.0)), true));
+    CHECK(taps[15] == 0.5);
+    CHECK(taps[0] != 0.0);
+    CHECK(taps[1] == 0.0);
+    CHECK(taps[13] == 0.0);
+    CHECK(std::abs(sum(taps) - 1.0) < 1e-12);
+    CHECK(fir_detect_symmetry<double>(taps) == fir_symmetry::symmetric);
+
+    univector<double> data(1001);
+    for (size_t i = 0; i < data.size(); i++)
+        data[i] = std::sin(i * 0.37) + (i % 7) * 0.125;
+
+    const univector<double> decimated_ref = downsample2(fir(data, taps));
+    const univector<double> decimated     = halfband_decimate2(data, taps);
+    CHECK(decimated.size() == 500);
+    CHECK(rms(decimated - decimated_ref) < 1e-12);
+
+    filter_halfband_decimator<double> decimator(taps);
+    univector<double> decimated2(501);
+    CHECK(decimator.apply(decimated2.data(), data.data(), 3) == 2);
+    CHECK(decimator.apply(decimated2.data() + 2, data.data() + 3, 998) == 499);
+    CHECK(rms(decimated2.truncate(500) - decimated_ref) < 1e-12);
+
+    const univector<double> interpolated_ref = fir(upsample2(data), taps);
+    const univector<double> interpolated     = halfband_interpolate2(data, taps);
+    CHECK(interpolated.size() == 2002);
+    CHECK(rms(interpolated - interpolated_ref) < 1e-12);
+
+    // An odd output read right after a vector read returns the last output of that read
+    auto interpolator       = halfband_interpolate2(data, taps);
+    const vec<double, 4> v4 = interpolator(cinput, 0, vec_t<double, 4>());
+    const vec<double, 1> v1 = interpolator(cinput, 3, vec_t<double, 1>());
+    CHECK(std::abs(v4[3] - interpolated_ref[3]) < 1e-12);
+    CHECK(v1[0] == v4[3]);
+
+    // Even sizes have no center tap and are rejected
+    univector<double> even(32, 1.0);
+    CHECK(!fir_halfband(even, to_pointer(window_kaiser(even.size(), 6.0)), true));
+    CHECK(absmaxof(even) == 0.0);
+}
+
+TEST(fir_sparse)
+{
+    testo::matrix(named("type") = ctypes_t<float, double>{},
+                  named("chunk") = std::vector<size_t>{ 1, 100, 1000 }, [](auto type, size_t chunk) {
+                      using T             = type_of<decltype(type)>;
+                      const size_t length = 30000;
+                      std::vector<size_t> delays;
+                      univector<T> gains;
+                      for (size_t k = 0; k < 40; k++)
+                      {
+                          delays.push_back((k * 7919 + 13) % 20000);
+                          gains.push_back(T(std::sin(k * 0.731 + 0.1)));
+                      }
+                      univector<T> input(length);
+                      for (size_t i = 0; i < length; i++)
+                          input[i] = T(std::cos(i * 1.37 + 0.1 * i * i));
+                      univector<T> ref(length, 0);
+                      for (size_t i = 0; i < length; i++)
+                          for (size_t k = 0; k < delays.size(); k++)
+                              if (delays[k] <= i)
+                                  ref[i] += gains[k] * input[i - delays[k]];
+
+                      filter_fir_sparse<T> filter(delays, gains);
+                      CHECK(filter.tapcount() == 40);
+                      CHECK(filter.length() == *std::max_element(delays.begin(), delays.end()) + 1);
+                      // In-place, the input is copied to the ring before the output is written
+                      univector<T> output = input;
+                      for (size_t i = 0; i < length; i += chunk)
+                          filter.apply(output.data() + i, std::min(chunk, length - i));
+                      CHECK(absmaxof(output - ref) < std::numeric_limits<T>::epsilon() * 100);
+
+                      filter.reset();
+                      output = input;
+                      filter.apply(output);
+                      CHECK(absmaxof(output - ref) < std::numeric_limits<T>::epsilon() * 100);
+
+                      filter.reset();
+                      filter.apply(output, to_pointer(input));
+                      CHECK(absmaxof(output - ref) < std::numeric_limits<T>::epsilon() * 100);
+                  });
+
+    // Dense taps keep only the non-zero ones and match filter_fir
+    univector<double> taps(300, 0.0);
+    taps[0]   = 0.5;
+    taps[17]  = -0.25;
+    taps[299] = 0.125;
+    univector<double> input(1000);
+    for (size_t i = 0; i < input.size(); i++)
+        input[i] = std::sin(i * 0.1);
+    filter_fir_sparse<double> sparse(taps);
+    CHECK(sparse.tapcount() == 3);
+    CHECK(sparse.length() == 300);
+    filter_fir<double> dense(taps);
+    univector<double> out1(input.size());
+    univector<double> out2(input.size());
+    sparse.apply(out1, input);
+    dense.apply(out2, input);
+    CHECK(absmaxof(out1 - out2) < 1e-14);
+}
+
+// Rounded and saturated reference for the fixed-point FIR
+template <typename T, typename Acc>
+static univector<T> fixed_fir_reference(const univector<T>& input, const univector<T>& taps)
+{
+    constexpr int shift = typebits<T>::bits - 1;
+    univector<T> result(input.size());
+    for (size_t i = 0; i < input.size(); i++)
+    {
+        Acc acc = 0;
+        for (size_t k = 0; k < taps.size() && k <= i; k++)
+            acc += Acc(taps[k]) * input[i - k];
+        acc       = (acc + (Acc(1) << (shift - 1))) >> shift;
+        result[i] = T(std::min(std::max(acc, Acc(std::numeric_limits<T>::min())),
+                               Acc(std::numeric_limits<T>::max())));
+    }
+    return result;
+}
+
+TEST(fir_fixed)
+{
+    testo::matrix(named("taps") = std::vector<size_t>{ 1, 2, 7, 64, 301 },
+                  named("chunk") = std::vector<size_t>{ 1, 77, 1000 }, [](size_t tapcount, size_t chunk) {
+                      const size_t length = 3000;
+                      univector<double> taps(tapcount);
+                      for (size_t k = 0; k < tapcount; k++)
+                          taps[k] = 0.9 * std::sin((k + 1) * 0.3) / (k + 1);
+                      univector<double> input(length);
+                      for (size_t i = 0; i < length; i++)
+                          input[i] = 0.9 * std::sin(i * 0.1 + 0.01 * i * i);
+
+                      univector<i16> taps16  = quantize_fixed<i16>(taps);
+                      univector<i16> input16 = quantize_fixed<i16>(input);
+                      univector<i16> ref16   = fixed_fir_reference<i16, i64>(input16, taps16);
+                      filter_fir_fixed<i16> fir16(taps16);
+                      univector<i16> output16(length);
+                      for (size_t i = 0; i < length; i += chunk)
+                          fir16.apply(output16.data() + i, input16.data() + i, std::min(chunk, length - i));
+                      CHECK(std::equal(output16.begin(), output16.end(), ref16.begin()));
+                      filter_fir_fixed<i16> expr16(taps16);
+                      expr16.apply(output16, to_pointer(input16));
+                      CHECK(std::equal(output16.begin(), output16.end(), ref16.begin()));
+
+                      univector<i32> taps32  = quantize_fixed<i32>(taps);
+                      univector<i32> input32 = quantize_fixed<i32>(input);
+                      univector<i32> ref32   = fixed_fir_reference<i32, __int128>(input32, taps32);
+                      filter_fir_fixed<i32> fir32(taps32);
+                      univector<i32> output32(length);
+                      for (size_t i = 0; i < length; i += chunk)
+                          fir32.apply(output32.data() + i, input32.data() + i, std::min(chunk, length - i));
+                      CHECK(std::equal(output32.begin(), output32.end(), ref32.begin()));
+                  });
+
+    CHECK(quantize_fixed<i16>(0.5) == 16384);
+    CHECK(quantize_fixed<i16>(1.0) == 32767);
+    CHECK(quantize_fixed<i16>(-1.5) == -32768);
+    CHECK(quantize_fixed<i32>(-0.25) == -536870912);
+
+    // A gain of about 2 saturates the output instead of wrapping around
+    univector<i16> taps({ 32767, 32767 });
+    univector<i16> input({ 30000, 30000, -30000, -30000, 100 });
+    filter_fir_fixed<i16> fir(taps);
+    univector<i16> output(input.size());
+    fir.apply(output, input);
+    CHECK(output[0] == 29999);
+    CHECK(output[1] == 32767);
+    CHECK(output[2] == 0);
+    CHECK(output[3] == -32768);
+    CHECK(output[4] == -29899);
+}
+
+TEST(biquad_fixed)
+{
+    const biquad_params<double> bq[] = { biquad_lowpass(0.1, 0.7), biquad_peak(0.3, 0.5, 6.0) };
+    univector<double> input(2000);
+    for (size_t i = 0; i < input.size(); i++)
+        input[i] = 0.45 * std::sin(i * 0.1 + 0.01 * i * i);
+    univector<double> ref = biquad(bq, input);
+
+    biquad_filter_fixed<i16> filter16(bq);
+    univector<i16> output16(input.size());
+    filter16.apply(output16, quantize_fixed<i16>(input));
+    double error16 = 0;
+    for (size_t i = 0; i < input.size(); i++)
+        error16 = std::max(error16, std::abs(output16[i] / 32768.0 - ref[i]));
+    CHECK(error16 < 8.0 / 32768);
+
+    biquad_filter_fixed<i32> filter32(bq);
+    univector<i32> output32(input.size());
+    filter32.apply(output32, quantize_fixed<i32>(input));
+    univector<i32> input32 = quantize_fixed<i32>(input);
+    univector<i32> expr32(input.size());
+    biquad_filter_fixed<i32>(bq).apply(expr32, to_pointer(input32));
+    CHECK(std::equal(expr32.begin(), expr32.end(), output32.begin()));
+    double error32 = 0;
+    for (size_t i = 0; i < input.size(); i++)
+        error32 = std::max(error32, std::abs(output32[i] / 2147483648.0 - ref[i]));
+    CHECK(error32 < 1e-8);
+
+    // Overload saturates
+    const biquad_params<double> gain[] = { biquad_params<double>(1.0, 0.0, 0.0, 1.9, 0.0, 0.0) };
+    biquad_filter_fixed<i16> filter(gain);
+    univector<i16> loud({ 30000, -30000 });
+    univector<i16> clipped(2);
+    filter.apply(clipped, loud);
+    CHECK(clipped[0] == 32767);
+    CHECK(clipped[1] == -32768);
+
+    // Full-scale input to a resonant section must saturate, not overflow the accumulator
+    const biquad_params<double> resonant[] = { biquad_highpass(0.1, 20.0) };
+    univector<i32> square(4000);
+    for (size_t i = 0; i < square.size(); i++)
+        square[i] = (i / 2) % 2 ? std::numeric_limits<i32>::max() : std::numeric_limits<i32>::min();
+    univector<i32> ringing(square.size());
+    biquad_filter_fixed<i32>(resonant).apply(ringing, square);
+    const biquad_params<double> b = resonant[0].normalized_a0();
+    double x1 = 0, x2 = 0, y1 = 0, y2 = 0, error = 0;
+    for (size_t i = 0; i < square.size(); i++)
+    {
+        const double x = square[i] / 2147483648.0;
+        const double y =
+            std::min(std::max(b.b0 * x + b.b1 * x1 + b.b2 * x2 - b.a1 * y1 - b.a2 * y2, -1.0), 1.0);
+        x2    = x1;
+        x1    = x;
+        y2    = y1;
+        y1    = y;
+        error = std::max(error, std::abs(ringing[i] / 2147483648.0 - y));
+    }
+    CHECK(error < 1e-7);
+}
+
+TEST(cic)
+{
+    testo::matrix(named("factor") = std::vector<size_t>{ 1, 5, 16 },
+                  named("order") = std::vector<size_t>{ 1, 4 }, named("delay") = std::vector<size_t>{ 1, 2 },
+                  [](size_t factor, size_t order, size_t delay) {
+                      for (size_t channels : { 1, 3 })
+                      {
+                          const size_t size = 400;
+                          std::vector<i16> data(size * channels);
+                          for (size_t i = 0; i < data.size(); i++)
+                              data[i] = i16((i * 7919 + 1234) % 2001) - 1000;
+
+                          // Impulse response: order moving sums of factor * delay samples
+                          std::vector<i64> h{ 1 };
+                          for (size_t s = 0; s < order; s++)
+                          {
+                              std::vector<i64> next(h.size() + factor * delay - 1, 0);
+                              for (size_t i = 0; i < h.size(); i++)
+                                  for (size_t k = 0; k < factor * delay; k++)
+                                      next[i + k] += h[i];
+                              h = next;
+                          }
+                          auto filtered = [&](const std::vector<i64>& x, size_t ch, size_t n) -> i64 {
+                              i64 result = 0;
+                              for (size_t k = 0; k < h.size() && k <= n; k++)
+                                  result += h[k] * x[(n - k) * channels + ch];
+                              return result;
+                          };
+                          std::vector<i64> x(data.begin(), data.end());
+
+                          cic_decimator<i16> decimator(factor, order, delay, channels);
+                          std::vector<i64> decimated(size * channels);
+                          size_t written = decimator.apply(decimated.data(), data.data(), 7);
+                          written += decimator.apply(decimated.data() + written * channels,
+                                                     data.data() + 7 * channels, size - 7);
+                          CHECK(written == (size + factor - 1) / factor);
+                          bool decimator_ok = true;
+                          for (size_t j = 0; j < written; j++)
+                              for (size_t ch = 0; ch < channels; ch++)
+                                  decimator_ok &= decimated[j * channels + ch] == filtered(x, ch, j * factor);
+                          CHECK(decimator_ok);
+
+                          std::vector<i64> stuffed(size * factor * channels, 0);
+                          for (size_t i = 0; i < size; i++)
+                              for (size_t ch = 0; ch < channels; ch++)
+                                  stuffed[i * factor * channels + ch] = x[i * channels + ch];
+                          cic_interpolator<i16> interpolator(factor, order, delay, channels);
+                          std::vector<i64> interpolated(size * factor * channels);
+                          CHECK(interpolator.apply(interpolated.data(), data.data(), size) == size * factor);
+                          bool interpolator_ok = true;
+                          for (size_t n = 0; n < size * factor; n++)
+                              for (size_t ch = 0; ch < channels; ch++)
+                              {
+                                  const i64 expected = filtered(stuffed, ch, n);
+                                  interpolator_ok &= interpolated[n * channels + ch] == expected;
+                              }
+                          CHECK(interpolator_ok);
+
+                          // Same-rate filter through the filter<T> interface
+                          if (channels == 1)
+                          {
+                              cic_filter<i64> filter(factor * delay, order);
+                              CHECK(filter.gain() == std::pow(double(factor * delay), double(order)));
+                              univector<i64> output(size);
+                              filter.apply(output.data(), x.data(), 11);
+                              filter.apply(output.data() + 11, x.data() + 11, size - 11);
+                              bool filter_ok = true;
+                              for (size_t n = 0; n < size; n++)
+                                  filter_ok &= output[n] == filtered(x, 0, n);
+                              CHECK(filter_ok);
+                          }
+                      }
+                  });
+
+    // Integrators of a 32-bit accumulator overflow on a constant input, the output must not
+    cic_decimator<i16, i32> decimator(16, 4);
+    CHECK(decimator.gain() == 65536.0);
+    std::vector<i16> dc(100000, i16(10000));
+    std::vector<i32> out(decimator.output_size(dc.size()));
+    CHECK(decimator.apply(out.data(), dc.data(), dc.size()) == out.size());
+    CHECK(out.back() == 655360000);
+
+    for (size_t delay : { 1, 2 })
+    {
+        univector<double> taps(63);
+        cic_compensation(taps, 4, 16, delay, 0.2, to_pointer(window_kaiser(taps.size(), 6.0)));
+        CHECK(fir_detect_symmetry<double>(taps) == fir_symmetry::symmetric);
+        // Response of the CIC filter followed by the compensation must be flat in the passband
+        double maxdev = 0.0;
+        for (double f = 0.0; f <= 0.15; f += 0.01)
+        {
+            std::complex<double> comp = 0.0;
+            for (size_t n = 0; n < taps.size(); n++)
+                comp += taps[n] * std::polar(1.0, -c_pi<double, 2> * f * n);
+            const double x     = c_pi<double> * f;
+            const double droop = f == 0.0 ? 1.0 : std::sin(x * delay) / (16 * delay * std::sin(x / 16));
+            maxdev             = std::max(maxdev, std::abs(std::abs(comp) * std::pow(droop, 4.0) - 1.0));
+        }
+        CHECK(maxdev < 0.01);
+    }
+}
+
+TEST(adaptive)
+{
+    testo::matrix(named("type") = ctypes_t<float, double>{},
+                  named("chunk") = std::vector<size_t>{ 1, 37, 500 }, [](auto type, size_t chunk) {
+                      using T             = type_of<decltype(type)>;
+                      const size_t length = 6000;
+                      univector<T> system(16);
+                      for (size_t i = 0; i < system.size(); i++)
+                          system[i] = T(std::sin(i * 0.731 + 0.2) * std::exp(-0.2 * i));
+                      univector<T> input(length);
+                      u32 seed = 1;
+                      for (size_t i = 0; i < length; i++)
+                      {
+                          seed     = seed * 1664525u + 1013904223u;
+                          input[i] = T((seed >> 8) / 16777216.0 - 0.5);
+                      }
+                      univector<T> desired(length, 0);
+                      for (size_t i = 0; i < length; i++)
+                          for (size_t k = 0; k < system.size() && k <= i; k++)
+                              desired[i] += system[k] * input[i - k];
+
+                      // Identifies the system and returns the largest coefficient error
+                      auto identify = [&](auto& filter, size_t length) {
+                          univector<T> output(length);
+                          univector<T> error(length);
+                          for (size_t i = 0; i < length; i += chunk)
+                          {
+                              const size_t size = std::min(chunk, length - i);
+                              filter.apply(output.data() + i, error.data() + i, input.data() + i,
+                                           desired.data() + i, size);
+                          }
+                          CHECK(absmaxof(output + error - desired.slice(0, length)) < 1e-5);
+                          return absmaxof(filter.taps() - system);
+                      };
+                      const T tolerance = std::is_same<T, float>::value ? 1e-4 : 1e-9;
+
+                      lms_filter<T> lms(16, T(0.2));
+                      CHECK(identify(lms, length) < tolerance);
+                      nlms_filter<T> nlms(16, T(0.5));
+                      CHECK(identify(nlms, length) < tolerance);
+                      nlms.reset();
+                      CHECK(absmaxof(nlms.taps()) == 0);
+                      if (std::is_same<T, double>::value)
+                      {
+                          // The bias of the initial regularization decays with the forgetting factor
+                          rls_filter<T> rls(16, T(0.99), T(1e-6));
+                          CHECK(identify(rls, 1000) < tolerance);
+                      }
+                  });
+}
+
 #ifndef KFR_NO_MAIN
 int main()
 {
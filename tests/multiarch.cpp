@@ -15,6 +15,8 @@ using namespace kfr;
 
 cpu_t fir_sse2(univector<double, 0> data, univector<double, 4>& taps);
 cpu_t fir_avx(univector<double, 0> data, univector<double, 4>& taps);
+cpu_t fir_fixed_sse2(univector<i16, 0> data, const univector<i16>& taps);
+cpu_t fir_fixed_avx(univector<i16, 0> data, const univector<i16>& taps);
 
 TEST(test_fir_sse2)
 {
@@ -55,4 +57,28 @@ TEST(test_fir_avx)
     }
 }
 
+TEST(test_fir_fixed)
+{
+    univector<i16> taps(37);
+    univector<i16> input(1000);
+    for (size_t i = 0; i < taps.size(); i++)
+        taps[i] = i16(std::sin(i * 0.5) * 16000);
+    for (size_t i = 0; i < input.size(); i++)
+        input[i] = i16(std::sin(i * 0.1 + 0.003 * i * i) * 32000);
+
+    // Integer arithmetic gives bit-exact results on every target
+    univector<i16> native = input;
+    filter_fir_fixed<i16> fir(taps);
+    fir.apply(native);
+    univector<i16> sse2 = input;
+    CHECK(fir_fixed_sse2(sse2, taps) == cpu_t::sse2);
+    CHECK(std::equal(sse2.begin(), sse2.end(), native.begin()));
+    if (get_cpu() >= cpu_t::avx1)
+    {
+        univector<i16> avx = input;
+        CHECK(fir_fixed_avx(avx, taps) == cpu_t::avx);
+        CHECK(std::equal(avx.begin(), avx.end(), native.begin()));
+    }
+}
+
 int main() { return testo::run_all("", true); }
@@ -16,3 +16,10 @@ cpu_t fir_avx(univector<double, 0> data, univector<double, 4>& taps)
     data = short_fir(data, taps);
     return cpu_t::native;
 }
+
+cpu_t fir_fixed_avx(univector<i16, 0> data, const univector<i16>& taps)
+{
+    filter_fir_fixed<i16> fir(taps);
+    fir.apply(data);
+    return cpu_t::native;
+}